@@ -8,17 +8,104 @@
 
 /* Focus behavior */
 #define FOCUS_FOLLOWS_MOUSE 1         /* 1 to enable, 0 to disable */
+#define RAISE_ON_FOCUS      1         /* 1 to raise focused windows in their zone, 0 to leave stacking alone */
+#define FOCUS_DWELL_MS      40        /* Pointer must rest in a window this long to focus it, 0 for at once */
+
+/* Zone layout */
+#define MONOCLE_DEFAULT     0         /* 1 to start every zone in monocle mode (only the current window mapped) */
+#define AUTO_FLOAT          1         /* 1 to float transients, dialogs and fixed-size windows at their own size */
+#define DOCK_STRUTS         1         /* 1 to leave docks unmanaged and keep windows off the edges they reserve */
+#define STRUT_SETTLE_MS     100       /* Strut changes apply once they stop this long, so auto-hiding panels relayout once */
 
 /* Monitor configuration */
 #define ULTRAWIDE_THRESHOLD 5000      /* Pixels width to consider ultrawide */
 #define ZONE_LEFT_RATIO     0.25      /* Left zone: 1/4 of ultrawide */
 #define ZONE_CENTER_RATIO   0.50      /* Center zone: 1/2 of ultrawide */
 #define ZONE_RIGHT_RATIO    0.25      /* Right zone: 1/4 of ultrawide */
+#define ZONE_MIN_WIDTH      200       /* Narrowest a zone can be made by moving a split */
+
+/* Window closing */
+#define KILL_TIMEOUT_MS     3000      /* Force kill clients that ignore WM_DELETE_WINDOW */
+
+/* Event loop timers */
+#define TIMER_TICK_MS       10        /* Timer wheel resolution */
+#define TIMER_WHEEL_SLOTS   256       /* Slots per wheel revolution */
+
+/* Window rules, matched in order when a window is mapped; the first match wins.
+ * Any of class, instance, title (substring) and type (_NET_WM_WINDOW_TYPE name)
+ * may be NULL to match anything. zone is a zone index, or -1 for the active zone.
+ * floating keeps the window's own size; focus 0 maps it without taking focus.
+ *
+ *   RULE("firefox",  NULL,  NULL,       NULL,                          0,  0, 1)
+ *   RULE("Slack",    NULL,  NULL,       NULL,                          2,  0, 0)
+ *   RULE(NULL,       NULL,  "htop",     NULL,                         -1,  0, 1)
+ *   RULE(NULL,       NULL,  NULL,       "_NET_WM_WINDOW_TYPE_DIALOG", -1,  1, 1)
+ */
+#define WINDOW_RULES \
+    /* RULE(class, instance, title, type, zone, floating, focus) */ \
+
+/* Key bindings grabbed by swm itself, run without sxhkd, swmctl or xprop.
+ * Modifiers are X modifier masks (Mod4Mask is super, Mod1Mask alt); CapsLock
+ * and NumLock are ignored. KEY_ARG passes an argument to commands that take
+ * one. Leave BUILTIN_KEYS at 0 while sxhkd grabs the same keys, see
+ * sxhkdrc.example. */
+#define BUILTIN_KEYS        0         /* 1 to grab KEY_BINDINGS, 0 to leave the keyboard alone */
+#define KEY_BINDINGS \
+    KEY(Mod4Mask,             XK_Tab,   CMD_CYCLE_WINDOW_NEXT)   \
+    KEY(Mod4Mask | ShiftMask, XK_Tab,   CMD_CYCLE_WINDOW_PREV)   \
+    KEY(Mod4Mask,             XK_j,     CMD_CYCLE_WINDOW_NEXT)   \
+    KEY(Mod4Mask,             XK_k,     CMD_CYCLE_WINDOW_PREV)   \
+    KEY(Mod4Mask,             XK_grave, CMD_CYCLE_MONITOR_RIGHT) \
+    KEY(Mod4Mask | ShiftMask, XK_grave, CMD_CYCLE_MONITOR_LEFT)  \
+    KEY(Mod4Mask,             XK_l,     CMD_CYCLE_MONITOR_RIGHT) \
+    KEY(Mod4Mask,             XK_h,     CMD_CYCLE_MONITOR_LEFT)  \
+    KEY(Mod4Mask | ShiftMask, XK_h,     CMD_MOVE_WINDOW_LEFT)    \
+    KEY(Mod4Mask | ShiftMask, XK_l,     CMD_MOVE_WINDOW_RIGHT)   \
+    KEY(Mod4Mask,             XK_m,     CMD_TOGGLE_MONOCLE)      \
+    KEY(Mod4Mask | ShiftMask, XK_Return, CMD_SWAP_FIRST)         \
+    KEY_ARG(Mod4Mask,             XK_1, CMD_FOCUS_ZONE, 0)          \
+    KEY_ARG(Mod4Mask,             XK_2, CMD_FOCUS_ZONE, 1)          \
+    KEY_ARG(Mod4Mask,             XK_3, CMD_FOCUS_ZONE, 2)          \
+    KEY_ARG(Mod4Mask | ShiftMask, XK_1, CMD_MOVE_WINDOW_TO_ZONE, 0) \
+    KEY_ARG(Mod4Mask | ShiftMask, XK_2, CMD_MOVE_WINDOW_TO_ZONE, 1) \
+    KEY_ARG(Mod4Mask | ShiftMask, XK_3, CMD_MOVE_WINDOW_TO_ZONE, 2) \
+    KEY_ARG(Mod4Mask | ControlMask, XK_l, CMD_RUN_MACRO, 0)      \
+    KEY_ARG(Mod4Mask | ControlMask, XK_h, CMD_RUN_MACRO, 1)      \
+    KEY(Mod4Mask | ShiftMask, XK_c,     CMD_KILL_WINDOW)         \
+    KEY(Mod4Mask | ShiftMask, XK_q,     CMD_QUIT)                \
+
+/* Command macros: sequences of commands run by CMD_RUN_MACRO with the
+ * macro's index, all in one pass over swm's state, so only their end result
+ * is sent to the server. STEP takes a command and its arguments (0 when it
+ * has none); a macro cannot run another macro.
+ *
+ *   MACRO(STEP(CMD_MOVE_WINDOW_RIGHT, 0, 0) STEP(CMD_CYCLE_MONITOR_LEFT, 0, 0))
+ */
+#define MACROS \
+    /* 0: throw the focused window one zone right and stay */ \
+    MACRO(STEP(CMD_MOVE_WINDOW_RIGHT, 0, 0) STEP(CMD_CYCLE_MONITOR_LEFT, 0, 0))  \
+    /* 1: throw the focused window one zone left and stay */ \
+    MACRO(STEP(CMD_MOVE_WINDOW_LEFT, 0, 0) STEP(CMD_CYCLE_MONITOR_RIGHT, 0, 0))  \
 
 /* External command interface */
 #define COMMAND_PROPERTY    "_SWM_COMMAND"
+#define STATE_EXPORT        1         /* 1 to publish zones and focus in shared memory for `swmc status` */
+#define EVENT_SUBSCRIPTIONS 1         /* 1 to stream state changes to `swmc subscribe` clients */
+#define SUBSCRIBERS_MAX     16        /* Concurrent subscribers; further connections are refused */
+#define SUBSCRIBER_QUEUE    256       /* Events queued per subscriber before new ones are dropped */
+
+/* Debugging */
+#define TRACE_FILE_ENV      "SWM_TRACE"  /* Environment variable naming the event trace file */
+#define SPAN_FILE_ENV       "SWM_SPANS"  /* Environment variable naming the Chrome trace JSON written on SIGUSR2 and exit */
+#define SPAN_BUFFER_SIZE    65536     /* Span begins and ends kept for that file; older ones are overwritten */
+
+/* Runtime settings, overriding the defaults above (see settings.h) */
+#define SETTINGS_FILE_ENV   "SWM_CONFIG" /* Environment variable naming the settings file */
+#define SETTINGS_FILE       "swm/swmrc"  /* Otherwise this, under $XDG_CONFIG_HOME or ~/.config */
 
-/* Commands that can be sent via root window property */
+/* Commands that can be sent via root window property. Clients append each
+ * command followed by the arguments marked below; several commands may be
+ * queued in the property at once. */
 enum swm_command {
     CMD_CYCLE_WINDOW = 1,
     CMD_CYCLE_MONITOR,
@@ -29,7 +116,20 @@ enum swm_command {
     CMD_KILL_WINDOW,
     CMD_QUIT,
     CMD_MOVE_WINDOW_LEFT,
-    CMD_MOVE_WINDOW_RIGHT
+    CMD_MOVE_WINDOW_RIGHT,
+    CMD_TOGGLE_MONOCLE,
+    CMD_FOCUS_ZONE,               /* Argument: zone index on the active screen */
+    CMD_MOVE_WINDOW_TO_ZONE,      /* Argument: zone index on the active screen */
+    CMD_FOCUS_WINDOW,             /* Argument: window id */
+    CMD_SWAP_FIRST,               /* Swap the current window with the first of its zone */
+    CMD_MOVE_ZONE_WINDOWS,        /* Arguments: from zone, to zone (negative: the active zone) */
+    CMD_CLOSE_ZONE_WINDOWS,       /* Argument: zone (negative: the active zone) */
+    CMD_GATHER_WINDOWS,           /* Every window of the screen onto the active zone */
+    CMD_RUN_MACRO,                /* Argument: index into MACROS */
+    CMD_RELOAD_SETTINGS,          /* Re-read the settings file */
+    CMD_MOVE_SPLIT,               /* Arguments: zone (negative: the active zone), pixels to move its right edge */
+    CMD_SET_SPLIT,                /* Arguments: zone (negative: the active zone), right edge in pixels from the monitor's left */
+    CMD_COUNT                     /* Keep last */
 };
 
 #endif /* CONFIG_H */ 
\ No newline at end of file
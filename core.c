@@ -1,4 +1,6 @@
 #include <stdlib.h>
+#include <limits.h>
+#include <string.h>
 #include <stdbool.h>
 #include <assert.h>
 #include <X11/Xlib.h>
@@ -7,8 +9,14 @@
 
 /* Core logic functions */
 
-/* Calculate logical zones from physical monitors */
+/* Calculate logical zones from physical monitors, split as config.h says */
 int calculate_zones(XineramaScreenInfo *monitors, int monitor_count, LogicalZone **zones) {
+    ZoneLayout layout = {ULTRAWIDE_THRESHOLD, ZONE_LEFT_RATIO, ZONE_CENTER_RATIO, ZONE_RIGHT_RATIO};
+    return calculate_layout_zones(monitors, monitor_count, &layout, zones);
+}
+
+int calculate_layout_zones(XineramaScreenInfo *monitors, int monitor_count, const ZoneLayout *layout,
+                           LogicalZone **zones) {
     assert(monitors != NULL);
     assert(zones != NULL);
     
@@ -16,7 +24,7 @@ int calculate_zones(XineramaScreenInfo *monitors, int monitor_count, LogicalZone
     
     /* Count total zones needed */
     for (int i = 0; i < monitor_count; i++) {
-        if (monitors[i].width > ULTRAWIDE_THRESHOLD) {
+        if (monitors[i].width > layout->ultrawide_threshold) {
             zone_count += 3;  /* Split ultrawide into 3 zones */
         } else {
             zone_count += 1;  /* Regular monitor = 1 zone */
@@ -28,11 +36,11 @@ int calculate_zones(XineramaScreenInfo *monitors, int monitor_count, LogicalZone
     
     int zone_index = 0;
     for (int i = 0; i < monitor_count; i++) {
-        if (monitors[i].width > ULTRAWIDE_THRESHOLD) {
+        if (monitors[i].width > layout->ultrawide_threshold) {
             /* Split ultrawide monitor into 3 zones */
-            int left_width = monitors[i].width * ZONE_LEFT_RATIO;
-            int center_width = monitors[i].width * ZONE_CENTER_RATIO;
-            int right_width = monitors[i].width * ZONE_RIGHT_RATIO;
+            int left_width = monitors[i].width * layout->left_ratio;
+            int center_width = monitors[i].width * layout->center_ratio;
+            int right_width = monitors[i].width * layout->right_ratio;
             
             /* Left zone */
             (*zones)[zone_index] = (LogicalZone){
@@ -68,9 +76,66 @@ int calculate_zones(XineramaScreenInfo *monitors, int monitor_count, LogicalZone
         }
     }
     
+    /* Nothing reserves any of it yet */
+    for (int i = 0; i < zone_count; i++) {
+        XineramaScreenInfo *monitor = &monitors[(*zones)[i].monitor_id];
+        (*zones)[i].area = (*zones)[i].geometry;
+        (*zones)[i].monitor = (Rectangle){monitor->x_org, monitor->y_org, monitor->width, monitor->height};
+    }
+    
     return zone_count;
 }
 
+/* Split the display's monitors again under a new layout. Zone areas are
+ * replaced in place and the usable areas left for apply_struts() to redo.
+ * Clients and per-zone state are indexed by zone, so a layout that changes
+ * how many zones a monitor has is not applied and -1 returned; otherwise
+ * returns how many zone areas moved. */
+int resplit_zones(DisplayManager *display, const ZoneLayout *layout) {
+    int monitor_count = 0;
+    for (int zone = 0; zone < display->zone_count; zone++) {
+        if (display->zones[zone].monitor_id >= monitor_count) {
+            monitor_count = display->zones[zone].monitor_id + 1;
+        }
+    }
+    if (monitor_count == 0) {
+        return 0;
+    }
+    
+    XineramaScreenInfo *monitors = calloc(monitor_count, sizeof(XineramaScreenInfo));
+    assert(monitors != NULL);
+    for (int zone = 0; zone < display->zone_count; zone++) {
+        Rectangle *monitor = &display->zones[zone].monitor;
+        monitors[display->zones[zone].monitor_id] = (XineramaScreenInfo){
+            display->zones[zone].monitor_id, monitor->x, monitor->y, monitor->width, monitor->height
+        };
+    }
+    
+    LogicalZone *zones = NULL;
+    int zone_count = calculate_layout_zones(monitors, monitor_count, layout, &zones);
+    free(monitors);
+    
+    bool same_zones = zone_count == display->zone_count;
+    for (int zone = 0; same_zones && zone < zone_count; zone++) {
+        same_zones = zones[zone].monitor_id == display->zones[zone].monitor_id &&
+                     zones[zone].zone_id == display->zones[zone].zone_id;
+    }
+    if (!same_zones) {
+        free(zones);
+        return -1;
+    }
+    
+    int moved = 0;
+    for (int zone = 0; zone < zone_count; zone++) {
+        if (memcmp(&zones[zone].area, &display->zones[zone].area, sizeof(Rectangle)) != 0) {
+            display->zones[zone].area = zones[zone].area;
+            moved++;
+        }
+    }
+    free(zones);
+    return moved;
+}
+
 /* Simplified zone-based client management functions */
 
 Client *get_current_client_in_zone(DisplayManager *display, int zone) {
@@ -129,6 +194,8 @@ void remove_client_from_zone(DisplayManager *display, int zone, Client *client)
         return;
     }
     
+    stack_remove(display, zone, client);
+    
     Client **current = &display->zone_clients[zone];
     int index = 0;
     
@@ -159,4 +226,982 @@ void remove_client_from_zone(DisplayManager *display, int zone, Client *client)
         current = &(*current)->next;
         index++;
     }
-} 
\ No newline at end of file
+} 
+Client *find_client_by_window(DisplayManager *display, Window window) {
+    if (!display) {
+        return NULL;
+    }
+    
+    for (int zone = 0; zone < display->zone_count; zone++) {
+        for (Client *current = display->zone_clients[zone]; current; current = current->next) {
+            if (current->window == window) {
+                return current;
+            }
+        }
+    }
+    return NULL;
+}
+
+/* Screens
+ *
+ * Every X screen of the display has its own DisplayManager, linked from
+ * wm.displays. Window ids are unique across screens on one connection. */
+
+DisplayManager *find_display_by_root(DisplayManager *displays, Window root) {
+    for (DisplayManager *display = displays; display; display = display->next) {
+        if (display->root == root) {
+            return display;
+        }
+    }
+    return NULL;
+}
+
+/* Look a window up on every screen; *found gets the screen managing it */
+Client *find_client_on_any_display(DisplayManager *displays, Window window, DisplayManager **found) {
+    for (DisplayManager *display = displays; display; display = display->next) {
+        Client *client = find_client_by_window(display, window);
+        if (client) {
+            if (found) *found = display;
+            return client;
+        }
+    }
+    return NULL;
+}
+
+/* The screen after (direction > 0) or before display, with wrap-around */
+DisplayManager *step_display(DisplayManager *displays, DisplayManager *display, int direction) {
+    if (!displays || !display) {
+        return display;
+    }
+    
+    if (direction > 0) {
+        return display->next ? display->next : displays;
+    }
+    
+    DisplayManager *previous = displays;
+    while (previous->next && previous->next != display) {
+        previous = previous->next;
+    }
+    return previous;
+}
+
+/* State transitions
+ *
+ * These update the model only. The window manager turns their results into
+ * X requests; the trace replayer runs them bare. */
+
+/* Add a newly mapped client to the front of a zone, on top and current */
+void insert_new_client(DisplayManager *display, Client *client, int zone) {
+    if (!display || !client || zone < 0 || zone >= display->zone_count) {
+        return;
+    }
+    
+    add_client_to_zone(display, zone, client);
+    
+    /* Newly mapped windows start on top, so the model needs no restack
+     * unless the zone has floating clients to stay above a tiled one */
+    stack_push(display, zone, client);
+    if (display->zone_stack[zone] != client) {
+        display->zone_stack_dirty[zone] = true;
+    }
+    display->zone_current_index[zone] = 0;
+}
+
+/* Make client the current one of its zone and its zone the active one */
+void make_client_current(DisplayManager *display, Client *client) {
+    if (!display || !client) {
+        return;
+    }
+    
+    int index = find_client_index_in_zone(display, client->zone_index, client);
+    if (index < 0) {
+        return;
+    }
+    
+    display->active_zone = client->zone_index;
+    display->zone_current_index[client->zone_index] = index;
+}
+
+/* Step the active zone's current client. Returns the new current client, or
+ * NULL if the zone has nothing to cycle through. */
+Client *step_zone_current(DisplayManager *display, int direction) {
+    if (!display || display->zone_count == 0) {
+        return NULL;
+    }
+    
+    int zone = display->active_zone;
+    int count = count_clients_in_zone(display, zone);
+    if (count <= 1) {
+        return NULL;
+    }
+    
+    int current_index = display->zone_current_index[zone];
+    if (direction > 0) {
+        display->zone_current_index[zone] = (current_index + 1) % count;
+    } else {
+        display->zone_current_index[zone] = (current_index - 1 + count) % count;
+    }
+    
+    return get_current_client_in_zone(display, zone);
+}
+
+/* Step the active zone with wrap-around. Returns the new active zone. */
+int step_active_zone(DisplayManager *display, int direction) {
+    if (!display || display->zone_count == 0) {
+        return -1;
+    }
+    
+    int zone_count = display->zone_count;
+    if (direction > 0) {
+        display->active_zone = (display->active_zone + 1) % zone_count;
+    } else {
+        display->active_zone = (display->active_zone - 1 + zone_count) % zone_count;
+    }
+    
+    return display->active_zone;
+}
+
+/* Swap a client with the first one of its zone, or with the second when it
+ * already is the first, and keep it current. Only the zone's order changes:
+ * geometry and stacking stay as they are. Returns the client it swapped
+ * with, or NULL when the zone has nothing to swap with. */
+Client *swap_with_first(DisplayManager *display, Client *client) {
+    if (!display || !client) {
+        return NULL;
+    }
+    
+    int zone = client->zone_index;
+    Client **head = &display->zone_clients[zone];
+    Client *first = *head;
+    if (!first) {
+        return NULL;
+    }
+    
+    if (first == client) {
+        Client *second = client->next;
+        if (!second) {
+            return NULL;
+        }
+        client->next = second->next;
+        second->next = client;
+        *head = second;
+        display->zone_current_index[zone] = 1;
+        return second;
+    }
+    
+    Client *previous = first;
+    while (previous->next && previous->next != client) {
+        previous = previous->next;
+    }
+    if (!previous->next) {
+        return NULL;
+    }
+    
+    if (previous == first) {
+        first->next = client->next;
+        client->next = first;
+    } else {
+        Client *after_first = first->next;
+        first->next = client->next;
+        client->next = after_first;
+        previous->next = first;
+    }
+    *head = client;
+    display->zone_current_index[zone] = 0;
+    return first;
+}
+
+/* Move client to the top of another zone. The zone's model order changes
+ * relative to the server, so it is marked for restacking. */
+void move_client_to_zone(DisplayManager *display, Client *client, int zone) {
+    if (!display || !client || zone < 0 || zone >= display->zone_count) {
+        return;
+    }
+    
+    remove_client_from_zone(display, client->zone_index, client);
+    add_client_to_zone(display, zone, client);
+    stack_push(display, zone, client);
+    display->zone_stack_dirty[zone] = true;
+}
+
+/* Move every client of zone from onto zone to, ahead of and above the
+ * clients already there, keeping from's current client current. The lists
+ * are spliced rather than rebuilt: one pass over the moved clients to
+ * retag them, and one stable merge of the two stacking orders so floating
+ * clients stay on top. Returns the number of clients moved, which are the
+ * first ones in to's list. */
+int move_zone_clients(DisplayManager *display, int from, int to) {
+    if (!display || from == to || from < 0 || from >= display->zone_count ||
+        to < 0 || to >= display->zone_count || !display->zone_clients[from]) {
+        return 0;
+    }
+    
+    int moved = 0;
+    Client *tail = NULL;
+    for (Client *client = display->zone_clients[from]; client; client = client->next) {
+        client->zone_index = to;
+        tail = client;
+        moved++;
+    }
+    tail->next = display->zone_clients[to];
+    display->zone_clients[to] = display->zone_clients[from];
+    display->zone_clients[from] = NULL;
+    display->zone_current_index[to] = display->zone_current_index[from];
+    display->zone_current_index[from] = -1;
+    
+    /* Floating clients of both zones, then tiled ones, moved clients first */
+    Client *floating = NULL, **floating_tail = &floating;
+    Client *tiled = NULL, **tiled_tail = &tiled;
+    Client *stacks[2] = {display->zone_stack[from], display->zone_stack[to]};
+    for (int i = 0; i < 2; i++) {
+        Client *client = stacks[i];
+        while (client) {
+            Client *next = client->stack_next;
+            if (client->floating) {
+                *floating_tail = client;
+                floating_tail = &client->stack_next;
+            } else {
+                *tiled_tail = client;
+                tiled_tail = &client->stack_next;
+            }
+            client = next;
+        }
+    }
+    *tiled_tail = NULL;
+    *floating_tail = tiled;
+    display->zone_stack[to] = floating;
+    display->zone_stack[from] = NULL;
+    display->zone_stack_dirty[to] = true;
+    display->zone_stack_dirty[from] = false;
+    
+    return moved;
+}
+
+/* Per-zone stacking model
+ *
+ * Zones never overlap, so only the order of clients within a zone is visible.
+ * The model is kept separately from the cycling order in zone_clients and only
+ * raising a client that is not already on top of its zone changes it. */
+
+/* Where a client goes when raised: the very top for floating clients,
+ * just below the zone's floating clients for tiled ones */
+static Client **stack_top_slot(DisplayManager *display, int zone, Client *client) {
+    Client **slot = &display->zone_stack[zone];
+    if (!client->floating) {
+        while (*slot && (*slot)->floating) {
+            slot = &(*slot)->stack_next;
+        }
+    }
+    return slot;
+}
+
+void stack_push(DisplayManager *display, int zone, Client *client) {
+    if (!display || !client || zone < 0 || zone >= display->zone_count) {
+        return;
+    }
+    
+    Client **slot = stack_top_slot(display, zone, client);
+    client->stack_next = *slot;
+    *slot = client;
+}
+
+void stack_remove(DisplayManager *display, int zone, Client *client) {
+    if (!display || !client || zone < 0 || zone >= display->zone_count) {
+        return;
+    }
+    
+    for (Client **current = &display->zone_stack[zone]; *current; current = &(*current)->stack_next) {
+        if (*current == client) {
+            *current = client->stack_next;
+            client->stack_next = NULL;
+            return;
+        }
+    }
+}
+
+/* Move client to the top of its zone, or of the zone's tiled clients.
+ * Returns true if the order changed. */
+bool stack_raise(DisplayManager *display, int zone, Client *client) {
+    if (!display || !client || zone < 0 || zone >= display->zone_count) {
+        return false;
+    }
+    
+    if (*stack_top_slot(display, zone, client) == client) {
+        return false;
+    }
+    
+    stack_remove(display, zone, client);
+    stack_push(display, zone, client);
+    display->zone_stack_dirty[zone] = true;
+    return true;
+}
+
+Client *stack_top(DisplayManager *display, int zone) {
+    if (!display || zone < 0 || zone >= display->zone_count) {
+        return NULL;
+    }
+    return display->zone_stack[zone];
+}
+
+/* Fill windows with the zone's stacking order, topmost first */
+int collect_zone_stack(DisplayManager *display, int zone, Window *windows, int max) {
+    if (!display || !windows || zone < 0 || zone >= display->zone_count) {
+        return 0;
+    }
+    
+    int count = 0;
+    for (Client *current = display->zone_stack[zone]; current && count < max; current = current->stack_next) {
+        windows[count++] = current->window;
+    }
+    return count;
+}
+
+int find_client_index_in_zone(DisplayManager *display, int zone, Client *client) {
+    if (!display || !client || zone < 0 || zone >= display->zone_count) {
+        return -1;
+    }
+    
+    int index = 0;
+    for (Client *current = display->zone_clients[zone]; current; current = current->next) {
+        if (current == client) {
+            return index;
+        }
+        index++;
+    }
+    
+    return -1;
+}
+
+int count_managed_clients(DisplayManager *display) {
+    if (!display) {
+        return 0;
+    }
+    
+    int count = 0;
+    for (int zone = 0; zone < display->zone_count; zone++) {
+        count += count_clients_in_zone(display, zone);
+    }
+    
+    return count;
+}
+
+/* Fill windows with every managed window, zone by zone. Returns the count written. */
+int collect_client_windows(DisplayManager *display, Window *windows, int max) {
+    if (!display || !windows) {
+        return 0;
+    }
+    
+    int count = 0;
+    for (int zone = 0; zone < display->zone_count; zone++) {
+        for (Client *current = display->zone_clients[zone]; current && count < max; current = current->next) {
+            windows[count++] = current->window;
+        }
+    }
+    
+    return count;
+}
+
+Window get_active_window(DisplayManager *display) {
+    if (!display) {
+        return None;
+    }
+    
+    Client *current = get_current_client_in_zone(display, display->active_zone);
+    return current ? current->window : None;
+}
+
+/* Put the boundary between zone and the next zone of the same monitor x
+ * pixels from the monitor's left edge, keeping both at least
+ * ZONE_MIN_WIDTH wide. Only the two zone areas change; usable areas are
+ * left for apply_struts() to redo. Returns false when zone is the last of
+ * its monitor or the boundary stays where it was. */
+bool set_zone_split(DisplayManager *display, int zone, int x) {
+    if (!display || zone < 0 || zone + 1 >= display->zone_count) {
+        return false;
+    }
+    
+    LogicalZone *left = &display->zones[zone];
+    LogicalZone *right = &display->zones[zone + 1];
+    if (left->monitor_id != right->monitor_id) {
+        return false;
+    }
+    
+    int start = left->area.x;
+    int end = right->area.x + right->area.width;
+    if (end - start < 2 * ZONE_MIN_WIDTH) {
+        return false;
+    }
+    
+    int split = left->monitor.x + x;
+    if (split < start + ZONE_MIN_WIDTH) split = start + ZONE_MIN_WIDTH;
+    if (split > end - ZONE_MIN_WIDTH) split = end - ZONE_MIN_WIDTH;
+    if (split == right->area.x) {
+        return false;
+    }
+    
+    left->area.width = split - start;
+    right->area.x = split;
+    right->area.width = end - split;
+    return true;
+}
+
+/* Docks */
+
+Dock *find_dock(DisplayManager *display, Window window) {
+    if (!display) {
+        return NULL;
+    }
+    
+    for (Dock *dock = display->docks; dock; dock = dock->next) {
+        if (dock->window == window) {
+            return dock;
+        }
+    }
+    
+    return NULL;
+}
+
+bool remove_dock(DisplayManager *display, Window window) {
+    for (Dock **link = &display->docks; *link; link = &(*link)->next) {
+        if ((*link)->window == window) {
+            Dock *dock = *link;
+            *link = dock->next;
+            free(dock);
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+void free_docks(DisplayManager *display) {
+    while (display->docks) {
+        Dock *dock = display->docks;
+        display->docks = dock->next;
+        free(dock);
+    }
+}
+
+/* The older _NET_WM_STRUT reserves each edge along its whole length */
+void strut_from_legacy(const long *legacy, long *strut) {
+    for (int edge = 0; edge < 4; edge++) {
+        strut[edge] = legacy[edge];
+        strut[4 + 2 * edge] = 0;
+        strut[5 + 2 * edge] = LONG_MAX;
+    }
+}
+
+static bool spans_overlap(long start, long end, int from, int length) {
+    return start <= end && start < from + length && end >= from;
+}
+
+/* Recompute every zone's usable area from its whole area and the docks'
+ * struts. Struts count from the screen edges, but only shrink the zones
+ * whose span along that edge they cover, so a bar on one monitor leaves
+ * the others alone. changed[zone] is set for the zones whose usable area
+ * moved; returns how many did. */
+int apply_struts(DisplayManager *display, bool *changed) {
+    int screen_width = 0;
+    int screen_height = 0;
+    for (int zone = 0; zone < display->zone_count; zone++) {
+        Rectangle *area = &display->zones[zone].area;
+        if (area->x + area->width > screen_width) screen_width = area->x + area->width;
+        if (area->y + area->height > screen_height) screen_height = area->y + area->height;
+    }
+    
+    int count = 0;
+    for (int zone = 0; zone < display->zone_count; zone++) {
+        Rectangle area = display->zones[zone].area;
+        int left = area.x;
+        int right = area.x + area.width;
+        int top = area.y;
+        int bottom = area.y + area.height;
+        
+        for (Dock *dock = display->docks; dock; dock = dock->next) {
+            const long *strut = dock->strut;
+            if (strut[0] > 0 && spans_overlap(strut[4], strut[5], area.y, area.height) &&
+                strut[0] > left) {
+                left = strut[0];
+            }
+            if (strut[1] > 0 && spans_overlap(strut[6], strut[7], area.y, area.height) &&
+                screen_width - strut[1] < right) {
+                right = screen_width - strut[1];
+            }
+            if (strut[2] > 0 && spans_overlap(strut[8], strut[9], area.x, area.width) &&
+                strut[2] > top) {
+                top = strut[2];
+            }
+            if (strut[3] > 0 && spans_overlap(strut[10], strut[11], area.x, area.width) &&
+                screen_height - strut[3] < bottom) {
+                bottom = screen_height - strut[3];
+            }
+        }
+        
+        /* A strut wider than the zone leaves it a sliver, never nothing */
+        if (right <= left) right = left + 1;
+        if (bottom <= top) bottom = top + 1;
+        
+        Rectangle usable = {left, top, right - left, bottom - top};
+        Rectangle *geometry = &display->zones[zone].geometry;
+        changed[zone] = memcmp(geometry, &usable, sizeof(usable)) != 0;
+        if (changed[zone]) {
+            *geometry = usable;
+            count++;
+        }
+    }
+    
+    return count;
+}
+
+/* EWMH publishing state
+ *
+ * State changes only set bits; the event loop takes them once per iteration
+ * and writes each dirty root property a single time, however many changes
+ * happened in between. */
+
+void mark_ewmh_dirty(DisplayManager *display, unsigned int flags) {
+    if (!display) {
+        return;
+    }
+    display->ewmh_dirty |= flags;
+}
+
+unsigned int take_ewmh_dirty(DisplayManager *display) {
+    if (!display) {
+        return 0;
+    }
+    
+    unsigned int flags = display->ewmh_dirty;
+    display->ewmh_dirty = 0;
+    return flags;
+}
+
+/* X request transactions
+ *
+ * Handlers record what each window should end up as rather than issuing
+ * requests directly. Repeated changes to the same window collapse into one
+ * entry, so intermediate states are never sent to the server. */
+
+void txn_init(Transaction *txn) {
+    assert(txn != NULL);
+    
+    txn->entries = NULL;
+    txn->count = 0;
+    txn->capacity = 0;
+    txn->focus = None;
+}
+
+void txn_reset(Transaction *txn) {
+    txn->count = 0;
+    txn->focus = None;
+}
+
+void txn_free(Transaction *txn) {
+    free(txn->entries);
+    txn_init(txn);
+}
+
+TxnEntry *txn_find(Transaction *txn, Window window) {
+    for (int i = 0; i < txn->count; i++) {
+        if (txn->entries[i].window == window) {
+            return &txn->entries[i];
+        }
+    }
+    return NULL;
+}
+
+/* Find or append the entry for window */
+TxnEntry *txn_entry(Transaction *txn, Window window) {
+    TxnEntry *entry = txn_find(txn, window);
+    if (entry) {
+        return entry;
+    }
+    
+    if (txn->count == txn->capacity) {
+        txn->capacity = txn->capacity ? txn->capacity * 2 : 16;
+        txn->entries = realloc(txn->entries, txn->capacity * sizeof(TxnEntry));
+        assert(txn->entries != NULL);
+    }
+    
+    entry = &txn->entries[txn->count++];
+    *entry = (TxnEntry){.window = window};
+    return entry;
+}
+
+void txn_set_geometry(Transaction *txn, Window window, Rectangle geometry) {
+    TxnEntry *entry = txn_entry(txn, window);
+    entry->flags |= TXN_GEOMETRY;
+    entry->geometry = geometry;
+}
+
+void txn_set_border(Transaction *txn, Window window, unsigned long color) {
+    TxnEntry *entry = txn_entry(txn, window);
+    entry->flags |= TXN_BORDER;
+    entry->border_color = color;
+}
+
+/* Map and unmap cancel each other; the last one asked for wins */
+void txn_map(Transaction *txn, Window window) {
+    TxnEntry *entry = txn_entry(txn, window);
+    entry->flags = (entry->flags & ~TXN_UNMAP) | TXN_MAP;
+}
+
+void txn_unmap(Transaction *txn, Window window) {
+    TxnEntry *entry = txn_entry(txn, window);
+    entry->flags = (entry->flags & ~TXN_MAP) | TXN_UNMAP;
+}
+
+void txn_focus(Transaction *txn, Window window) {
+    txn->focus = window;
+}
+
+void txn_select_input(Transaction *txn, Window window, long event_mask) {
+    TxnEntry *entry = txn_entry(txn, window);
+    entry->flags |= TXN_INPUT;
+    entry->event_mask = event_mask;
+}
+
+void txn_set_state(Transaction *txn, Window window, long state) {
+    TxnEntry *entry = txn_entry(txn, window);
+    entry->flags |= TXN_STATE;
+    entry->state = state;
+}
+
+void txn_close(Transaction *txn, Window window) {
+    TxnEntry *entry = txn_entry(txn, window);
+    if (!(entry->flags & TXN_KILL)) {
+        entry->flags |= TXN_CLOSE;
+    }
+}
+
+/* Killing makes asking to close pointless */
+void txn_kill(Transaction *txn, Window window) {
+    TxnEntry *entry = txn_entry(txn, window);
+    entry->flags = (entry->flags & ~TXN_CLOSE) | TXN_KILL;
+}
+
+/* Forget everything pending for a window that is no longer managed. A kill
+ * still goes out: the client may only have withdrawn its window. */
+void txn_drop_window(Transaction *txn, Window window) {
+    TxnEntry *entry = txn_find(txn, window);
+    if (entry && (entry->flags & TXN_KILL)) {
+        *entry = (TxnEntry){.window = window, .flags = TXN_KILL};
+    } else if (entry) {
+        *entry = txn->entries[--txn->count];
+    }
+    if (txn->focus == window) {
+        txn->focus = None;
+    }
+}
+
+bool txn_is_empty(Transaction *txn) {
+    return txn->count == 0 && txn->focus == None;
+}
+
+/* Window rules
+ *
+ * Compiled once at startup so matching a newly mapped window costs one hash
+ * lookup on its class plus a walk of the rules that could apply, however
+ * long the rule list is. */
+
+static unsigned int hash_string(const char *string) {
+    unsigned int hash = 2166136261u;  /* FNV-1a */
+    for (; *string; string++) {
+        hash = (hash ^ (unsigned char)*string) * 16777619u;
+    }
+    return hash;
+}
+
+void rules_compile(RuleSet *set, const WindowRule *rules, int count) {
+    int bucket_count = 1;
+    while (bucket_count < 2 * count) {
+        bucket_count *= 2;
+    }
+    
+    set->rules = rules;
+    set->count = count;
+    set->bucket_mask = bucket_count - 1;
+    set->buckets = malloc(bucket_count * sizeof(int));
+    set->chain = malloc((count > 0 ? count : 1) * sizeof(int));
+    set->type_atoms = malloc((count > 0 ? count : 1) * sizeof(Atom));
+    assert(set->buckets && set->chain && set->type_atoms);
+    set->wildcard = -1;
+    set->needs = 0;
+    
+    for (int i = 0; i < bucket_count; i++) {
+        set->buckets[i] = -1;
+    }
+    
+    /* Push in reverse so every chain ends up in declaration order */
+    for (int i = count - 1; i >= 0; i--) {
+        const WindowRule *rule = &rules[i];
+        int *head = rule->class_name ?
+            &set->buckets[hash_string(rule->class_name) & set->bucket_mask] : &set->wildcard;
+        set->chain[i] = *head;
+        *head = i;
+        set->type_atoms[i] = None;
+        
+        if (rule->class_name || rule->instance) set->needs |= RULE_NEEDS_CLASS;
+        if (rule->title) set->needs |= RULE_NEEDS_TITLE;
+        if (rule->type) set->needs |= RULE_NEEDS_TYPE;
+        if (rule->floating) set->needs |= RULE_NEEDS_SIZE;
+    }
+}
+
+void rules_free(RuleSet *set) {
+    free(set->buckets);
+    free(set->chain);
+    free(set->type_atoms);
+    *set = (RuleSet){.wildcard = -1};
+}
+
+static bool text_equals(const char *want, const char *have) {
+    return !want || (have && strcmp(want, have) == 0);
+}
+
+static bool rule_matches(const RuleSet *set, int index, const WindowInfo *info) {
+    const WindowRule *rule = &set->rules[index];
+    
+    if (!text_equals(rule->class_name, info->class_name)) return false;
+    if (!text_equals(rule->instance, info->instance)) return false;
+    if (rule->title && (!info->title || !strstr(info->title, rule->title))) return false;
+    
+    if (rule->type) {
+        for (int i = 0; i < info->type_count; i++) {
+            if (info->types[i] == set->type_atoms[index]) return true;
+        }
+        return false;
+    }
+    return true;
+}
+
+/* First matching rule in declaration order, or NULL */
+const WindowRule *rules_match(const RuleSet *set, const WindowInfo *info) {
+    if (!set || set->count == 0) return NULL;
+    
+    int by_class = info->class_name ?
+        set->buckets[hash_string(info->class_name) & set->bucket_mask] : -1;
+    int wildcard = set->wildcard;
+    
+    /* Merge the two chains by rule index */
+    while (by_class >= 0 || wildcard >= 0) {
+        int index;
+        if (wildcard < 0 || (by_class >= 0 && by_class < wildcard)) {
+            index = by_class;
+            by_class = set->chain[by_class];
+        } else {
+            index = wildcard;
+            wildcard = set->chain[wildcard];
+        }
+        
+        if (rule_matches(set, index, info)) {
+            return &set->rules[index];
+        }
+    }
+    return NULL;
+}
+
+/* Key bindings */
+
+void keys_compile(KeyTable *table, const KeyBinding *bindings, const KeyCode *keycodes, int count,
+                  unsigned int ignored_modifiers) {
+    table->bindings = bindings;
+    table->count = count;
+    table->ignored_modifiers = ignored_modifiers;
+    table->keycodes = malloc((count > 0 ? count : 1) * sizeof(KeyCode));
+    table->chain = malloc((count > 0 ? count : 1) * sizeof(int));
+    assert(table->keycodes && table->chain);
+    
+    for (int i = 0; i < KEYCODE_COUNT; i++) {
+        table->heads[i] = -1;
+    }
+    
+    /* Push in reverse so each key's chain ends up in declaration order */
+    for (int i = count - 1; i >= 0; i--) {
+        table->keycodes[i] = keycodes[i];
+        table->chain[i] = -1;
+        if (keycodes[i] == 0) continue;
+        table->chain[i] = table->heads[keycodes[i]];
+        table->heads[keycodes[i]] = i;
+    }
+}
+
+void keys_free(KeyTable *table) {
+    free(table->keycodes);
+    free(table->chain);
+    *table = (KeyTable){0};
+    for (int i = 0; i < KEYCODE_COUNT; i++) {
+        table->heads[i] = -1;
+    }
+}
+
+const KeyBinding *keys_lookup(const KeyTable *table, unsigned int keycode, unsigned int state) {
+    if (keycode >= KEYCODE_COUNT || table->count == 0) return NULL;
+    
+    unsigned int modifiers = state & KEY_MODIFIER_MASK & ~table->ignored_modifiers;
+    for (int index = table->heads[keycode]; index >= 0; index = table->chain[index]) {
+        const KeyBinding *binding = &table->bindings[index];
+        if ((binding->modifiers & ~table->ignored_modifiers) == modifiers) {
+            return binding;
+        }
+    }
+    return NULL;
+}
+
+/* Request serial ranges
+ *
+ * Serials only grow and events arrive in serial order, so ranges are kept
+ * oldest first and dropped as soon as an event has gone past them. */
+
+void serial_ranges_add(SerialRanges *ranges, unsigned long start, unsigned long end) {
+    if (ranges->count == SERIAL_RANGE_SLOTS) {
+        /* Out of slots: fold the two oldest ranges together */
+        int second = (ranges->head + 1) % SERIAL_RANGE_SLOTS;
+        ranges->start[second] = ranges->start[ranges->head];
+        ranges->head = second;
+        ranges->count--;
+    }
+    
+    int slot = (ranges->head + ranges->count) % SERIAL_RANGE_SLOTS;
+    ranges->start[slot] = start;
+    ranges->end[slot] = end;
+    ranges->count++;
+}
+
+bool serial_ranges_contains(SerialRanges *ranges, unsigned long serial) {
+    while (ranges->count > 0 && ranges->end[ranges->head] <= serial) {
+        ranges->head = (ranges->head + 1) % SERIAL_RANGE_SLOTS;
+        ranges->count--;
+    }
+    
+    for (int i = 0; i < ranges->count; i++) {
+        int slot = (ranges->head + i) % SERIAL_RANGE_SLOTS;
+        if (serial >= ranges->start[slot] && serial < ranges->end[slot]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Timer wheel
+ *
+ * Timers hash into slots by absolute expiry tick. A slot can hold timers from
+ * later wheel revolutions, so expiry is always checked against the tick, not
+ * just the slot position. Timers are intrusive: owners embed them and no
+ * allocation happens on schedule or cancel. */
+
+void timer_wheel_init(TimerWheel *wheel, unsigned long now_tick) {
+    assert(wheel != NULL);
+    
+    for (int i = 0; i < TIMER_WHEEL_SLOTS; i++) {
+        wheel->slots[i] = NULL;
+    }
+    wheel->current_tick = now_tick;
+    wheel->active_count = 0;
+}
+
+void timer_init(Timer *timer, void (*callback)(Timer *timer), void *data) {
+    assert(timer != NULL);
+    
+    timer->expires = 0;
+    timer->callback = callback;
+    timer->data = data;
+    timer->active = false;
+    timer->next = NULL;
+}
+
+void timer_schedule(TimerWheel *wheel, Timer *timer, unsigned long delay_ticks) {
+    if (!wheel || !timer) {
+        return;
+    }
+    
+    if (timer->active) {
+        timer_cancel(wheel, timer);
+    }
+    
+    /* A zero delay still waits for the next tick so callbacks never recurse */
+    if (delay_ticks == 0) {
+        delay_ticks = 1;
+    }
+    
+    timer->expires = wheel->current_tick + delay_ticks;
+    Timer **slot = &wheel->slots[timer->expires % TIMER_WHEEL_SLOTS];
+    timer->next = *slot;
+    *slot = timer;
+    timer->active = true;
+    wheel->active_count++;
+}
+
+void timer_cancel(TimerWheel *wheel, Timer *timer) {
+    if (!wheel || !timer || !timer->active) {
+        return;
+    }
+    
+    Timer **current = &wheel->slots[timer->expires % TIMER_WHEEL_SLOTS];
+    while (*current) {
+        if (*current == timer) {
+            *current = timer->next;
+            break;
+        }
+        current = &(*current)->next;
+    }
+    
+    timer->next = NULL;
+    timer->active = false;
+    wheel->active_count--;
+}
+
+/* Only advancing moves the wheel's clock, and nothing advances an idle
+ * wheel. Bring it up to now before scheduling into it, or a new timer is
+ * measured from whenever the last one fired and goes off at once. Pending
+ * timers keep the clock moving, so the wheel is left alone then. */
+void timer_wheel_sync(TimerWheel *wheel, unsigned long now_tick) {
+    if (wheel && wheel->active_count == 0 && now_tick > wheel->current_tick) {
+        wheel->current_tick = now_tick;
+    }
+}
+
+/* Fire every timer due at or before now_tick. Returns the number fired. */
+int timer_wheel_advance(TimerWheel *wheel, unsigned long now_tick) {
+    if (!wheel || now_tick <= wheel->current_tick) {
+        return 0;
+    }
+    
+    /* After a long stall one revolution covers every slot */
+    unsigned long steps = now_tick - wheel->current_tick;
+    if (steps > TIMER_WHEEL_SLOTS) {
+        steps = TIMER_WHEEL_SLOTS;
+    }
+    
+    /* Unlink everything due first, so callbacks are free to reschedule */
+    Timer *expired = NULL;
+    for (unsigned long i = 1; i <= steps; i++) {
+        Timer **current = &wheel->slots[(wheel->current_tick + i) % TIMER_WHEEL_SLOTS];
+        while (*current) {
+            Timer *timer = *current;
+            if (timer->expires <= now_tick) {
+                *current = timer->next;
+                timer->active = false;
+                timer->next = expired;
+                expired = timer;
+                wheel->active_count--;
+            } else {
+                current = &timer->next;
+            }
+        }
+    }
+    wheel->current_tick = now_tick;
+    
+    int fired = 0;
+    while (expired) {
+        Timer *timer = expired;
+        expired = timer->next;
+        timer->next = NULL;
+        if (timer->callback) {
+            timer->callback(timer);
+        }
+        fired++;
+    }
+    
+    return fired;
+}
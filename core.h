@@ -1,8 +1,11 @@
 #ifndef CORE_H
 #define CORE_H
 
+#include <stdbool.h>
 #include <X11/Xlib.h>
 #include <X11/extensions/Xinerama.h>
+#include "config.h"
+#include "settings.h"
 
 /* Data structures */
 typedef struct {
@@ -10,17 +13,194 @@ typedef struct {
 } Rectangle;
 
 typedef struct {
-    Rectangle geometry;
+    Rectangle geometry;   /* Usable area, what is left of area beside docks */
+    Rectangle area;       /* The zone's whole share of its monitor */
+    Rectangle monitor;    /* The whole monitor, to split it again */
     int monitor_id;  /* Physical monitor this zone belongs to */
     int zone_id;     /* 0 for single zone, 0-2 for ultrawide zones */
 } LogicalZone;
 
+/* Intrusive timer, embedded in whatever object owns the delayed work */
+typedef struct Timer {
+    unsigned long expires;        /* Absolute expiry in wheel ticks */
+    void (*callback)(struct Timer *timer);
+    void *data;
+    bool active;
+    struct Timer *next;
+} Timer;
+
+typedef struct {
+    Timer *slots[TIMER_WHEEL_SLOTS];
+    unsigned long current_tick;
+    int active_count;
+} TimerWheel;
+
 typedef struct Client {
     Window window;
     int zone_index;
+    Timer kill_timer;             /* Armed while a WM_DELETE_WINDOW is pending */
+    bool hidden;                  /* Unmapped by swm in a monocle zone */
+    int ignore_unmap;             /* UnmapNotify events swm caused and must not treat as withdrawal */
+    bool floating;                /* Own size, centered over the zone, above its tiled clients */
+    int width, height;            /* Own size of a floating client */
     struct Client *next;
+    struct Client *stack_next;    /* Next client down in the zone's stacking order */
 } Client;
 
+/* Pending X requests for one window within a transaction */
+enum {
+    TXN_GEOMETRY = 1 << 0,
+    TXN_BORDER   = 1 << 1,
+    TXN_MAP      = 1 << 2,
+    TXN_UNMAP    = 1 << 3,
+    TXN_INPUT    = 1 << 4,        /* Event mask to select */
+    TXN_STATE    = 1 << 5,        /* WM_STATE and _NET_WM_STATE to write */
+    TXN_CLOSE    = 1 << 6,        /* WM_DELETE_WINDOW to send */
+    TXN_KILL     = 1 << 7         /* Client to kill */
+};
+
+typedef struct {
+    Window window;
+    unsigned int flags;           /* TXN_* bits */
+    Rectangle geometry;
+    unsigned long border_color;
+    long event_mask;
+    long state;                   /* NormalState or IconicState */
+} TxnEntry;
+
+/* X requests collected over one event batch, deduplicated per window */
+typedef struct {
+    TxnEntry *entries;
+    int count;
+    int capacity;
+    Window focus;                 /* Last focus request wins */
+} Transaction;
+
+/* Request serial ranges of swm's own layout bursts. Crossing events carrying
+ * one of these serials were caused by swm, not by the pointer moving. */
+#define SERIAL_RANGE_SLOTS 8
+
+typedef struct {
+    unsigned long start[SERIAL_RANGE_SLOTS];
+    unsigned long end[SERIAL_RANGE_SLOTS];   /* Exclusive */
+    int head;
+    int count;
+} SerialRanges;
+
+/* A window rule from WINDOW_RULES in config.h. NULL fields match anything. */
+typedef struct {
+    const char *class_name;
+    const char *instance;
+    const char *title;            /* Substring of the window title */
+    const char *type;             /* _NET_WM_WINDOW_TYPE atom name */
+    int zone;                     /* Target zone, -1 for the active zone */
+    bool floating;                /* Keep the client's own size, centered, instead of filling the zone */
+    bool focus;                   /* Take focus when mapped */
+} WindowRule;
+
+/* Window properties the rules need, fetched once per map */
+enum {
+    RULE_NEEDS_CLASS = 1 << 0,
+    RULE_NEEDS_TITLE = 1 << 1,
+    RULE_NEEDS_TYPE  = 1 << 2,
+    RULE_NEEDS_SIZE  = 1 << 3         /* A floating rule keeps the window's own size */
+};
+
+#define RULE_MAX_TYPES 4
+
+typedef struct {
+    const char *class_name;
+    const char *instance;
+    const char *title;
+    Atom types[RULE_MAX_TYPES];
+    int type_count;
+} WindowInfo;
+
+/* Rules compiled into a hash on class name. Rules without a class sit on a
+ * separate wildcard chain; both chains are kept in declaration order. */
+typedef struct {
+    const WindowRule *rules;
+    Atom *type_atoms;             /* Resolved rule types, None when unset */
+    int count;
+    int *buckets;                 /* Head rule index per bucket, -1 when empty */
+    int bucket_mask;
+    int *chain;                   /* Next rule index in the same chain, -1 at the end */
+    int wildcard;                 /* Head of the classless chain */
+    unsigned int needs;           /* RULE_NEEDS_* bits */
+} RuleSet;
+
+/* A key binding from KEY_BINDINGS in config.h */
+typedef struct {
+    unsigned int modifiers;       /* ShiftMask, ControlMask, Mod1Mask ... Mod5Mask */
+    KeySym keysym;
+    int command;                  /* enum swm_command */
+    long argument;                /* For commands that take one */
+} KeyBinding;
+
+#define KEYCODE_COUNT 256
+
+/* Modifiers that take part in matching; CapsLock and NumLock never do */
+#define KEY_MODIFIER_MASK (ShiftMask | ControlMask | Mod1Mask | Mod2Mask | Mod3Mask | Mod4Mask | Mod5Mask)
+
+/* Bindings indexed by keycode. Bindings on the same key are chained in
+ * declaration order, so a key press costs one array lookup and a walk over
+ * the few modifier combinations bound to that key. */
+typedef struct {
+    const KeyBinding *bindings;
+    KeyCode *keycodes;            /* Resolved per binding, 0 when no key produces the keysym */
+    int count;
+    int heads[KEYCODE_COUNT];     /* First binding per keycode, -1 when unbound */
+    int *chain;                   /* Next binding on the same keycode, -1 at the end */
+    unsigned int ignored_modifiers;  /* LockMask plus whichever modifier NumLock is on */
+} KeyTable;
+
+/* EWMH atoms, in the order they are advertised in _NET_SUPPORTED */
+enum {
+    NET_SUPPORTED,
+    NET_SUPPORTING_WM_CHECK,
+    NET_WM_NAME,
+    NET_CLIENT_LIST,
+    NET_ACTIVE_WINDOW,
+    NET_CLOSE_WINDOW,
+    NET_WM_WINDOW_TYPE,
+    NET_WM_WINDOW_TYPE_DIALOG,
+    NET_WM_WINDOW_TYPE_UTILITY,
+    NET_WM_WINDOW_TYPE_SPLASH,
+    NET_WM_WINDOW_TYPE_TOOLBAR,
+    NET_WM_WINDOW_TYPE_DOCK,
+    NET_WM_STRUT,
+    NET_WM_STRUT_PARTIAL,
+    NET_WM_STATE,
+    NET_WM_STATE_HIDDEN,
+    NET_ATOM_COUNT
+};
+
+/* ICCCM atoms */
+enum {
+    WM_PROTOCOLS,
+    WM_DELETE_WINDOW,
+    WM_STATE,
+    WM_ATOM_COUNT
+};
+
+/* Root properties waiting to be published at the end of the loop iteration */
+enum {
+    EWMH_DIRTY_CLIENT_LIST   = 1 << 0,
+    EWMH_DIRTY_ACTIVE_WINDOW = 1 << 1
+};
+
+/* _NET_WM_STRUT_PARTIAL: left, right, top, bottom, then the start and end
+ * of each along its edge */
+#define STRUT_VALUES 12
+
+/* Panel or bar that reserves a screen edge instead of being managed */
+typedef struct Dock {
+    Window window;
+    long strut[STRUT_VALUES];     /* All zero when it reserves nothing */
+    bool stale;                   /* Strut to be re-read before the next relayout */
+    struct Dock *next;
+} Dock;
+
 typedef struct DisplayManager {
     Display *x_display;
     int screen;
@@ -33,19 +213,67 @@ typedef struct DisplayManager {
     /* Ultra-simple zone-based client management */
     Client **zone_clients;        /* Array of client lists per zone */
     int *zone_current_index;      /* Array of current client indices per zone */
+    Client **zone_stack;          /* Array of per-zone stacking orders, topmost first */
+    bool *zone_stack_dirty;       /* Model order differs from what the server has */
+    bool *zone_monocle;           /* Only the current client of the zone stays mapped */
+    
+    Dock *docks;
+    bool struts_dirty;            /* Zone usable areas to be recomputed at commit */
+    bool command_pending;         /* _SWM_COMMAND was appended to and not yet read */
     
     Atom command_atom;
+    Atom wm_atoms[WM_ATOM_COUNT];
+    Atom net_atoms[NET_ATOM_COUNT];
+    Atom utf8_string_atom;
+    Window wm_check_window;
+    unsigned int ewmh_dirty;      /* EWMH_DIRTY_* bits */
     struct DisplayManager *next;
 } DisplayManager;
 
+/* X traffic per kind of handler invocation, see dispatch_event() */
+enum {
+    STATS_MAP,
+    STATS_UNMAP,
+    STATS_DESTROY,
+    STATS_ENTER,
+    STATS_MESSAGE,                /* _NET_ACTIVE_WINDOW and _NET_CLOSE_WINDOW */
+    STATS_COMMAND_READ,           /* Reading the _SWM_COMMAND property */
+    STATS_COMMIT,                 /* commit_batch(): the requests handlers deferred */
+    STATS_STRUTS,                 /* Re-reading changed struts before a commit */
+    STATS_COMMAND,                /* Plus the command number, for execute_command() */
+    STATS_COUNT = STATS_COMMAND + CMD_COUNT
+};
+
+typedef struct {
+    unsigned long calls;
+    unsigned long requests;
+    unsigned long round_trips;
+    unsigned long max_requests;   /* Worst single invocation */
+    unsigned long max_round_trips;
+} HandlerStats;
+
 typedef struct {
     DisplayManager *displays;
     DisplayManager *active_display;
     int display_count;
+    
+    TimerWheel timers;
+    Transaction txn;
+    RuleSet rules;
+    KeyTable keys;
+    SerialRanges self_crossing;   /* Layout bursts whose EnterNotify events to ignore */
+    HandlerStats stats[STATS_COUNT];
+    Settings settings;            /* Resolved from config.h and the settings file */
+    const char *settings_path;    /* Re-read by CMD_RELOAD_SETTINGS, NULL for none */
+    bool running;
 } WindowManager;
 
 /* Core functions */
 int calculate_zones(XineramaScreenInfo *monitors, int monitor_count, LogicalZone **zones);
+int calculate_layout_zones(XineramaScreenInfo *monitors, int monitor_count, const ZoneLayout *layout,
+                           LogicalZone **zones);
+int resplit_zones(DisplayManager *display, const ZoneLayout *layout);
+bool set_zone_split(DisplayManager *display, int zone, int x);
 
 /* Simplified zone-based client management functions */
 Client *get_current_client_in_zone(DisplayManager *display, int zone);
@@ -53,4 +281,80 @@ int count_clients_in_zone(DisplayManager *display, int zone);
 void add_client_to_zone(DisplayManager *display, int zone, Client *client);
 void remove_client_from_zone(DisplayManager *display, int zone, Client *client);
 
+/* State transitions shared by the window manager and the trace replayer */
+void insert_new_client(DisplayManager *display, Client *client, int zone);
+void make_client_current(DisplayManager *display, Client *client);
+Client *step_zone_current(DisplayManager *display, int direction);
+int step_active_zone(DisplayManager *display, int direction);
+void move_client_to_zone(DisplayManager *display, Client *client, int zone);
+int move_zone_clients(DisplayManager *display, int from, int to);
+Client *swap_with_first(DisplayManager *display, Client *client);
+
+/* Per-zone stacking model */
+void stack_push(DisplayManager *display, int zone, Client *client);
+void stack_remove(DisplayManager *display, int zone, Client *client);
+bool stack_raise(DisplayManager *display, int zone, Client *client);
+Client *stack_top(DisplayManager *display, int zone);
+int collect_zone_stack(DisplayManager *display, int zone, Window *windows, int max);
+int find_client_index_in_zone(DisplayManager *display, int zone, Client *client);
+Client *find_client_by_window(DisplayManager *display, Window window);
+DisplayManager *find_display_by_root(DisplayManager *displays, Window root);
+Client *find_client_on_any_display(DisplayManager *displays, Window window, DisplayManager **found);
+DisplayManager *step_display(DisplayManager *displays, DisplayManager *display, int direction);
+int count_managed_clients(DisplayManager *display);
+
+/* Docks and the zone areas their struts reserve */
+Dock *find_dock(DisplayManager *display, Window window);
+bool remove_dock(DisplayManager *display, Window window);
+void free_docks(DisplayManager *display);
+void strut_from_legacy(const long *legacy, long *strut);
+int apply_struts(DisplayManager *display, bool *changed);
+int collect_client_windows(DisplayManager *display, Window *windows, int max);
+Window get_active_window(DisplayManager *display);
+
+/* EWMH publishing state */
+void mark_ewmh_dirty(DisplayManager *display, unsigned int flags);
+unsigned int take_ewmh_dirty(DisplayManager *display);
+
+/* X request transactions */
+void txn_init(Transaction *txn);
+void txn_reset(Transaction *txn);
+void txn_free(Transaction *txn);
+TxnEntry *txn_entry(Transaction *txn, Window window);
+TxnEntry *txn_find(Transaction *txn, Window window);
+void txn_set_geometry(Transaction *txn, Window window, Rectangle geometry);
+void txn_set_border(Transaction *txn, Window window, unsigned long color);
+void txn_map(Transaction *txn, Window window);
+void txn_unmap(Transaction *txn, Window window);
+void txn_focus(Transaction *txn, Window window);
+void txn_select_input(Transaction *txn, Window window, long event_mask);
+void txn_set_state(Transaction *txn, Window window, long state);
+void txn_close(Transaction *txn, Window window);
+void txn_kill(Transaction *txn, Window window);
+void txn_drop_window(Transaction *txn, Window window);
+bool txn_is_empty(Transaction *txn);
+
+/* Window rules */
+void rules_compile(RuleSet *set, const WindowRule *rules, int count);
+void rules_free(RuleSet *set);
+const WindowRule *rules_match(const RuleSet *set, const WindowInfo *info);
+
+/* Key bindings */
+void keys_compile(KeyTable *table, const KeyBinding *bindings, const KeyCode *keycodes, int count,
+                  unsigned int ignored_modifiers);
+void keys_free(KeyTable *table);
+const KeyBinding *keys_lookup(const KeyTable *table, unsigned int keycode, unsigned int state);
+
+/* Request serial ranges */
+void serial_ranges_add(SerialRanges *ranges, unsigned long start, unsigned long end);
+bool serial_ranges_contains(SerialRanges *ranges, unsigned long serial);
+
+/* Timer wheel */
+void timer_wheel_init(TimerWheel *wheel, unsigned long now_tick);
+void timer_init(Timer *timer, void (*callback)(Timer *timer), void *data);
+void timer_schedule(TimerWheel *wheel, Timer *timer, unsigned long delay_ticks);
+void timer_cancel(TimerWheel *wheel, Timer *timer);
+int timer_wheel_advance(TimerWheel *wheel, unsigned long now_tick);
+void timer_wheel_sync(TimerWheel *wheel, unsigned long now_tick);
+
 #endif /* CORE_H */ 
\ No newline at end of file
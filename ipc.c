@@ -0,0 +1,432 @@
+#define _GNU_SOURCE  /* For shm_open, accept4 and SO_PEERCRED */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "config.h"
+#include "ipc.h"
+
+/* Shared-memory state block
+ *
+ * The writer bumps the sequence to an odd value, copies the payload in and
+ * bumps it back to even. Readers copy the block out and keep the copy only if
+ * they saw the same even sequence before and after. Mapping it costs readers
+ * one shm_open and mmap; every snapshot after that is plain memory reads. */
+
+/* Readers give up after this many torn reads (a writer killed mid-update) */
+#define IPC_READ_RETRIES 1000
+
+static SwmState *state_block = NULL;
+static char state_name[64];
+
+void ipc_state_name(char *name, size_t size, const char *display_name) {
+    if (!display_name || !*display_name) {
+        display_name = getenv("DISPLAY");
+    }
+    if (!display_name || !*display_name) {
+        display_name = ":0";
+    }
+
+    snprintf(name, size, "/swm-%u-%s", (unsigned)getuid(), display_name);
+
+    /* Only the leading slash is allowed in a shm name */
+    for (char *c = name + 1; *c; c++) {
+        if (*c == '/') *c = '_';
+    }
+}
+
+bool ipc_state_open(const char *name) {
+    assert(name != NULL);
+
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+    if (fd < 0) {
+        perror(name);
+        return false;
+    }
+
+    if (ftruncate(fd, sizeof(SwmState)) < 0) {
+        perror(name);
+        close(fd);
+        shm_unlink(name);
+        return false;
+    }
+
+    void *map = mmap(NULL, sizeof(SwmState), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror(name);
+        shm_unlink(name);
+        return false;
+    }
+
+    /* A block left behind by a crashed swm is reused from scratch */
+    state_block = map;
+    memset(state_block, 0, sizeof(SwmState));
+    state_block->version = SWM_STATE_VERSION;
+    state_block->size = sizeof(SwmState);
+    state_block->pid = (uint32_t)getpid();
+    __atomic_store_n(&state_block->magic, SWM_STATE_MAGIC, __ATOMIC_RELEASE);
+
+    snprintf(state_name, sizeof(state_name), "%s", name);
+    return true;
+}
+
+void ipc_state_publish(const SwmState *state) {
+    if (!state_block) {
+        return;
+    }
+
+    /* Everything from pid onwards is payload; the header never changes */
+    size_t offset = offsetof(SwmState, pid);
+    uint32_t sequence = state_block->sequence;
+
+    __atomic_store_n(&state_block->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    memcpy((char *)state_block + offset, (const char *)state + offset, sizeof(SwmState) - offset);
+    state_block->pid = (uint32_t)getpid();
+    state_block->updates = (uint64_t)(sequence / 2) + 1;
+
+    __atomic_store_n(&state_block->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+void ipc_state_close(void) {
+    if (state_block) {
+        munmap(state_block, sizeof(SwmState));
+        shm_unlink(state_name);
+        state_block = NULL;
+    }
+}
+
+bool ipc_state_is_active(void) {
+    return state_block != NULL;
+}
+
+/* Reader side */
+
+const SwmState *ipc_state_attach(const char *name) {
+    assert(name != NULL);
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(SwmState)) {
+        close(fd);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, sizeof(SwmState), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    return map == MAP_FAILED ? NULL : map;
+}
+
+bool ipc_state_read(const SwmState *shared, SwmState *snapshot) {
+    assert(shared != NULL && snapshot != NULL);
+
+    if (__atomic_load_n(&shared->magic, __ATOMIC_ACQUIRE) != SWM_STATE_MAGIC ||
+        shared->version != SWM_STATE_VERSION || shared->size != sizeof(SwmState)) {
+        return false;
+    }
+
+    for (int attempt = 0; attempt < IPC_READ_RETRIES; attempt++) {
+        uint32_t before = __atomic_load_n(&shared->sequence, __ATOMIC_ACQUIRE);
+        if (before & 1) {
+            continue;
+        }
+
+        memcpy(snapshot, (const void *)shared, sizeof(SwmState));
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&shared->sequence, __ATOMIC_RELAXED) == before) {
+            snapshot->sequence = before;
+            snapshot->focused_title[SWM_STATE_TITLE_MAX - 1] = '\0';
+            return true;
+        }
+    }
+    return false;
+}
+
+void ipc_state_detach(const SwmState *shared) {
+    if (shared) {
+        munmap((void *)shared, sizeof(SwmState));
+    }
+}
+
+/* Event subscriptions
+ *
+ * The listening socket and every subscriber live in a private epoll set whose
+ * descriptor swm polls alongside the X connection. Emitting only copies the
+ * event into interested queues; ipc_server_flush writes them out with
+ * non-blocking sends after each batch, and a subscriber whose socket is full
+ * is watched for EPOLLOUT until it catches up. */
+
+typedef struct {
+    int fd;                       /* -1 for a free slot */
+    uint32_t mask;                /* SWM_EVENT_MASK() bits */
+    uint8_t next_mask[sizeof(uint32_t)];
+    size_t next_length;           /* Bytes of next_mask received so far */
+    uint32_t dropped;             /* Lost since the last queued event */
+    SwmEvent queue[SUBSCRIBER_QUEUE];
+    int head, count;
+    size_t sent;                  /* Bytes of queue[head] already written */
+    bool waiting;                 /* Registered for EPOLLOUT */
+} Subscriber;
+
+static int server_fd = -1;
+static int server_epoll = -1;
+static Subscriber subscribers[SUBSCRIBERS_MAX];
+static int subscriber_total = 0;
+
+static socklen_t socket_address(struct sockaddr_un *address, const char *name) {
+    /* Abstract namespace: nothing to clean up if swm dies */
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    size_t length = strlen(name);
+    if (length > sizeof(address->sun_path) - 1) {
+        length = sizeof(address->sun_path) - 1;
+    }
+    memcpy(address->sun_path + 1, name, length);
+    return (socklen_t)(offsetof(struct sockaddr_un, sun_path) + 1 + length);
+}
+
+static void subscriber_drop(Subscriber *subscriber) {
+    epoll_ctl(server_epoll, EPOLL_CTL_DEL, subscriber->fd, NULL);
+    close(subscriber->fd);
+    subscriber->fd = -1;
+    subscriber_total--;
+}
+
+static void subscriber_watch_output(Subscriber *subscriber, bool watch) {
+    if (subscriber->waiting == watch) return;
+    struct epoll_event ev = {.events = EPOLLIN | (watch ? EPOLLOUT : 0), .data.ptr = subscriber};
+    epoll_ctl(server_epoll, EPOLL_CTL_MOD, subscriber->fd, &ev);
+    subscriber->waiting = watch;
+}
+
+static void subscriber_push(Subscriber *subscriber, int type, uint64_t window, int zone) {
+    int tail = (subscriber->head + subscriber->count) % SUBSCRIBER_QUEUE;
+    subscriber->queue[tail] = (SwmEvent){
+        .type = (uint16_t)type,
+        .zone = (int16_t)zone,
+        .dropped = subscriber->dropped,
+        .window = window
+    };
+    subscriber->dropped = 0;
+    subscriber->count++;
+}
+
+/* Write as much of the queue as the socket takes without blocking */
+static void subscriber_flush(Subscriber *subscriber) {
+    /* Report losses now rather than with whatever event comes next */
+    if (subscriber->dropped && subscriber->count < SUBSCRIBER_QUEUE) {
+        subscriber_push(subscriber, SWM_EVENT_DROPPED, 0, -1);
+    }
+    while (subscriber->count > 0) {
+        int contiguous = SUBSCRIBER_QUEUE - subscriber->head;
+        if (contiguous > subscriber->count) contiguous = subscriber->count;
+        const char *data = (const char *)&subscriber->queue[subscriber->head] + subscriber->sent;
+        size_t length = contiguous * sizeof(SwmEvent) - subscriber->sent;
+
+        ssize_t written = send(subscriber->fd, data, length, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                subscriber_watch_output(subscriber, true);
+                return;
+            }
+            subscriber_drop(subscriber);
+            return;
+        }
+
+        size_t total = subscriber->sent + (size_t)written;
+        int done = (int)(total / sizeof(SwmEvent));
+        subscriber->sent = total % sizeof(SwmEvent);
+        subscriber->head = (subscriber->head + done) % SUBSCRIBER_QUEUE;
+        subscriber->count -= done;
+    }
+    subscriber_watch_output(subscriber, false);
+}
+
+/* Mask updates; end of file or an error ends the subscription. A stream
+ * socket can split a mask across reads, so its bytes are kept until all of
+ * them are in. */
+static void subscriber_read(Subscriber *subscriber) {
+    uint8_t buffer[64];
+    for (;;) {
+        ssize_t length = recv(subscriber->fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (length > 0) {
+            for (ssize_t i = 0; i < length; i++) {
+                subscriber->next_mask[subscriber->next_length++] = buffer[i];
+                if (subscriber->next_length == sizeof(uint32_t)) {
+                    memcpy(&subscriber->mask, subscriber->next_mask, sizeof(uint32_t));
+                    subscriber->next_length = 0;
+                }
+            }
+            continue;
+        }
+        if (length < 0 && errno == EINTR) continue;
+        if (length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        subscriber_drop(subscriber);
+        return;
+    }
+}
+
+static void server_accept(void) {
+    for (;;) {
+        int fd = accept4(server_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+
+        /* Same user only, like the 0600 state segment */
+        struct ucred credentials;
+        socklen_t size = sizeof(credentials);
+        if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &size) < 0 ||
+            credentials.uid != getuid()) {
+            close(fd);
+            continue;
+        }
+
+        Subscriber *subscriber = NULL;
+        for (int i = 0; i < SUBSCRIBERS_MAX && !subscriber; i++) {
+            if (subscribers[i].fd < 0) subscriber = &subscribers[i];
+        }
+        if (!subscriber) {
+            close(fd);
+            continue;
+        }
+
+        subscriber->fd = fd;
+        subscriber->mask = 0;
+        subscriber->next_length = 0;
+        subscriber->dropped = 0;
+        subscriber->head = 0;
+        subscriber->count = 0;
+        subscriber->sent = 0;
+        subscriber->waiting = false;
+        struct epoll_event ev = {.events = EPOLLIN, .data.ptr = subscriber};
+        epoll_ctl(server_epoll, EPOLL_CTL_ADD, fd, &ev);
+        subscriber_total++;
+
+        /* The mask usually arrives with the connection */
+        subscriber_read(subscriber);
+    }
+}
+
+int ipc_server_open(const char *name) {
+    assert(name != NULL);
+    for (int i = 0; i < SUBSCRIBERS_MAX; i++) {
+        subscribers[i].fd = -1;
+    }
+
+    struct sockaddr_un address;
+    socklen_t length = socket_address(&address, name);
+    server_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    server_epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (server_fd < 0 || server_epoll < 0 ||
+        bind(server_fd, (struct sockaddr *)&address, length) < 0 ||
+        listen(server_fd, SUBSCRIBERS_MAX) < 0) {
+        perror(name);
+        ipc_server_close();
+        return -1;
+    }
+
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+    epoll_ctl(server_epoll, EPOLL_CTL_ADD, server_fd, &ev);
+    return server_epoll;
+}
+
+void ipc_server_dispatch(void) {
+    if (server_epoll < 0) return;
+
+    struct epoll_event ready[SUBSCRIBERS_MAX + 1];
+    int count = epoll_wait(server_epoll, ready, SUBSCRIBERS_MAX + 1, 0);
+    for (int i = 0; i < count; i++) {
+        Subscriber *subscriber = ready[i].data.ptr;
+        if (!subscriber) {
+            server_accept();
+            continue;
+        }
+        if (subscriber->fd < 0) continue;
+        if (ready[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+            subscriber_read(subscriber);
+        }
+        if (subscriber->fd >= 0 && (ready[i].events & EPOLLOUT)) {
+            subscriber_flush(subscriber);
+        }
+    }
+}
+
+void ipc_emit(int type, uint64_t window, int zone) {
+    if (subscriber_total == 0) return;
+
+    for (int i = 0; i < SUBSCRIBERS_MAX; i++) {
+        Subscriber *subscriber = &subscribers[i];
+        if (subscriber->fd < 0 || !(subscriber->mask & SWM_EVENT_MASK(type))) continue;
+
+        if (subscriber->count == SUBSCRIBER_QUEUE) {
+            if (subscriber->dropped < UINT32_MAX) subscriber->dropped++;
+            continue;
+        }
+        subscriber_push(subscriber, type, window, zone);
+    }
+}
+
+void ipc_server_flush(void) {
+    if (subscriber_total == 0) return;
+
+    for (int i = 0; i < SUBSCRIBERS_MAX; i++) {
+        /* Subscribers waiting for EPOLLOUT are flushed from dispatch */
+        Subscriber *subscriber = &subscribers[i];
+        if (subscriber->fd >= 0 && (subscriber->count > 0 || subscriber->dropped) && !subscriber->waiting) {
+            subscriber_flush(subscriber);
+        }
+    }
+}
+
+void ipc_server_close(void) {
+    for (int i = 0; i < SUBSCRIBERS_MAX; i++) {
+        if (subscribers[i].fd >= 0 && server_epoll >= 0) {
+            subscriber_drop(&subscribers[i]);
+        }
+    }
+    if (server_fd >= 0) close(server_fd);
+    if (server_epoll >= 0) close(server_epoll);
+    server_fd = -1;
+    server_epoll = -1;
+    subscriber_total = 0;
+}
+
+int ipc_subscriber_count(void) {
+    return subscriber_total;
+}
+
+int ipc_subscribe(const char *name, uint32_t mask) {
+    assert(name != NULL);
+
+    struct sockaddr_un address;
+    socklen_t length = socket_address(&address, name);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&address, length) < 0 ||
+        send(fd, &mask, sizeof(mask), MSG_NOSIGNAL) != (ssize_t)sizeof(mask)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
@@ -0,0 +1,96 @@
+#ifndef IPC_H
+#define IPC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Read-only state export for status bars and scripts
+ *
+ * swm keeps a small versioned SwmState block in a POSIX shared memory
+ * segment and rewrites it only when something visible changed. Readers map
+ * it read-only and take lock-free snapshots, retrying while the sequence
+ * number is odd or changes under them (a seqlock). */
+
+#define SWM_STATE_MAGIC      0x534d5753  /* "SWMS" */
+#define SWM_STATE_VERSION    1
+#define SWM_STATE_MAX_ZONES  16
+#define SWM_STATE_TITLE_MAX  128
+
+typedef struct {
+    int32_t x, y, width, height;
+    uint32_t client_count;
+    uint32_t monocle;
+    uint64_t current_window;
+} SwmStateZone;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;                /* sizeof(SwmState) of the writer */
+    uint32_t sequence;            /* Odd while an update is in progress */
+    uint32_t pid;
+    uint64_t updates;             /* Number of published changes */
+    uint32_t zone_count;
+    int32_t active_zone;
+    uint64_t focused_window;
+    char focused_title[SWM_STATE_TITLE_MAX];
+    SwmStateZone zones[SWM_STATE_MAX_ZONES];
+} SwmState;
+
+/* Segment name for an X display, e.g. "/swm-1000-:0" */
+void ipc_state_name(char *name, size_t size, const char *display_name);
+
+/* Writer side, in swm */
+bool ipc_state_open(const char *name);
+void ipc_state_publish(const SwmState *state);
+void ipc_state_close(void);
+bool ipc_state_is_active(void);
+
+/* Reader side */
+const SwmState *ipc_state_attach(const char *name);
+bool ipc_state_read(const SwmState *shared, SwmState *snapshot);
+void ipc_state_detach(const SwmState *shared);
+
+/* Event subscriptions
+ *
+ * Subscribers connect to the abstract Unix socket named after the state
+ * segment and write a uint32_t mask of SWM_EVENT_MASK() bits, which they can
+ * resend at any time. swm then streams fixed-size SwmEvent records for every
+ * matching change. Each subscriber has a bounded queue; when it is full new
+ * events are dropped and counted, and the next record sent reports how many
+ * were lost, so a stalled reader never blocks swm. */
+
+enum {
+    SWM_EVENT_DROPPED = 0,        /* Only reports a drop count, once the queue has room again */
+    SWM_EVENT_FOCUS,               /* Focus moved: window (None if nothing is focused), zone */
+    SWM_EVENT_MAP,                /* Window managed: window, zone */
+    SWM_EVENT_UNMAP,              /* Window no longer managed: window, zone it was in */
+    SWM_EVENT_ZONE,               /* Active zone changed: zone */
+    SWM_EVENT_MOVE,               /* Window moved to another zone: window, new zone */
+    SWM_EVENT_TYPE_COUNT
+};
+
+#define SWM_EVENT_MASK(type) (1u << (type))
+#define SWM_EVENT_MASK_ALL   (((1u << SWM_EVENT_TYPE_COUNT) - 1) & ~1u)
+
+typedef struct {
+    uint16_t type;                /* SWM_EVENT_* */
+    int16_t zone;
+    uint32_t dropped;             /* Events this subscriber lost just before this one */
+    uint64_t window;
+} SwmEvent;
+
+/* Server side, in swm. ipc_server_open returns a descriptor to poll for
+ * input; call ipc_server_dispatch when it is readable. */
+int ipc_server_open(const char *name);
+void ipc_server_dispatch(void);
+void ipc_emit(int type, uint64_t window, int zone);
+void ipc_server_flush(void);
+void ipc_server_close(void);
+int ipc_subscriber_count(void);
+
+/* Client side */
+int ipc_subscribe(const char *name, uint32_t mask);
+
+#endif /* IPC_H */
@@ -0,0 +1,157 @@
+#define _DEFAULT_SOURCE  /* For clock_gettime */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <time.h>
+#include "config.h"
+#include "core.h"
+#include "record.h"
+
+/* Event trace recording
+ *
+ * Records go through stdio buffering, so the hot path costs one struct copy
+ * and an occasional write. Nothing is recorded unless SWM_TRACE is set. */
+
+static FILE *record_file = NULL;
+static uint64_t record_last_us = 0;
+
+static uint64_t monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+bool record_open(const char *path, LogicalZone *zones, int zone_count) {
+    assert(path != NULL);
+    
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        perror(path);
+        return false;
+    }
+    
+    if (!record_write_header(file, zones, zone_count)) {
+        fclose(file);
+        return false;
+    }
+    
+    record_file = file;
+    record_last_us = monotonic_us();
+    return true;
+}
+
+void record_event(int type, Window window, int arg) {
+    if (!record_file) {
+        return;
+    }
+    
+    uint64_t now = monotonic_us();
+    uint64_t delta = now - record_last_us;
+    record_last_us = now;
+    
+    RecordEvent event = {
+        .delta_us = delta > UINT32_MAX ? UINT32_MAX : (uint32_t)delta,
+        .type = (uint16_t)type,
+        .arg = arg,
+        .window = window
+    };
+    record_write_event(record_file, &event);
+}
+
+void record_close(void) {
+    if (record_file) {
+        fclose(record_file);
+        record_file = NULL;
+    }
+}
+
+void record_command(int command, long argument, long argument2) {
+    if (!record_file) {
+        return;
+    }
+    
+    uint64_t now = monotonic_us();
+    uint64_t delta = now - record_last_us;
+    record_last_us = now;
+    
+    RecordEvent event = {
+        .delta_us = delta > UINT32_MAX ? UINT32_MAX : (uint32_t)delta,
+        .type = RECORD_COMMAND,
+        .arg = command,
+        .arg2 = (int32_t)argument2,
+        .window = (uint64_t)argument
+    };
+    record_write_event(record_file, &event);
+}
+
+bool record_is_active(void) {
+    return record_file != NULL;
+}
+
+/* Raw trace I/O */
+
+bool record_write_header(FILE *file, LogicalZone *zones, int zone_count) {
+    RecordHeader header = {
+        .magic = RECORD_MAGIC,
+        .version = RECORD_VERSION,
+        .zone_count = (uint16_t)zone_count
+    };
+    if (fwrite(&header, sizeof(header), 1, file) != 1) {
+        return false;
+    }
+    
+    for (int i = 0; i < zone_count; i++) {
+        RecordZone zone = {
+            zones[i].geometry.x, zones[i].geometry.y,
+            zones[i].geometry.width, zones[i].geometry.height,
+            zones[i].monitor_id, zones[i].zone_id
+        };
+        if (fwrite(&zone, sizeof(zone), 1, file) != 1) {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+bool record_write_event(FILE *file, const RecordEvent *event) {
+    return fwrite(event, sizeof(*event), 1, file) == 1;
+}
+
+/* Read the header and zone layout. Returns the zone count, or -1 if the file
+ * is not a trace this build understands. */
+int record_read_header(FILE *file, LogicalZone **zones) {
+    RecordHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        header.magic != RECORD_MAGIC || header.version != RECORD_VERSION ||
+        header.zone_count == 0) {
+        return -1;
+    }
+    
+    *zones = malloc(header.zone_count * sizeof(LogicalZone));
+    assert(*zones != NULL);
+    
+    for (int i = 0; i < header.zone_count; i++) {
+        RecordZone zone;
+        if (fread(&zone, sizeof(zone), 1, file) != 1) {
+            free(*zones);
+            *zones = NULL;
+            return -1;
+        }
+        (*zones)[i] = (LogicalZone){
+            .geometry = {zone.x, zone.y, zone.width, zone.height},
+            .area = {zone.x, zone.y, zone.width, zone.height},
+            .monitor = {zone.x, zone.y, zone.width, zone.height},  /* Never split again in a replay */
+            .monitor_id = zone.monitor_id,
+            .zone_id = zone.zone_id
+        };
+    }
+    
+    return header.zone_count;
+}
+
+bool record_read_event(FILE *file, RecordEvent *event) {
+    return fread(event, sizeof(*event), 1, file) == 1;
+}
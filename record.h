@@ -0,0 +1,62 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "core.h"
+
+/* Compact binary trace of dispatched events and commands
+ *
+ * File layout: RecordHeader, then header.zone_count RecordZone entries
+ * describing the layout swm was running with, then RecordEvent entries
+ * until end of file. All fields are host-endian. */
+
+#define RECORD_MAGIC   0x544d5753  /* "SWMT" */
+#define RECORD_VERSION 1
+
+enum {
+    RECORD_MAP = 1,       /* MapRequest: window */
+    RECORD_UNMAP,         /* UnmapNotify withdrawing a client: window */
+    RECORD_ENTER,         /* EnterNotify that moved focus: window */
+    RECORD_COMMAND,       /* _SWM_COMMAND payload: arg = command, window and arg2 = its arguments */
+    RECORD_ACTIVATE,      /* _NET_ACTIVE_WINDOW message: window */
+    RECORD_CLOSE,         /* _NET_CLOSE_WINDOW message: window */
+    RECORD_DESTROY,       /* DestroyNotify for a managed window: window */
+    RECORD_TYPE_COUNT
+};
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t zone_count;
+} RecordHeader;
+
+typedef struct {
+    int32_t x, y, width, height;
+    int32_t monitor_id, zone_id;
+} RecordZone;
+
+typedef struct {
+    uint32_t delta_us;    /* Time since the previous record, saturating */
+    uint16_t type;        /* RECORD_* */
+    uint16_t reserved;
+    int32_t arg;
+    int32_t arg2;
+    uint64_t window;
+} RecordEvent;
+
+/* Recording from the window manager */
+bool record_open(const char *path, LogicalZone *zones, int zone_count);
+void record_event(int type, Window window, int arg);
+void record_command(int command, long argument, long argument2);
+void record_close(void);
+bool record_is_active(void);
+
+/* Raw trace I/O, shared by the recorder, replayer and generators */
+bool record_write_header(FILE *file, LogicalZone *zones, int zone_count);
+bool record_write_event(FILE *file, const RecordEvent *event);
+int record_read_header(FILE *file, LogicalZone **zones);
+bool record_read_event(FILE *file, RecordEvent *event);
+
+#endif /* RECORD_H */
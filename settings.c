@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <ctype.h>
+#include <errno.h>
+#include "config.h"
+#include "settings.h"
+
+#define MS_TO_TICKS(ms) (((ms) + TIMER_TICK_MS - 1) / TIMER_TICK_MS)
+
+void settings_defaults(Settings *settings) {
+    settings->border_width = BORDER_WIDTH;
+    settings->focus_color = FOCUS_COLOR;
+    settings->unfocus_color = UNFOCUS_COLOR;
+    settings->focus_follows_mouse = FOCUS_FOLLOWS_MOUSE;
+    settings->raise_on_focus = RAISE_ON_FOCUS;
+    settings->focus_dwell_ticks = MS_TO_TICKS(FOCUS_DWELL_MS);
+    settings->kill_timeout_ticks = MS_TO_TICKS(KILL_TIMEOUT_MS);
+    settings->strut_settle_ticks = MS_TO_TICKS(STRUT_SETTLE_MS);
+    settings->layout = (ZoneLayout){
+        ULTRAWIDE_THRESHOLD, ZONE_LEFT_RATIO, ZONE_CENTER_RATIO, ZONE_RIGHT_RATIO
+    };
+}
+
+bool zone_layout_equal(const ZoneLayout *a, const ZoneLayout *b) {
+    return a->ultrawide_threshold == b->ultrawide_threshold &&
+           a->left_ratio == b->left_ratio &&
+           a->center_ratio == b->center_ratio &&
+           a->right_ratio == b->right_ratio;
+}
+
+/* Settings file names, resolved to struct fields by one table lookup per
+ * line while parsing */
+
+enum {
+    SETTING_PIXELS,               /* int */
+    SETTING_COLOR,                /* unsigned long, 0xRRGGBB or #RRGGBB */
+    SETTING_BOOL,                 /* bool, 1/0, yes/no, true/false, on/off */
+    SETTING_TICKS,                /* int, given in milliseconds */
+    SETTING_RATIO                 /* double, share of the monitor width */
+};
+
+typedef struct {
+    const char *name;
+    int kind;
+    size_t offset;
+    long max;                     /* For pixels and milliseconds */
+} SettingField;
+
+static const SettingField setting_fields[] = {
+    {"border_width",        SETTING_PIXELS, offsetof(Settings, border_width),               64},
+    {"focus_color",         SETTING_COLOR,  offsetof(Settings, focus_color),                0},
+    {"unfocus_color",       SETTING_COLOR,  offsetof(Settings, unfocus_color),              0},
+    {"focus_follows_mouse", SETTING_BOOL,   offsetof(Settings, focus_follows_mouse),        0},
+    {"raise_on_focus",      SETTING_BOOL,   offsetof(Settings, raise_on_focus),             0},
+    {"focus_dwell_ms",      SETTING_TICKS,  offsetof(Settings, focus_dwell_ticks),          10000},
+    {"kill_timeout_ms",     SETTING_TICKS,  offsetof(Settings, kill_timeout_ticks),         600000},
+    {"strut_settle_ms",     SETTING_TICKS,  offsetof(Settings, strut_settle_ticks),         10000},
+    {"ultrawide_threshold", SETTING_PIXELS, offsetof(Settings, layout.ultrawide_threshold), 100000},
+    {"zone_left_ratio",     SETTING_RATIO,  offsetof(Settings, layout.left_ratio),          0},
+    {"zone_center_ratio",   SETTING_RATIO,  offsetof(Settings, layout.center_ratio),        0},
+    {"zone_right_ratio",    SETTING_RATIO,  offsetof(Settings, layout.right_ratio),         0},
+};
+
+static char *trim(char *text) {
+    while (isspace((unsigned char)*text)) text++;
+    char *end = text + strlen(text);
+    while (end > text && isspace((unsigned char)end[-1])) end--;
+    *end = '\0';
+    return text;
+}
+
+static bool parse_long(const char *value, int base, long *result) {
+    char *end;
+    errno = 0;
+    *result = strtol(value, &end, base);
+    return errno == 0 && end != value && *end == '\0';
+}
+
+/* Store value into the field; returns an error message, NULL when valid */
+static const char *set_field(Settings *settings, const SettingField *field, const char *value) {
+    void *target = (char *)settings + field->offset;
+    long number;
+
+    switch (field->kind) {
+        case SETTING_PIXELS:
+            if (!parse_long(value, 10, &number) || number < 0 || number > field->max) {
+                return "expected a pixel count";
+            }
+            *(int *)target = (int)number;
+            return NULL;
+        case SETTING_COLOR:
+            if (*value == '#') {
+                value++;
+            } else if (value[0] == '0' && (value[1] == 'x' || value[1] == 'X')) {
+                value += 2;
+            } else {
+                return "expected a color as #RRGGBB or 0xRRGGBB";
+            }
+            if (strlen(value) != 6 || !parse_long(value, 16, &number) || number < 0) {
+                return "expected a color as #RRGGBB or 0xRRGGBB";
+            }
+            *(unsigned long *)target = (unsigned long)number;
+            return NULL;
+        case SETTING_BOOL:
+            if (!strcmp(value, "1") || !strcmp(value, "yes") || !strcmp(value, "true") ||
+                !strcmp(value, "on")) {
+                *(bool *)target = true;
+            } else if (!strcmp(value, "0") || !strcmp(value, "no") || !strcmp(value, "false") ||
+                       !strcmp(value, "off")) {
+                *(bool *)target = false;
+            } else {
+                return "expected 1 or 0";
+            }
+            return NULL;
+        case SETTING_TICKS:
+            if (!parse_long(value, 10, &number) || number < 0 || number > field->max) {
+                return "expected milliseconds";
+            }
+            *(int *)target = (int)MS_TO_TICKS(number);
+            return NULL;
+        case SETTING_RATIO: {
+            char *end;
+            double ratio = strtod(value, &end);
+            if (end == value || *end != '\0' || !(ratio > 0.0 && ratio <= 1.0)) {
+                return "expected a ratio between 0 and 1";
+            }
+            *(double *)target = ratio;
+            return NULL;
+        }
+    }
+    return "unknown setting kind";
+}
+
+bool settings_parse(Settings *settings, const char *text, const char *name, FILE *err) {
+    Settings next = *settings;
+    int line_number = 0;
+
+    while (*text) {
+        line_number++;
+        const char *newline = strchr(text, '\n');
+        size_t length = newline ? (size_t)(newline - text) : strlen(text);
+        char buffer[256];
+        if (length >= sizeof(buffer)) {
+            fprintf(err, "%s:%d: line too long\n", name, line_number);
+            return false;
+        }
+        memcpy(buffer, text, length);
+        buffer[length] = '\0';
+        text += newline ? length + 1 : length;
+
+        char *line = trim(buffer);
+        if (*line == '\0' || *line == '#') continue;
+
+        char *equals = strchr(line, '=');
+        if (!equals) {
+            fprintf(err, "%s:%d: expected name = value\n", name, line_number);
+            return false;
+        }
+        *equals = '\0';
+        char *key = trim(line);
+        char *value = trim(equals + 1);
+
+        const SettingField *field = NULL;
+        for (size_t i = 0; i < sizeof(setting_fields) / sizeof(setting_fields[0]); i++) {
+            if (!strcmp(setting_fields[i].name, key)) {
+                field = &setting_fields[i];
+                break;
+            }
+        }
+        if (!field) {
+            fprintf(err, "%s:%d: unknown setting '%s'\n", name, line_number, key);
+            return false;
+        }
+        const char *error = set_field(&next, field, value);
+        if (error) {
+            fprintf(err, "%s:%d: %s: %s\n", name, line_number, key, error);
+            return false;
+        }
+    }
+
+    /* Rounding aside, the three zones must fit on the monitor */
+    const ZoneLayout *layout = &next.layout;
+    if (layout->left_ratio + layout->center_ratio + layout->right_ratio > 1.0 + 1e-9) {
+        fprintf(err, "%s: zone ratios add up to more than 1\n", name);
+        return false;
+    }
+
+    *settings = next;
+    return true;
+}
+
+bool settings_load(Settings *settings, const char *path, FILE *err) {
+    Settings loaded;
+    settings_defaults(&loaded);
+
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        if (errno == ENOENT) {
+            *settings = loaded;
+            return true;
+        }
+        fprintf(err, "%s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    size_t size = 0;
+    size_t capacity = 4096;
+    char *text = malloc(capacity);
+    while (text) {
+        size += fread(text + size, 1, capacity - size - 1, file);
+        if (size < capacity - 1) break;
+        capacity *= 2;
+        char *grown = realloc(text, capacity);
+        if (!grown) free(text);
+        text = grown;
+    }
+    bool read_error = ferror(file);
+    fclose(file);
+    if (!text || read_error) {
+        fprintf(err, "%s: read failed\n", path);
+        free(text);
+        return false;
+    }
+    text[size] = '\0';
+
+    bool ok = settings_parse(&loaded, text, path, err);
+    free(text);
+    if (ok) {
+        *settings = loaded;
+    }
+    return ok;
+}
@@ -0,0 +1,48 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/* Runtime settings
+ *
+ * config.h gives the defaults. A settings file read at startup and again on
+ * CMD_RELOAD_SETTINGS overrides them: one "name = value" per line, '#'
+ * starts a comment. The file is parsed once into this flat struct, with
+ * times already in timer ticks, so handlers read plain fields and never
+ * parse or look anything up. */
+
+/* How monitors are split into zones */
+typedef struct {
+    int ultrawide_threshold;      /* Wider monitors get three zones */
+    double left_ratio;
+    double center_ratio;
+    double right_ratio;
+} ZoneLayout;
+
+typedef struct {
+    int border_width;
+    unsigned long focus_color;
+    unsigned long unfocus_color;
+    bool focus_follows_mouse;     /* Only when built with FOCUS_FOLLOWS_MOUSE */
+    bool raise_on_focus;
+    int focus_dwell_ticks;
+    int kill_timeout_ticks;
+    int strut_settle_ticks;
+    ZoneLayout layout;
+} Settings;
+
+void settings_defaults(Settings *settings);
+
+/* Apply the lines of text over settings. Nothing is changed unless every
+ * line is valid; otherwise the first error goes to err, prefixed with
+ * name and the line number, and false is returned. */
+bool settings_parse(Settings *settings, const char *text, const char *name, FILE *err);
+
+/* settings_parse() a whole file over the defaults. A missing file is not an
+ * error and leaves the defaults. */
+bool settings_load(Settings *settings, const char *path, FILE *err);
+
+bool zone_layout_equal(const ZoneLayout *a, const ZoneLayout *b);
+
+#endif /* SETTINGS_H */
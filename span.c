@@ -0,0 +1,210 @@
+#define _DEFAULT_SOURCE  /* For clock_gettime and getpid */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include "span.h"
+
+/* Span ring buffer
+ *
+ * Recording a span edge is a clock read and a struct store into memory
+ * allocated up front; formatting only happens when the buffer is dumped. */
+
+typedef struct {
+    uint64_t ns;                  /* Since span_open() */
+    const char *name;
+    unsigned long window;
+    char phase;                   /* 'B' or 'E', as in the Chrome trace format */
+} Span;
+
+static Span *spans = NULL;
+static int span_capacity = 0;
+static int span_head = 0;         /* Where the next span goes */
+static int span_count = 0;
+static uint64_t span_start_ns = 0;
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+bool span_open(int capacity) {
+    if (capacity <= 0) {
+        return false;
+    }
+
+    Span *buffer = malloc(capacity * sizeof(Span));
+    if (!buffer) {
+        return false;
+    }
+
+    free(spans);
+    spans = buffer;
+    span_capacity = capacity;
+    span_head = 0;
+    span_count = 0;
+    span_start_ns = monotonic_ns();
+    return true;
+}
+
+void span_close(void) {
+    free(spans);
+    spans = NULL;
+    span_capacity = 0;
+    span_head = 0;
+    span_count = 0;
+}
+
+bool span_is_active(void) {
+    return spans != NULL;
+}
+
+static void span_push(const char *name, unsigned long window, char phase) {
+    spans[span_head] = (Span){monotonic_ns() - span_start_ns, name, window, phase};
+    span_head = (span_head + 1) % span_capacity;
+    if (span_count < span_capacity) {
+        span_count++;
+    }
+}
+
+void span_begin(const char *name, unsigned long window) {
+    if (!spans) {
+        return;
+    }
+    span_push(name, window, 'B');
+}
+
+void span_end(const char *name) {
+    if (!spans) {
+        return;
+    }
+    span_push(name, 0, 'E');
+}
+
+/* Write the buffer oldest first. Ends whose begin was already overwritten
+ * are left out so the viewer never sees a span close that never opened. */
+bool span_dump(const char *path) {
+    if (!spans) {
+        return false;
+    }
+
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        perror(path);
+        return false;
+    }
+
+    int pid = (int)getpid();
+    int depth = 0;
+    bool first = true;
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    for (int i = 0; i < span_count; i++) {
+        const Span *span = &spans[(span_head - span_count + i + span_capacity) % span_capacity];
+        if (span->phase == 'E') {
+            if (depth == 0) continue;
+            depth--;
+        } else {
+            depth++;
+        }
+
+        fprintf(file, "%s\n{\"name\":\"%s\",\"cat\":\"swm\",\"ph\":\"%c\",\"ts\":%llu.%03u,"
+                "\"pid\":%d,\"tid\":1", first ? "" : ",", span->name, span->phase,
+                (unsigned long long)(span->ns / 1000), (unsigned)(span->ns % 1000), pid);
+        if (span->phase == 'B' && span->window) {
+            fprintf(file, ",\"args\":{\"window\":\"0x%lx\"}", span->window);
+        }
+        fprintf(file, "}");
+        first = false;
+    }
+    fprintf(file, "\n]}\n");
+
+    bool ok = !ferror(file);
+    if (fclose(file) != 0) {
+        ok = false;
+    }
+    return ok;
+}
+
+/* Round trips
+ *
+ * These are where swm waits on the server, so each one gets its own span
+ * under whatever handler made it. */
+
+static const XOps *span_inner = NULL;
+static XOps span_ops;
+
+static bool spanned_window_exists(Display *display, Window window) {
+    span_begin("window_exists", window);
+    bool exists = span_inner->window_exists(display, window);
+    span_end("window_exists");
+    return exists;
+}
+
+static bool spanned_get_size(Display *display, Window window, int *width, int *height) {
+    span_begin("get_size", window);
+    bool ok = span_inner->get_size(display, window, width, height);
+    span_end("get_size");
+    return ok;
+}
+
+static int spanned_get_property32(Display *display, Window window, Atom property, Atom type,
+                                  bool delete, long *items, int max_items) {
+    span_begin("get_property32", window);
+    int count = span_inner->get_property32(display, window, property, type, delete, items, max_items);
+    span_end("get_property32");
+    return count;
+}
+
+static int spanned_take_property32(Display *display, Window window, Atom property, Atom type,
+                                   long **items) {
+    span_begin("take_property32", window);
+    int count = span_inner->take_property32(display, window, property, type, items);
+    span_end("take_property32");
+    return count;
+}
+
+static int spanned_get_text_property(Display *display, Window window, Atom property, Atom type,
+                                     char *buffer, int size) {
+    span_begin("get_text_property", window);
+    int length = span_inner->get_text_property(display, window, property, type, buffer, size);
+    span_end("get_text_property");
+    return length;
+}
+
+static void spanned_get_properties(Display *display, Window window, PropertyRead *reads, int count,
+                                  int *width, int *height) {
+    span_begin("get_properties", window);
+    span_inner->get_properties(display, window, reads, count, width, height);
+    span_end("get_properties");
+}
+
+static Atom spanned_intern_atom(Display *display, const char *name) {
+    span_begin("intern_atom", 0);
+    Atom atom = span_inner->intern_atom(display, name);
+    span_end("intern_atom");
+    return atom;
+}
+
+static unsigned int spanned_numlock_mask(Display *display) {
+    span_begin("numlock_mask", 0);
+    unsigned int mask = span_inner->numlock_mask(display);
+    span_end("numlock_mask");
+    return mask;
+}
+
+const XOps *span_wrap_ops(const XOps *ops) {
+    span_inner = ops;
+    span_ops = *ops;
+    span_ops.window_exists = spanned_window_exists;
+    span_ops.get_size = spanned_get_size;
+    span_ops.get_property32 = spanned_get_property32;
+    span_ops.take_property32 = spanned_take_property32;
+    span_ops.get_text_property = spanned_get_text_property;
+    span_ops.get_properties = spanned_get_properties;
+    span_ops.intern_atom = spanned_intern_atom;
+    span_ops.numlock_mask = spanned_numlock_mask;
+    return &span_ops;
+}
@@ -0,0 +1,26 @@
+#ifndef SPAN_H
+#define SPAN_H
+
+#include <stdbool.h>
+#include "xops.h"
+
+/* Begin/end spans of event handling for trace viewers
+ *
+ * Spans go into a ring buffer allocated once by span_open(); when it is full
+ * the oldest are overwritten, so a long session keeps its most recent
+ * history. span_dump() writes the buffer as Chrome trace JSON, which
+ * chrome://tracing and ui.perfetto.dev load directly. Names must be string
+ * literals or otherwise outlive the buffer. Nothing is recorded unless
+ * SWM_SPANS is set. */
+
+bool span_open(int capacity);
+void span_close(void);
+bool span_is_active(void);
+void span_begin(const char *name, unsigned long window);
+void span_end(const char *name);
+bool span_dump(const char *path);
+
+/* A copy of ops whose round-trip calls are each wrapped in a span */
+const XOps *span_wrap_ops(const XOps *ops);
+
+#endif /* SPAN_H */
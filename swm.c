@@ -1,23 +1,62 @@
+#define _DEFAULT_SOURCE  /* For signalfd, timerfd and clock_gettime */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 #include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
 #include <X11/Xlib.h>
+#include <X11/Xlib-xcb.h>
 #include <X11/Xutil.h>
 #include <X11/Xatom.h>
+#include <X11/Xproto.h>
+#include <X11/keysym.h>
 #include <X11/extensions/Xinerama.h>
 #include "config.h"
 #include "core.h"
-
-/* Global state */
-static WindowManager wm = {0};
-static bool ignore_bad_window = false;
+#include "record.h"
+#include "ipc.h"
+#include "span.h"
+#include "xops.h"
+#include "wm.h"
 
 /* X11 error handler */
+/* Requests swm sends to client windows without checking that they still
+ * exist. A client can destroy its window before they arrive; its
+ * DestroyNotify is already on the way. */
+static bool request_targets_client(unsigned char request_code) {
+    switch (request_code) {
+        case X_ChangeWindowAttributes:
+        case X_GetWindowAttributes:
+        case X_ConfigureWindow:
+        case X_MapWindow:
+        case X_UnmapWindow:
+        case X_GetGeometry:
+        case X_ChangeProperty:
+        case X_DeleteProperty:
+        case X_GetProperty:
+        case X_SendEvent:
+        case X_SetInputFocus:
+            return true;
+        default:
+            return false;
+    }
+}
+
 int x11_error_handler(Display *display, XErrorEvent *error) {
-    /* Ignore BadWindow errors when we're checking if a window exists */
-    if (ignore_bad_window && error->error_code == BadWindow) {
+    /* Focusing a window that just unmapped fails with BadMatch, and a kill
+     * can outlive the window it was meant for */
+    if ((error->error_code == BadWindow && request_targets_client(error->request_code)) ||
+        (error->error_code == BadMatch && error->request_code == X_SetInputFocus) ||
+        (error->error_code == BadValue && error->request_code == X_KillClient)) {
         return 0;
     }
     
@@ -30,508 +69,296 @@ int x11_error_handler(Display *display, XErrorEvent *error) {
     return 0;
 }
 
+/* Xlib backend for the window management logic */
+
 /* Helper function to safely check if a window exists */
-bool window_exists(Display *display, Window window) {
+static bool xlib_window_exists(Display *display, Window window) {
     XWindowAttributes attrs;
-    ignore_bad_window = true;
-    int result = XGetWindowAttributes(display, window, &attrs);
-    ignore_bad_window = false;
-    return result != 0;
+    return XGetWindowAttributes(display, window, &attrs) != 0;
 }
 
-/* X11 helper functions */
+static bool xlib_get_size(Display *display, Window window, int *width, int *height) {
+    Window root;
+    int x, y;
+    unsigned int w, h, border, depth;
+    if (!XGetGeometry(display, window, &root, &x, &y, &w, &h, &border, &depth)) {
+        return false;
+    }
+    *width = (int)w;
+    *height = (int)h;
+    return true;
+}
 
-void set_window_border(Display *display, Window window, unsigned long color) {
-    /* Check if window exists before setting border */
-    if (window_exists(display, window)) {
-        XSetWindowBorder(display, window, color);
-        XSetWindowBorderWidth(display, window, BORDER_WIDTH);
-    }
+static void xlib_move_resize(Display *display, Window window, int x, int y, int width, int height) {
+    XMoveResizeWindow(display, window, x, y, width, height);
 }
 
-void focus_window(Display *display, Window window) {
-    /* Check if window exists before focusing */
-    if (window_exists(display, window)) {
-        XSetInputFocus(display, window, RevertToPointerRoot, CurrentTime);
-        XRaiseWindow(display, window);
-    }
+static void xlib_set_border(Display *display, Window window, unsigned long color, int width) {
+    XSetWindowBorder(display, window, color);
+    XSetWindowBorderWidth(display, window, width);
 }
 
-void resize_window_to_zone(Display *display, Window window, LogicalZone *zone) {
-    /* Check if window exists before resizing */
-    if (window_exists(display, window)) {
-        XMoveResizeWindow(display, window, 
-                          zone->geometry.x, zone->geometry.y,
-                          zone->geometry.width - 2 * BORDER_WIDTH,
-                          zone->geometry.height - 2 * BORDER_WIDTH);
-    }
+static void xlib_set_focus(Display *display, Window window) {
+    XSetInputFocus(display, window, RevertToPointerRoot, CurrentTime);
 }
 
-/* Client management using new simplified approach */
+static void xlib_restack(Display *display, Window *windows, int count) {
+    XRestackWindows(display, windows, count);
+}
 
-Client *create_client(Window window, int zone_index) {
-    Client *client = malloc(sizeof(Client));
-    assert(client != NULL);
-    
-    client->window = window;
-    client->zone_index = zone_index;
-    client->next = NULL;
-    
-    return client;
+static void xlib_map(Display *display, Window window) {
+    XMapWindow(display, window);
 }
 
-Client *find_client_by_window(DisplayManager *display, Window window) {
-    for (int zone = 0; zone < display->zone_count; zone++) {
-        Client *current = display->zone_clients[zone];
-        while (current) {
-            if (current->window == window) {
-                return current;
-            }
-            current = current->next;
-        }
-    }
-    return NULL;
+static void xlib_unmap(Display *display, Window window) {
+    XUnmapWindow(display, window);
 }
 
-/* Window manager operations using new approach */
+static void xlib_select_input(Display *display, Window window, long mask) {
+    XSelectInput(display, window, mask);
+}
 
-void cycle_window_focus(void) {
-    DisplayManager *display = wm.active_display;
-    if (!display || display->zone_count == 0) return;
-    
-    int zone = display->active_zone;
-    int count = count_clients_in_zone(display, zone);
-    if (count <= 1) return;
-    
-    /* Unfocus current window */
-    Client *current = get_current_client_in_zone(display, zone);
-    if (current) {
-        set_window_border(display->x_display, current->window, UNFOCUS_COLOR);
-    }
-    
-    /* Move to next client */
-    display->zone_current_index[zone] = (display->zone_current_index[zone] + 1) % count;
-    
-    /* Focus new current window */
-    Client *next = get_current_client_in_zone(display, zone);
-    if (next) {
-        set_window_border(display->x_display, next->window, FOCUS_COLOR);
-        focus_window(display->x_display, next->window);
-    }
+static void xlib_kill_client(Display *display, Window window) {
+    XKillClient(display, window);
 }
 
-void cycle_window_focus_direction(int direction) {
-    DisplayManager *display = wm.active_display;
-    if (!display || display->zone_count == 0) return;
-    
-    int zone = display->active_zone;
-    int count = count_clients_in_zone(display, zone);
-    if (count <= 1) return;
-    
-    /* Unfocus current window */
-    Client *current = get_current_client_in_zone(display, zone);
-    if (current) {
-        set_window_border(display->x_display, current->window, UNFOCUS_COLOR);
-    }
-    
-    /* Move in specified direction */
-    int current_index = display->zone_current_index[zone];
-    if (direction > 0) {
-        display->zone_current_index[zone] = (current_index + 1) % count;
-    } else {
-        display->zone_current_index[zone] = (current_index - 1 + count) % count;
-    }
-    
-    /* Focus new current window */
-    Client *next = get_current_client_in_zone(display, zone);
-    if (next) {
-        set_window_border(display->x_display, next->window, FOCUS_COLOR);
-        focus_window(display->x_display, next->window);
-    }
+static void xlib_no_operation(Display *display) {
+    XNoOp(display);
 }
 
-void cycle_monitor_focus(void) {
-    DisplayManager *display = wm.active_display;
-    if (!display || display->zone_count <= 1) return;
-    
-    /* Unfocus current window */
-    Client *current = get_current_client_in_zone(display, display->active_zone);
-    if (current) {
-        set_window_border(display->x_display, current->window, UNFOCUS_COLOR);
-    }
-    
-    /* Move to next zone */
-    display->active_zone = (display->active_zone + 1) % display->zone_count;
-    
-    /* Focus window in new zone */
-    Client *next = get_current_client_in_zone(display, display->active_zone);
-    if (next) {
-        set_window_border(display->x_display, next->window, FOCUS_COLOR);
-        focus_window(display->x_display, next->window);
-    }
+static void xlib_send_message(Display *display, Window window, Atom type, long data0, long data1) {
+    XEvent event = {0};
+    event.type = ClientMessage;
+    event.xclient.window = window;
+    event.xclient.message_type = type;
+    event.xclient.format = 32;
+    event.xclient.data.l[0] = data0;
+    event.xclient.data.l[1] = data1;
+    XSendEvent(display, window, False, NoEventMask, &event);
 }
 
-void cycle_monitor_focus_direction(int direction) {
-    DisplayManager *display = wm.active_display;
-    if (!display || display->zone_count <= 1) return;
-    
-    /* Unfocus current window */
-    Client *current = get_current_client_in_zone(display, display->active_zone);
-    if (current) {
-        set_window_border(display->x_display, current->window, UNFOCUS_COLOR);
-    }
+static void xlib_change_property(Display *display, Window window, Atom property, Atom type,
+                                 int format, const void *data, int count) {
+    XChangeProperty(display, window, property, type, format, PropModeReplace,
+                    (const unsigned char *)data, count);
+}
+
+/* Passive grab on the root; KeyPress events then arrive for that key alone */
+static void xlib_grab_key(Display *display, Window window, int keycode, unsigned int modifiers) {
+    XGrabKey(display, keycode, modifiers, window, True, GrabModeAsync, GrabModeAsync);
+}
+
+static void xlib_ungrab_keys(Display *display, Window window) {
+    XUngrabKey(display, AnyKey, AnyModifier, window);
+}
+
+/* Read up to max_items 32-bit items. Returns the count read, or -1 on failure. */
+static int xlib_get_property32(Display *display, Window window, Atom property, Atom type,
+                               bool delete, long *items, int max_items) {
+    Atom actual_type;
+    int actual_format;
+    unsigned long nitems, bytes_after;
+    unsigned char *data = NULL;
     
-    /* Move to zone in specified direction */
-    int zone_count = display->zone_count;
-    if (direction > 0) {
-        display->active_zone = (display->active_zone + 1) % zone_count;
-    } else {
-        display->active_zone = (display->active_zone - 1 + zone_count) % zone_count;
+    int status = XGetWindowProperty(display, window, property, 0, max_items, delete, type,
+                                    &actual_type, &actual_format, &nitems, &bytes_after, &data);
+    if (status != Success) {
+        return -1;
     }
     
-    /* Focus window in new zone */
-    Client *next = get_current_client_in_zone(display, display->active_zone);
-    if (next) {
-        set_window_border(display->x_display, next->window, FOCUS_COLOR);
-        focus_window(display->x_display, next->window);
+    int count = 0;
+    if (data && actual_format == 32) {
+        for (unsigned long i = 0; i < nitems && count < max_items; i++) {
+            items[count++] = ((long *)data)[i];
+        }
     }
+    if (data) XFree(data);
+    return count;
 }
 
-void kill_focused_window(void) {
-    printf("[DEBUG] kill_focused_window() called\n");
-    fflush(stdout);
+static int xlib_take_property32(Display *display, Window window, Atom property, Atom type,
+                                long **items) {
+    Atom actual_type;
+    int actual_format;
+    unsigned long nitems, bytes_after;
+    unsigned char *data = NULL;
     
-    DisplayManager *display = wm.active_display;
-    if (!display) {
-        printf("[DEBUG] kill_focused_window: No active display, returning early\n");
-        fflush(stdout);
-        return;
-    }
-    printf("[DEBUG] kill_focused_window: Active display found\n");
-    fflush(stdout);
-    
-    printf("[DEBUG] kill_focused_window: Active zone = %d, Zone count = %d\n", 
-           display->active_zone, display->zone_count);
-    fflush(stdout);
-    
-    Client *current = get_current_client_in_zone(display, display->active_zone);
-    if (!current) {
-        printf("[DEBUG] kill_focused_window: No current client in zone %d, returning early\n", 
-               display->active_zone);
-        fflush(stdout);
-        
-        /* Debug: Check if there are any clients in this zone */
-        int client_count = count_clients_in_zone(display, display->active_zone);
-        printf("[DEBUG] kill_focused_window: Client count in zone %d = %d\n", 
-               display->active_zone, client_count);
-        fflush(stdout);
-        
-        /* Debug: Check current index */
-        printf("[DEBUG] kill_focused_window: Current index in zone %d = %d\n", 
-               display->active_zone, display->zone_current_index[display->active_zone]);
-        fflush(stdout);
-        
-        return;
-    }
-    
-    Window window = current->window;
-    printf("[DEBUG] kill_focused_window: Found current client with window 0x%lx in zone %d\n", 
-           window, display->active_zone);
-    fflush(stdout);
-    
-    /* Check if window still exists */
-    if (!window_exists(display->x_display, window)) {
-        printf("[DEBUG] kill_focused_window: Window 0x%lx no longer exists, cleaning up\n", window);
-        fflush(stdout);
-        remove_client_from_zone(display, display->active_zone, current);
-        free(current);
-        return;
-    }
-    printf("[DEBUG] kill_focused_window: Window 0x%lx exists, proceeding with kill\n", window);
-    fflush(stdout);
-    
-    /* Try to close window gracefully first (WM_DELETE_WINDOW) */
-    Atom wm_delete_window = XInternAtom(display->x_display, "WM_DELETE_WINDOW", False);
-    Atom wm_protocols = XInternAtom(display->x_display, "WM_PROTOCOLS", False);
-    printf("[DEBUG] kill_focused_window: Got atoms - WM_DELETE_WINDOW=%ld, WM_PROTOCOLS=%ld\n", 
-           wm_delete_window, wm_protocols);
-    fflush(stdout);
-    
-    Atom *protocols;
-    int n_protocols;
-    bool supports_delete = false;
-    
-    if (XGetWMProtocols(display->x_display, window, &protocols, &n_protocols)) {
-        printf("[DEBUG] kill_focused_window: Window supports %d protocols\n", n_protocols);
-        fflush(stdout);
-        for (int i = 0; i < n_protocols; i++) {
-            printf("[DEBUG] kill_focused_window: Protocol %d: %ld\n", i, protocols[i]);
-            fflush(stdout);
-            if (protocols[i] == wm_delete_window) {
-                supports_delete = true;
-                printf("[DEBUG] kill_focused_window: Window supports WM_DELETE_WINDOW\n");
-                fflush(stdout);
-                break;
+    /* A length no property reaches: the reply holds all of it, so the
+     * server always deletes it */
+    *items = NULL;
+    int status = XGetWindowProperty(display, window, property, 0, 0x7fffffffL, True, type,
+                                    &actual_type, &actual_format, &nitems, &bytes_after, &data);
+    if (status != Success) {
+        return -1;
+    }
+    
+    int count = 0;
+    if (data && actual_format == 32 && nitems > 0) {
+        *items = malloc(nitems * sizeof(long));
+        if (*items) {
+            for (unsigned long i = 0; i < nitems; i++) {
+                (*items)[count++] = ((long *)data)[i];
             }
         }
-        XFree(protocols);
-    } else {
-        printf("[DEBUG] kill_focused_window: XGetWMProtocols failed for window 0x%lx\n", window);
-        fflush(stdout);
-    }
-    
-    if (supports_delete) {
-        printf("[DEBUG] kill_focused_window: Sending WM_DELETE_WINDOW message to window 0x%lx\n", window);
-        fflush(stdout);
-        /* Send WM_DELETE_WINDOW message */
-        XEvent event;
-        event.type = ClientMessage;
-        event.xclient.window = window;
-        event.xclient.message_type = wm_protocols;
-        event.xclient.format = 32;
-        event.xclient.data.l[0] = wm_delete_window;
-        event.xclient.data.l[1] = CurrentTime;
-        
-        int result = XSendEvent(display->x_display, window, False, NoEventMask, &event);
-        printf("[DEBUG] kill_focused_window: XSendEvent result = %d\n", result);
-        fflush(stdout);
-    } else {
-        printf("[DEBUG] kill_focused_window: Force killing window 0x%lx with XKillClient\n", window);
-        fflush(stdout);
-        /* Force kill the window */
-        XKillClient(display->x_display, window);
     }
-    
-    XFlush(display->x_display);
-    printf("[DEBUG] kill_focused_window: XFlush completed, kill command sent\n");
-    fflush(stdout);
+    if (data) XFree(data);
+    return count;
 }
 
-void move_focused_window_to_zone_direction(int direction) {
-    DisplayManager *display = wm.active_display;
-    if (!display || display->zone_count <= 1) return;
-    
-    Client *current = get_current_client_in_zone(display, display->active_zone);
-    if (!current) return;
+/* Read a text property (format 8) into buffer, always NUL terminated.
+ * Returns the number of bytes read, or -1 on failure. */
+static int xlib_get_text_property(Display *display, Window window, Atom property, Atom type,
+                                  char *buffer, int size) {
+    Atom actual_type;
+    int actual_format;
+    unsigned long nitems, bytes_after;
+    unsigned char *data = NULL;
     
-    /* Calculate target zone */
-    int zone_count = display->zone_count;
-    int target_zone;
-    if (direction > 0) {
-        target_zone = (display->active_zone + 1) % zone_count;
-    } else {
-        target_zone = (display->active_zone - 1 + zone_count) % zone_count;
+    int status = XGetWindowProperty(display, window, property, 0, (size + 3) / 4, False, type,
+                                    &actual_type, &actual_format, &nitems, &bytes_after, &data);
+    if (status != Success) {
+        return -1;
     }
     
-    /* Remove from current zone */
-    remove_client_from_zone(display, display->active_zone, current);
-    
-    /* Add to target zone */
-    add_client_to_zone(display, target_zone, current);
-    
-    /* Resize and move window to new zone */
-    resize_window_to_zone(display->x_display, current->window, &display->zones[target_zone]);
-    
-    /* Update active zone to follow the window */
-    display->active_zone = target_zone;
-    
-    XFlush(display->x_display);
+    int length = 0;
+    if (data && actual_format == 8) {
+        length = nitems < (unsigned long)size ? (int)nitems : size - 1;
+        memcpy(buffer, data, length);
+    }
+    buffer[length] = '\0';
+    if (data) XFree(data);
+    return length;
 }
 
-/* Event handlers */
+/* Requests sent through XCB behind Xlib's back. Xlib only catches up on
+ * the sequence number the next time it sends a request itself. */
+static unsigned long xcb_next_request = 0;
 
-void handle_map_request(XMapRequestEvent *event) {
-    DisplayManager *display = wm.active_display;
-    if (!display) return;
-    
-    Window window = event->window;
-    
-    /* Create and add client to active zone */
-    Client *client = create_client(window, display->active_zone);
-    add_client_to_zone(display, display->active_zone, client);
-    
-    /* Resize window to fit zone */
-    if (display->active_zone < display->zone_count) {
-        resize_window_to_zone(display->x_display, window, &display->zones[display->active_zone]);
-    }
-    
-    /* Set border and map window */
-    set_window_border(display->x_display, window, UNFOCUS_COLOR);
-#if FOCUS_FOLLOWS_MOUSE
-    XSelectInput(display->x_display, window, EnterWindowMask);
-#endif
-    XMapWindow(display->x_display, window);
-    
-    /* Unfocus previous window and focus the new one */
-    Client *previous = get_current_client_in_zone(display, display->active_zone);
-    if (previous && previous != client) {
-        set_window_border(display->x_display, previous->window, UNFOCUS_COLOR);
-    }
-    
-    /* Make the new client current (it's already at index 0 since we add to front) */
-    display->zone_current_index[display->active_zone] = 0;
-    set_window_border(display->x_display, window, FOCUS_COLOR);
-    focus_window(display->x_display, window);
+static unsigned long xlib_next_request(Display *display) {
+    unsigned long next = NextRequest(display);
+    return next > xcb_next_request ? next : xcb_next_request;
 }
 
-void handle_unmap_notify(XUnmapEvent *event) {
-    DisplayManager *display = wm.active_display;
-    if (!display) return;
-    
-    Client *client = find_client_by_window(display, event->window);
-    if (!client) return;
-    
-    int zone = client->zone_index;
-    
-    /* Remove client from zone */
-    remove_client_from_zone(display, zone, client);
-    free(client);
-    
-    /* Focus the new current window in the zone if any */
-    Client *next = get_current_client_in_zone(display, zone);
-    if (next) {
-        /* Check if the window still exists before trying to manipulate it */
-        if (!window_exists(display->x_display, next->window)) {
-            /* Window doesn't exist anymore, remove this client too */
-            remove_client_from_zone(display, zone, next);
-            free(next);
-            /* Try to find another window to focus */
-            next = get_current_client_in_zone(display, zone);
-        }
-        
-        if (next) {
-            /* Verify window still exists before setting border and focus */
-            if (window_exists(display->x_display, next->window)) {
-                set_window_border(display->x_display, next->window, FOCUS_COLOR);
-                focus_window(display->x_display, next->window);
+static void copy_property_value(PropertyRead *read, xcb_get_property_reply_t *reply) {
+    int length = xcb_get_property_value_length(reply);
+    const void *value = xcb_get_property_value(reply);
+    read->count = 0;
+    
+    if (read->format == 32) {
+        if (reply->format == 32) {
+            const uint32_t *items = value;
+            for (int i = 0; i < length / 4 && i < read->size; i++) {
+                ((long *)read->data)[read->count++] = (long)items[i];
             }
         }
+    } else {
+        char *text = read->data;
+        if (reply->format == 8) {
+            read->count = length < read->size ? length : read->size - 1;
+            memcpy(text, value, read->count);
+        }
+        text[read->count] = '\0';
     }
 }
 
-void handle_property_notify(XPropertyEvent *event) {
-    DisplayManager *display = wm.active_display;
-    if (!display || event->atom != display->command_atom || event->window != display->root) {
-        return;
-    }
-    
-    printf("[DEBUG] handle_property_notify: Command property changed\n");
-    fflush(stdout);
-    
-    Atom actual_type;
-    int actual_format;
-    unsigned long nitems, bytes_after;
-    unsigned char *data = NULL;
-    
-    if (XGetWindowProperty(display->x_display, display->root, display->command_atom,
-                          0, 1, True, XA_INTEGER,
-                          &actual_type, &actual_format,
-                          &nitems, &bytes_after, &data) == Success) {
-        
-        if (data != NULL && nitems > 0) {
-            int command = *(int*)data;
-            printf("[DEBUG] handle_property_notify: Received command %d\n", command);
-            fflush(stdout);
-            
-            switch (command) {
-                case CMD_CYCLE_WINDOW:
-                    printf("[DEBUG] handle_property_notify: Executing CMD_CYCLE_WINDOW\n");
-                    fflush(stdout);
-                    cycle_window_focus();
-                    break;
-                case CMD_CYCLE_WINDOW_NEXT:
-                    printf("[DEBUG] handle_property_notify: Executing CMD_CYCLE_WINDOW_NEXT\n");
-                    fflush(stdout);
-                    cycle_window_focus_direction(1);
-                    break;
-                case CMD_CYCLE_WINDOW_PREV:
-                    printf("[DEBUG] handle_property_notify: Executing CMD_CYCLE_WINDOW_PREV\n");
-                    fflush(stdout);
-                    cycle_window_focus_direction(-1);
-                    break;
-                case CMD_CYCLE_MONITOR:
-                    printf("[DEBUG] handle_property_notify: Executing CMD_CYCLE_MONITOR\n");
-                    fflush(stdout);
-                    cycle_monitor_focus();
-                    break;
-                case CMD_CYCLE_MONITOR_LEFT:
-                    printf("[DEBUG] handle_property_notify: Executing CMD_CYCLE_MONITOR_LEFT\n");
-                    fflush(stdout);
-                    cycle_monitor_focus_direction(-1);
-                    break;
-                case CMD_CYCLE_MONITOR_RIGHT:
-                    printf("[DEBUG] handle_property_notify: Executing CMD_CYCLE_MONITOR_RIGHT\n");
-                    fflush(stdout);
-                    cycle_monitor_focus_direction(1);
-                    break;
-                case CMD_KILL_WINDOW:
-                    printf("[DEBUG] handle_property_notify: Executing CMD_KILL_WINDOW\n");
-                    fflush(stdout);
-                    kill_focused_window();
-                    break;
-                case CMD_MOVE_WINDOW_LEFT:
-                    printf("[DEBUG] handle_property_notify: Executing CMD_MOVE_WINDOW_LEFT\n");
-                    fflush(stdout);
-                    move_focused_window_to_zone_direction(-1);
-                    break;
-                case CMD_MOVE_WINDOW_RIGHT:
-                    printf("[DEBUG] handle_property_notify: Executing CMD_MOVE_WINDOW_RIGHT\n");
-                    fflush(stdout);
-                    move_focused_window_to_zone_direction(1);
-                    break;
-                case CMD_QUIT:
-                    printf("[DEBUG] handle_property_notify: Executing CMD_QUIT\n");
-                    fflush(stdout);
-                    exit(0);
-                    break;
-                default:
-                    printf("[DEBUG] handle_property_notify: Unknown command %d\n", command);
-                    fflush(stdout);
-                    break;
-            }
-            
-            XFree(data);
-        } else {
-            printf("[DEBUG] handle_property_notify: No data or empty data received\n");
-            fflush(stdout);
+/* Xlib has no way to send a GetProperty without waiting for its reply, so
+ * the batch goes through the XCB connection underneath it */
+static void xlib_get_properties(Display *display, Window window, PropertyRead *reads, int count,
+                                int *width, int *height) {
+    xcb_connection_t *connection = XGetXCBConnection(display);
+    xcb_get_property_cookie_t cookies[PROPERTY_READS_MAX];
+    xcb_get_geometry_cookie_t geometry;
+    assert(count <= PROPERTY_READS_MAX);
+    
+    /* XCB flushes Xlib's buffer before its first request, so the batch
+     * takes the serials right after Xlib's */
+    unsigned long next = xlib_next_request(display);
+    for (int i = 0; i < count; i++) {
+        uint32_t length = reads[i].format == 32 ? reads[i].size : (reads[i].size + 3) / 4;
+        cookies[i] = xcb_get_property(connection, 0, window, reads[i].property, reads[i].type,
+                                      0, length);
+    }
+    if (width) {
+        geometry = xcb_get_geometry(connection, window);
+    }
+    xcb_next_request = next + count + (width ? 1 : 0);
+    
+    for (int i = 0; i < count; i++) {
+        xcb_generic_error_t *error = NULL;
+        xcb_get_property_reply_t *reply = xcb_get_property_reply(connection, cookies[i], &error);
+        free(error);
+        reads[i].count = -1;
+        if (reply) {
+            copy_property_value(&reads[i], reply);
+            free(reply);
         }
-    } else {
-        printf("[DEBUG] handle_property_notify: XGetWindowProperty failed\n");
-        fflush(stdout);
+    }
+    if (width) {
+        xcb_generic_error_t *error = NULL;
+        xcb_get_geometry_reply_t *reply = xcb_get_geometry_reply(connection, geometry, &error);
+        free(error);
+        *width = reply ? reply->width : 0;
+        *height = reply ? reply->height : 0;
+        free(reply);
     }
 }
 
-#if FOCUS_FOLLOWS_MOUSE
-void handle_enter_notify(XEnterWindowEvent *event) {
-    DisplayManager *display = wm.active_display;
-    if (!display) return;
-    
-    Client *client = find_client_by_window(display, event->window);
-    if (!client) return;
-    
-    /* If it's already the focused window, do nothing */
-    Client *current = get_current_client_in_zone(display, display->active_zone);
-    if (current && current->window == event->window) return;
-    
-    /* Update active zone */
-    display->active_zone = client->zone_index;
-    
-    /* Use existing focus logic - just focus the window directly */
-    set_window_border(display->x_display, event->window, FOCUS_COLOR);
-    focus_window(display->x_display, event->window);
-    
-    /* Unfocus all other windows in all zones */
-    for (int zone = 0; zone < display->zone_count; zone++) {
-        Client *zone_client = display->zone_clients[zone];
-        while (zone_client) {
-            if (zone_client->window != event->window) {
-                set_window_border(display->x_display, zone_client->window, UNFOCUS_COLOR);
+static Atom xlib_intern_atom(Display *display, const char *name) {
+    return XInternAtom(display, name, False);
+}
+
+/* The modifier bit NumLock is mapped to, 0 if none */
+static unsigned int xlib_numlock_mask(Display *display) {
+    KeyCode numlock = XKeysymToKeycode(display, XK_Num_Lock);
+    unsigned int mask = 0;
+    
+    XModifierKeymap *modmap = XGetModifierMapping(display);
+    for (int modifier = 0; modifier < 8 && numlock; modifier++) {
+        for (int key = 0; key < modmap->max_keypermod; key++) {
+            if (modmap->modifiermap[modifier * modmap->max_keypermod + key] == numlock) {
+                mask = 1u << modifier;
             }
-            zone_client = zone_client->next;
         }
     }
+    XFreeModifiermap(modmap);
+    return mask;
+}
+
+/* Xlib fetches the keyboard mapping on first use and caches it */
+static KeyCode xlib_keysym_to_keycode(Display *display, KeySym keysym) {
+    return XKeysymToKeycode(display, keysym);
+}
+
+static void xlib_refresh_keyboard(XMappingEvent *event) {
+    XRefreshKeyboardMapping(event);
 }
-#endif
+
+static const XOps xlib_ops = {
+    .move_resize       = xlib_move_resize,
+    .set_border        = xlib_set_border,
+    .set_focus         = xlib_set_focus,
+    .restack           = xlib_restack,
+    .map               = xlib_map,
+    .unmap             = xlib_unmap,
+    .select_input      = xlib_select_input,
+    .kill_client       = xlib_kill_client,
+    .no_operation      = xlib_no_operation,
+    .send_message      = xlib_send_message,
+    .change_property   = xlib_change_property,
+    .grab_key          = xlib_grab_key,
+    .ungrab_keys       = xlib_ungrab_keys,
+    .window_exists     = xlib_window_exists,
+    .get_size          = xlib_get_size,
+    .get_property32    = xlib_get_property32,
+    .take_property32   = xlib_take_property32,
+    .get_text_property = xlib_get_text_property,
+    .get_properties    = xlib_get_properties,
+    .intern_atom       = xlib_intern_atom,
+    .numlock_mask      = xlib_numlock_mask,
+    .keysym_to_keycode = xlib_keysym_to_keycode,
+    .refresh_keyboard  = xlib_refresh_keyboard,
+    .next_request      = xlib_next_request,
+};
 
 /* Initialization */
 
@@ -547,7 +374,22 @@ DisplayManager *create_display_manager(Display *x_display, int screen, Window ro
     display->active_zone = 0;
     display->zone_clients = NULL;
     display->zone_current_index = NULL;
+    display->zone_stack = NULL;
+    display->zone_stack_dirty = NULL;
+    display->zone_monocle = NULL;
+    display->docks = NULL;
+    display->struts_dirty = false;
     display->command_atom = XInternAtom(x_display, COMMAND_PROPERTY, False);
+    
+    static char *wm_atom_names[WM_ATOM_COUNT] = {
+        [WM_PROTOCOLS]     = "WM_PROTOCOLS",
+        [WM_DELETE_WINDOW] = "WM_DELETE_WINDOW",
+        [WM_STATE]         = "WM_STATE",
+    };
+    XInternAtoms(x_display, wm_atom_names, WM_ATOM_COUNT, False, display->wm_atoms);
+
+    display->wm_check_window = None;
+    display->ewmh_dirty = 0;
     display->next = NULL;
     
     return display;
@@ -555,27 +397,50 @@ DisplayManager *create_display_manager(Display *x_display, int screen, Window ro
 
 int setup_display_zones(DisplayManager *display) {
     int monitor_count;
-    XineramaScreenInfo *monitors = XineramaQueryScreens(display->x_display, &monitor_count);
+    XineramaScreenInfo *monitors;
+    XineramaScreenInfo whole_screen;
+    
+    /* Separate X screens (Zaphod mode) run without Xinerama: each screen is
+     * then a single monitor */
+    if (XineramaIsActive(display->x_display)) {
+        monitors = XineramaQueryScreens(display->x_display, &monitor_count);
+    } else {
+        whole_screen.screen_number = display->screen;
+        whole_screen.x_org = 0;
+        whole_screen.y_org = 0;
+        whole_screen.width = DisplayWidth(display->x_display, display->screen);
+        whole_screen.height = DisplayHeight(display->x_display, display->screen);
+        monitors = &whole_screen;
+        monitor_count = 1;
+    }
     
     if (monitors == NULL || monitor_count == 0) {
         fprintf(stderr, "No monitors detected\n");
         return 0;
     }
     
-    display->zone_count = calculate_zones(monitors, monitor_count, &display->zones);
+    display->zone_count = calculate_layout_zones(monitors, monitor_count, &wm.settings.layout,
+                                                 &display->zones);
     
     /* Allocate zone-based client management arrays */
     display->zone_clients = calloc(display->zone_count, sizeof(Client*));
     display->zone_current_index = malloc(display->zone_count * sizeof(int));
+    display->zone_stack = calloc(display->zone_count, sizeof(Client*));
+    display->zone_stack_dirty = calloc(display->zone_count, sizeof(bool));
+    display->zone_monocle = calloc(display->zone_count, sizeof(bool));
     assert(display->zone_clients != NULL && display->zone_current_index != NULL);
+    assert(display->zone_stack != NULL && display->zone_stack_dirty != NULL);
+    assert(display->zone_monocle != NULL);
     
     /* Initialize all zones to have no clients */
     for (int i = 0; i < display->zone_count; i++) {
+        display->zone_monocle[i] = MONOCLE_DEFAULT;
         display->zone_clients[i] = NULL;
         display->zone_current_index[i] = -1;
     }
     
-    printf("Detected %d monitors, created %d logical zones:\n", monitor_count, display->zone_count);
+    printf("Screen %d: detected %d monitors, created %d logical zones:\n",
+           display->screen, monitor_count, display->zone_count);
     for (int i = 0; i < display->zone_count; i++) {
         printf("Zone %d: %dx%d+%d+%d (monitor %d, zone %d)\n", i,
                display->zones[i].geometry.width, display->zones[i].geometry.height,
@@ -583,10 +448,193 @@ int setup_display_zones(DisplayManager *display) {
                display->zones[i].monitor_id, display->zones[i].zone_id);
     }
     
-    XFree(monitors);
+    if (monitors != &whole_screen) {
+        XFree(monitors);
+    }
     return 1;
 }
 
+/* EWMH */
+
+void setup_ewmh(DisplayManager *display) {
+    static char *names[NET_ATOM_COUNT] = {
+        [NET_SUPPORTED]           = "_NET_SUPPORTED",
+        [NET_SUPPORTING_WM_CHECK] = "_NET_SUPPORTING_WM_CHECK",
+        [NET_WM_NAME]             = "_NET_WM_NAME",
+        [NET_CLIENT_LIST]         = "_NET_CLIENT_LIST",
+        [NET_ACTIVE_WINDOW]       = "_NET_ACTIVE_WINDOW",
+        [NET_CLOSE_WINDOW]        = "_NET_CLOSE_WINDOW",
+        [NET_WM_WINDOW_TYPE]      = "_NET_WM_WINDOW_TYPE",
+        [NET_WM_WINDOW_TYPE_DIALOG]  = "_NET_WM_WINDOW_TYPE_DIALOG",
+        [NET_WM_WINDOW_TYPE_UTILITY] = "_NET_WM_WINDOW_TYPE_UTILITY",
+        [NET_WM_WINDOW_TYPE_SPLASH]  = "_NET_WM_WINDOW_TYPE_SPLASH",
+        [NET_WM_WINDOW_TYPE_TOOLBAR] = "_NET_WM_WINDOW_TYPE_TOOLBAR",
+        [NET_WM_WINDOW_TYPE_DOCK]    = "_NET_WM_WINDOW_TYPE_DOCK",
+        [NET_WM_STRUT]            = "_NET_WM_STRUT",
+        [NET_WM_STRUT_PARTIAL]    = "_NET_WM_STRUT_PARTIAL",
+        [NET_WM_STATE]            = "_NET_WM_STATE",
+        [NET_WM_STATE_HIDDEN]     = "_NET_WM_STATE_HIDDEN",
+    };
+    Display *x_display = display->x_display;
+    
+    /* One round trip for the whole atom table */
+    XInternAtoms(x_display, names, NET_ATOM_COUNT, False, display->net_atoms);
+    display->utf8_string_atom = XInternAtom(x_display, "UTF8_STRING", False);
+    
+    /* Child window proving a compliant WM is running */
+    display->wm_check_window = XCreateSimpleWindow(x_display, display->root, 0, 0, 1, 1, 0, 0, 0);
+    XChangeProperty(x_display, display->wm_check_window, display->net_atoms[NET_SUPPORTING_WM_CHECK],
+                    XA_WINDOW, 32, PropModeReplace, (unsigned char *)&display->wm_check_window, 1);
+    XChangeProperty(x_display, display->wm_check_window, display->net_atoms[NET_WM_NAME],
+                    display->utf8_string_atom, 8, PropModeReplace, (unsigned char *)"swm", 3);
+    XChangeProperty(x_display, display->root, display->net_atoms[NET_SUPPORTING_WM_CHECK],
+                    XA_WINDOW, 32, PropModeReplace, (unsigned char *)&display->wm_check_window, 1);
+    XChangeProperty(x_display, display->root, display->net_atoms[NET_SUPPORTED],
+                    XA_ATOM, 32, PropModeReplace, (unsigned char *)display->net_atoms, NET_ATOM_COUNT);
+    
+    mark_ewmh_dirty(display, EWMH_DIRTY_CLIENT_LIST | EWMH_DIRTY_ACTIVE_WINDOW);
+}
+
+/* Event loop */
+
+void handle_signals(int signal_fd) {
+    struct signalfd_siginfo info;
+    
+    while (read(signal_fd, &info, sizeof(info)) == sizeof(info)) {
+        switch (info.ssi_signo) {
+            case SIGCHLD:
+                /* Reap every exited child, not just the one that signalled */
+                while (waitpid(-1, NULL, WNOHANG) > 0);
+                break;
+            case SIGINT:
+            case SIGTERM:
+                printf("Received signal %u, shutting down\n", info.ssi_signo);
+                wm.running = false;
+                break;
+            case SIGUSR1:
+                print_handler_stats(stdout);
+                break;
+            case SIGUSR2:
+                if (span_is_active() && span_dump(getenv(SPAN_FILE_ENV))) {
+                    printf("Wrote event spans to %s\n", getenv(SPAN_FILE_ENV));
+                }
+                break;
+        }
+    }
+}
+
+/* Tick the timerfd only while timers are pending so an idle WM stays asleep */
+void update_timer_fd(int timer_fd, bool *armed) {
+    bool want = wm.timers.active_count > 0;
+    if (want == *armed) return;
+    
+    struct itimerspec spec = {0};
+    if (want) {
+        spec.it_interval.tv_nsec = TIMER_TICK_MS * 1000000L;
+        spec.it_value = spec.it_interval;
+    }
+    timerfd_settime(timer_fd, 0, &spec, NULL);
+    *armed = want;
+}
+
+void run_event_loop(Display *x_display, int ipc_fd) {
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGCHLD);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGUSR1);
+    sigaddset(&signals, SIGUSR2);
+    sigprocmask(SIG_BLOCK, &signals, NULL);
+    
+    int signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    assert(signal_fd >= 0 && timer_fd >= 0 && epoll_fd >= 0);
+    
+    int x_fd = ConnectionNumber(x_display);
+    int fds[] = {x_fd, signal_fd, timer_fd, ipc_fd};
+    for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); i++) {
+        if (fds[i] < 0) continue;
+        struct epoll_event ev = {.events = EPOLLIN, .data.fd = fds[i]};
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fds[i], &ev);
+    }
+    
+    bool timer_armed = false;
+    timer_wheel_sync(&wm.timers, now_tick());
+    
+    XEvent event;
+    while (wm.running) {
+        /* Drain the whole event batch; QueuedAfterReading never flushes */
+        while (wm.running && XEventsQueued(x_display, QueuedAfterReading)) {
+            XNextEvent(x_display, &event);
+            dispatch_event(&event);
+        }
+        if (!wm.running) break;
+        
+        /* Everything the batch (and any timers before it) changed goes out
+         * in one burst behind the only flush in the loop */
+        commit_batch();
+        update_timer_fd(timer_fd, &timer_armed);
+        XFlush(x_display);
+        ipc_server_flush();
+        
+        /* Replies the commit waited on can pull events into Xlib's queue,
+         * where epoll never sees them; handle those before sleeping */
+        if (QLength(x_display) > 0) continue;
+        
+        struct epoll_event ready[4];
+        int count = epoll_wait(epoll_fd, ready, 4, -1);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+        
+        /* Timers scheduled from here on count from now, not from the end
+         * of the last idle spell */
+        timer_wheel_sync(&wm.timers, now_tick());
+        
+        for (int i = 0; i < count; i++) {
+            int fd = ready[i].data.fd;
+            if (fd == signal_fd) {
+                handle_signals(signal_fd);
+            } else if (fd == timer_fd) {
+                uint64_t expirations;
+                while (read(timer_fd, &expirations, sizeof(expirations)) > 0);
+                span_begin("timers", 0);
+                timer_wheel_advance(&wm.timers, now_tick());
+                span_end("timers");
+            } else if (fd == ipc_fd) {
+                ipc_server_dispatch();
+            }
+            /* The X fd needs no action here: XPending reads it next iteration */
+        }
+    }
+    
+    close(epoll_fd);
+    close(timer_fd);
+    close(signal_fd);
+}
+
+/* $SWM_CONFIG, else swm/swmrc in the XDG config directory */
+static bool settings_file_path(char *path, size_t size) {
+    const char *file = getenv(SETTINGS_FILE_ENV);
+    if (file && *file) {
+        return snprintf(path, size, "%s", file) < (int)size;
+    }
+    
+    const char *config_home = getenv("XDG_CONFIG_HOME");
+    if (config_home && *config_home) {
+        return snprintf(path, size, "%s/%s", config_home, SETTINGS_FILE) < (int)size;
+    }
+    const char *home = getenv("HOME");
+    if (home && *home) {
+        return snprintf(path, size, "%s/.config/%s", home, SETTINGS_FILE) < (int)size;
+    }
+    return false;
+}
+
 int main(void) {
     /* Set up X11 error handler */
     XSetErrorHandler(x11_error_handler);
@@ -598,63 +646,120 @@ int main(void) {
         return 1;
     }
     
-    int screen = DefaultScreen(x_display);
-    Window root = RootWindow(x_display, screen);
-    
-    /* Check for Xinerama */
-    if (!XineramaIsActive(x_display)) {
-        fprintf(stderr, "Xinerama not active\n");
-        XCloseDisplay(x_display);
-        return 1;
+    /* Initialize window manager, with every round trip spanned if asked to */
+    const char *span_path = getenv(SPAN_FILE_ENV);
+    if (span_path && *span_path && span_open(SPAN_BUFFER_SIZE)) {
+        printf("Recording event spans for %s\n", span_path);
+        wm_init(span_wrap_ops(&xlib_ops));
+    } else {
+        wm_init(&xlib_ops);
     }
     
-    /* Create display manager */
-    DisplayManager *display = create_display_manager(x_display, screen, root);
+    /* Settings file over the config.h defaults, before zones are split */
+    static char settings_path[4096];
+    if (settings_file_path(settings_path, sizeof(settings_path))) {
+        wm.settings_path = settings_path;
+        Settings settings;
+        if (settings_load(&settings, settings_path, stderr)) {
+            apply_settings(&settings);
+        } else {
+            fprintf(stderr, "Using default settings\n");
+        }
+    }
     
-    /* Setup monitors and zones */
-    if (!setup_display_zones(display)) {
+    /* One manager per X screen, each with its own zones, all served by this
+     * connection. Focus starts on the default screen. */
+    DisplayManager **link = &wm.displays;
+    for (int screen = 0; screen < ScreenCount(x_display); screen++) {
+        DisplayManager *display = create_display_manager(x_display, screen, RootWindow(x_display, screen));
+        if (!setup_display_zones(display)) {
+            free(display);
+            continue;
+        }
+        
+        /* Select events */
+        XSelectInput(x_display, display->root,
+                     SubstructureRedirectMask | SubstructureNotifyMask | PropertyChangeMask);
+        
+        /* Advertise EWMH support */
+        setup_ewmh(display);
+        
+        *link = display;
+        link = &display->next;
+        wm.display_count++;
+        if (screen == DefaultScreen(x_display) || !wm.active_display) {
+            wm.active_display = display;
+        }
+    }
+    if (!wm.displays) {
         XCloseDisplay(x_display);
         return 1;
     }
     
-    /* Initialize window manager */
-    wm.displays = display;
-    // TODO: this needs to be changed when we have multiple displays
-    wm.active_display = display;
-    wm.display_count = 1;
+    /* Rules and bindings are shared by all screens */
+    DisplayManager *display = wm.active_display;
+    load_config_rules(display);
+    load_config_keys(wm.displays);
     
-    /* Select events */
-    XSelectInput(x_display, root, 
-                 SubstructureRedirectMask | SubstructureNotifyMask | PropertyChangeMask);
+    /* Optionally record dispatched events for offline replay */
+    const char *trace_path = getenv(TRACE_FILE_ENV);
+    if (trace_path && *trace_path && record_open(trace_path, display->zones, display->zone_count)) {
+        printf("Recording event trace to %s\n", trace_path);
+    }
     
-    /* Main event loop */
-    XEvent event;
-    while (1) {
-        XNextEvent(x_display, &event);
-        
-        switch (event.type) {
-            case MapRequest:
-                handle_map_request(&event.xmaprequest);
-                break;
-            case UnmapNotify:
-                handle_unmap_notify(&event.xunmap);
-                break;
-            case PropertyNotify:
-                handle_property_notify(&event.xproperty);
-                break;
-#if FOCUS_FOLLOWS_MOUSE
-            case EnterNotify:
-                handle_enter_notify(&event.xcrossing);
-                break;
+    /* Read-only state block for status bars, and the event stream for tools */
+    char ipc_name[64];
+    ipc_state_name(ipc_name, sizeof(ipc_name), DisplayString(x_display));
+#if STATE_EXPORT
+    if (ipc_state_open(ipc_name)) {
+        printf("Exporting state to shared memory %s\n", ipc_name);
+    }
 #endif
-        }
+    int ipc_fd = -1;
+#if EVENT_SUBSCRIPTIONS
+    ipc_fd = ipc_server_open(ipc_name);
+    if (ipc_fd >= 0) {
+        printf("Accepting event subscribers on @%s\n", ipc_name);
     }
+#endif
+    
+    /* Main event loop */
+    run_event_loop(x_display, ipc_fd);
     
     /* Cleanup */
-    if (display->zones) free(display->zones);
-    if (display->zone_clients) free(display->zone_clients);
-    if (display->zone_current_index) free(display->zone_current_index);
-    free(display);
+    wm_cleanup();
+    record_close();
+    if (span_is_active()) {
+        span_dump(span_path);
+        span_close();
+    }
+    ipc_state_close();
+    ipc_server_close();
+    while (wm.displays) {
+        display = wm.displays;
+        wm.displays = display->next;
+        
+        XDestroyWindow(x_display, display->wm_check_window);
+        for (int zone = 0; zone < display->zone_count; zone++) {
+            while (display->zone_clients[zone]) {
+                Client *client = display->zone_clients[zone];
+                /* Hand hidden monocle windows back mapped */
+                if (client->hidden) {
+                    XMapWindow(x_display, client->window);
+                }
+                unmanage_client(display, client);
+            }
+        }
+        if (display->zones) free(display->zones);
+        if (display->zone_clients) free(display->zone_clients);
+        if (display->zone_current_index) free(display->zone_current_index);
+        if (display->zone_stack) free(display->zone_stack);
+        if (display->zone_stack_dirty) free(display->zone_stack_dirty);
+        if (display->zone_monocle) free(display->zone_monocle);
+        free_docks(display);
+        free(display);
+    }
+    wm.active_display = NULL;
     XCloseDisplay(x_display);
     
     return 0;
@@ -0,0 +1,172 @@
+#define _DEFAULT_SOURCE  /* For kill */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include "config.h"
+#include "ipc.h"
+
+/* swm client for status bars and scripts
+ *
+ * Reads the state swm exports to shared memory without talking to the X
+ * server, or subscribes to swm's event stream. Output is one line per fact
+ * so shell scripts can pick fields with awk or read. send is the one
+ * subcommand that connects to X, to queue a command for swm. */
+
+static const char *event_names[SWM_EVENT_TYPE_COUNT] = {
+    [SWM_EVENT_FOCUS] = "focus",
+    [SWM_EVENT_MAP]   = "map",
+    [SWM_EVENT_UNMAP] = "unmap",
+    [SWM_EVENT_ZONE]  = "zone",
+    [SWM_EVENT_MOVE]  = "move",
+};
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s status\n", name);
+    fprintf(stderr, "       %s subscribe [focus|map|unmap|zone|move ...]\n", name);
+    fprintf(stderr, "       %s send COMMAND [ARGUMENT...] [COMMAND [ARGUMENT...]...]\n", name);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "  status     Print active zone, focused window and per-zone window counts\n");
+    fprintf(stderr, "  subscribe  Print one line per change swm makes, for all or the named events\n");
+    fprintf(stderr, "  send       Queue command numbers and their arguments on %s, run in one pass\n",
+            COMMAND_PROPERTY);
+}
+
+static int print_status(void) {
+    char name[64];
+    ipc_state_name(name, sizeof(name), NULL);
+
+    const SwmState *shared = ipc_state_attach(name);
+    if (!shared) {
+        fprintf(stderr, "swmc: no state exported at %s (is swm running?)\n", name);
+        return 1;
+    }
+
+    SwmState state;
+    bool ok = ipc_state_read(shared, &state);
+    ipc_state_detach(shared);
+    if (!ok) {
+        fprintf(stderr, "swmc: could not read a consistent state from %s\n", name);
+        return 1;
+    }
+    if (kill((pid_t)state.pid, 0) < 0 && errno == ESRCH) {
+        fprintf(stderr, "swmc: state at %s is left over from an exited swm\n", name);
+        return 1;
+    }
+
+    printf("active_zone %d\n", state.active_zone);
+    printf("focused 0x%llx %s\n", (unsigned long long)state.focused_window, state.focused_title);
+    for (uint32_t zone = 0; zone < state.zone_count && zone < SWM_STATE_MAX_ZONES; zone++) {
+        const SwmStateZone *z = &state.zones[zone];
+        printf("zone %u %dx%d+%d+%d clients %u current 0x%llx monocle %u\n", zone,
+               z->width, z->height, z->x, z->y, z->client_count,
+               (unsigned long long)z->current_window, z->monocle);
+    }
+    return 0;
+}
+
+static int subscribe(int argc, char *argv[]) {
+    uint32_t mask = argc ? 0 : SWM_EVENT_MASK_ALL;
+    for (int i = 0; i < argc; i++) {
+        int type = 1;
+        while (type < SWM_EVENT_TYPE_COUNT && strcmp(argv[i], event_names[type]) != 0) type++;
+        if (type == SWM_EVENT_TYPE_COUNT) {
+            fprintf(stderr, "swmc: unknown event '%s'\n", argv[i]);
+            return 1;
+        }
+        mask |= SWM_EVENT_MASK(type);
+    }
+
+    char name[64];
+    ipc_state_name(name, sizeof(name), NULL);
+    int fd = ipc_subscribe(name, mask);
+    if (fd < 0) {
+        fprintf(stderr, "swmc: cannot subscribe at @%s (is swm running?)\n", name);
+        return 1;
+    }
+
+    /* Consumers usually sit behind a pipe */
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    SwmEvent event;
+    size_t have = 0;
+    for (;;) {
+        ssize_t length = read(fd, (char *)&event + have, sizeof(event) - have);
+        if (length < 0 && errno == EINTR) continue;
+        if (length <= 0) break;
+        have += (size_t)length;
+        if (have < sizeof(event)) continue;
+        have = 0;
+
+        if (event.dropped) {
+            printf("dropped %u\n", event.dropped);
+        }
+        if (event.type == SWM_EVENT_DROPPED || event.type >= SWM_EVENT_TYPE_COUNT) continue;
+        if (event.type == SWM_EVENT_ZONE) {
+            printf("zone %d\n", event.zone);
+        } else {
+            printf("%s 0x%llx zone %d\n", event_names[event.type],
+                   (unsigned long long)event.window, event.zone);
+        }
+    }
+    close(fd);
+    return 0;
+}
+
+/* Append rather than replace, so a command sent just before this one and
+ * not yet read by swm is not lost. Everything goes in one request, so swm
+ * reads a batch of commands together and runs them in one pass. */
+static int send_command(int argc, char *argv[]) {
+    long *items = malloc(argc * sizeof(long));
+    if (!items) {
+        perror("swmc");
+        return 1;
+    }
+    for (int i = 0; i < argc; i++) {
+        char *end;
+        items[i] = strtol(argv[i], &end, 0);
+        if (*argv[i] == '\0' || *end != '\0') {
+            fprintf(stderr, "swmc: '%s' is not a number\n", argv[i]);
+            free(items);
+            return 1;
+        }
+    }
+    if (items[0] <= 0 || items[0] >= CMD_COUNT) {
+        fprintf(stderr, "swmc: unknown command %ld\n", items[0]);
+        free(items);
+        return 1;
+    }
+
+    Display *display = XOpenDisplay(NULL);
+    if (!display) {
+        fprintf(stderr, "swmc: cannot open display\n");
+        free(items);
+        return 1;
+    }
+    Atom property = XInternAtom(display, COMMAND_PROPERTY, False);
+    XChangeProperty(display, DefaultRootWindow(display), property, XA_INTEGER, 32,
+                    PropModeAppend, (unsigned char *)items, argc);
+    XCloseDisplay(display);
+    free(items);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc == 2 && strcmp(argv[1], "status") == 0) {
+        return print_status();
+    }
+    if (argc >= 2 && strcmp(argv[1], "subscribe") == 0) {
+        return subscribe(argc - 2, argv + 2);
+    }
+    if (argc >= 3 && strcmp(argv[1], "send") == 0) {
+        return send_command(argc - 2, argv + 2);
+    }
+    usage(argv[0]);
+    return 1;
+}
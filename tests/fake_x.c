@@ -0,0 +1,791 @@
+#define _DEFAULT_SOURCE  /* For dup */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include "config.h"
+#include "core.h"
+#include "xops.h"
+#include "fake_x.h"
+
+/* In-memory fake X server
+ *
+ * Windows live in an open-addressed table keyed by XID and are never removed,
+ * only marked destroyed, so a FakeWindow pointer stays valid until the next
+ * fake_create_window(). The stacking order is a flat bottom-to-top array. */
+
+#define FAKE_ROOT       1
+#define FAKE_ATOM_BASE  1000
+#define FAKE_INTERN_BASE 2000
+#define FAKE_MAX_ATOMS  64
+
+FakeStats fake_stats;
+
+static FakeWindow *windows = NULL;
+static int window_capacity = 0;
+static int window_count = 0;
+
+static Window *stack = NULL;
+static int stack_count = 0;
+static int stack_capacity = 0;
+
+static Window focus = PointerRoot;
+static unsigned long serial = 0;   /* Requests processed, unaffected by stats resets */
+
+#define FAKE_MAX_EVENTS 256
+
+static XEvent events[FAKE_MAX_EVENTS];
+static int event_head = 0;
+static int event_count = 0;
+
+static bool pointer_active = false;
+static int pointer_x, pointer_y;
+static Window pointer_window = None;
+
+static char *atom_names[FAKE_MAX_ATOMS];
+static int atom_count = 0;
+
+/* Keysyms get keycodes from FAKE_MIN_KEYCODE up, in order of first lookup */
+#define FAKE_MIN_KEYCODE 8
+#define FAKE_MAX_KEYS    64
+#define FAKE_MAX_GRABS   256
+
+static KeySym keymap[FAKE_MAX_KEYS];
+static int keymap_count = 0;
+
+typedef struct {
+    int keycode;
+    unsigned int modifiers;
+} FakeGrab;
+
+static FakeGrab grabs[FAKE_MAX_GRABS];
+static int grab_count = 0;
+
+static unsigned long hash_window(Window window) {
+    return (unsigned long)window * 2654435761UL;
+}
+
+static FakeWindow *find_slot(FakeWindow *table, int capacity, Window window) {
+    unsigned long i = hash_window(window) & (capacity - 1);
+    while (table[i].window != None && table[i].window != window) {
+        i = (i + 1) & (capacity - 1);
+    }
+    return &table[i];
+}
+
+static void grow_windows(void) {
+    int capacity = window_capacity ? window_capacity * 2 : 256;
+    FakeWindow *table = calloc(capacity, sizeof(FakeWindow));
+    assert(table != NULL);
+
+    for (int i = 0; i < window_capacity; i++) {
+        if (windows[i].window != None) {
+            *find_slot(table, capacity, windows[i].window) = windows[i];
+        }
+    }
+    free(windows);
+    windows = table;
+    window_capacity = capacity;
+}
+
+FakeWindow *fake_window(Window window) {
+    if (!window_capacity || window == None) return NULL;
+    FakeWindow *slot = find_slot(windows, window_capacity, window);
+    return slot->window == window ? slot : NULL;
+}
+
+static void stack_unlink(Window window) {
+    for (int i = 0; i < stack_count; i++) {
+        if (stack[i] == window) {
+            memmove(&stack[i], &stack[i + 1], (stack_count - i - 1) * sizeof(Window));
+            stack_count--;
+            return;
+        }
+    }
+}
+
+static int stack_position(Window window) {
+    for (int i = 0; i < stack_count; i++) {
+        if (stack[i] == window) return i;
+    }
+    return -1;
+}
+
+static void stack_insert(int position, Window window) {
+    if (stack_count == stack_capacity) {
+        stack_capacity = stack_capacity ? stack_capacity * 2 : 64;
+        stack = realloc(stack, stack_capacity * sizeof(Window));
+        assert(stack != NULL);
+    }
+    memmove(&stack[position + 1], &stack[position], (stack_count - position) * sizeof(Window));
+    stack[position] = window;
+    stack_count++;
+}
+
+static void queue_event(XEvent *event);
+
+/* Topmost mapped window containing the pointer, border included */
+static Window window_at_pointer(void) {
+    for (int i = stack_count - 1; i >= 0; i--) {
+        FakeWindow *fake = fake_window(stack[i]);
+        if (!fake || !fake->mapped) continue;
+        int extent = 2 * fake->border_width;
+        if (pointer_x >= fake->x && pointer_x < fake->x + fake->width + extent &&
+            pointer_y >= fake->y && pointer_y < fake->y + fake->height + extent) {
+            return fake->window;
+        }
+    }
+    return FAKE_ROOT;
+}
+
+static void update_pointer_window(void) {
+    if (!pointer_active) return;
+
+    Window under = window_at_pointer();
+    if (under == pointer_window) return;
+    pointer_window = under;
+    if (under == FAKE_ROOT) return;
+
+    XEvent event = {0};
+    event.xcrossing.type = EnterNotify;
+    event.xcrossing.serial = serial;
+    event.xcrossing.window = under;
+    event.xcrossing.root = FAKE_ROOT;
+    event.xcrossing.x_root = pointer_x;
+    event.xcrossing.y_root = pointer_y;
+    event.xcrossing.mode = NotifyNormal;
+    event.xcrossing.detail = NotifyNonlinear;
+    queue_event(&event);
+}
+
+void fake_warp_pointer(int x, int y) {
+    pointer_active = true;
+    pointer_x = x;
+    pointer_y = y;
+    update_pointer_window();
+}
+
+/* New windows start mapped-off, on top of the stack, like CreateWindow */
+FakeWindow *fake_create_window(Window window) {
+    FakeWindow *existing = fake_window(window);
+    if (existing && existing->exists) return existing;
+
+    if (!existing && (window_count + 1) * 2 > window_capacity) {
+        grow_windows();
+    }
+
+    FakeWindow *slot = existing ? existing : find_slot(windows, window_capacity, window);
+    if (!existing) window_count++;
+    for (int i = 0; i < slot->property_count; i++) {
+        free(slot->properties[i].items);
+        free(slot->properties[i].text);
+    }
+    free(slot->properties);
+
+    memset(slot, 0, sizeof(*slot));
+    slot->window = window;
+    slot->exists = true;
+    if (window != FAKE_ROOT) {
+        stack_insert(stack_count, window);
+    }
+    return slot;
+}
+
+void fake_destroy_window(Window window) {
+    FakeWindow *fake = fake_window(window);
+    if (!fake || !fake->exists) return;
+
+    fake->exists = false;
+    fake->mapped = false;
+    stack_unlink(window);
+    if (focus == window) focus = PointerRoot;
+    update_pointer_window();
+}
+
+static FakeWindow *live_window(Window window) {
+    FakeWindow *fake = fake_window(window);
+    return fake && fake->exists ? fake : NULL;
+}
+
+FakeProperty *fake_get_property(Window window, Atom property) {
+    FakeWindow *fake = live_window(window);
+    if (!fake) return NULL;
+
+    for (int i = 0; i < fake->property_count; i++) {
+        if (fake->properties[i].atom == property) return &fake->properties[i];
+    }
+    return NULL;
+}
+
+static FakeProperty *store_property(Window window, Atom property, Atom type, int format) {
+    FakeWindow *fake = live_window(window);
+    if (!fake) return NULL;
+
+    FakeProperty *prop = fake_get_property(window, property);
+    if (!prop) {
+        fake->properties = realloc(fake->properties, (fake->property_count + 1) * sizeof(FakeProperty));
+        assert(fake->properties != NULL);
+        prop = &fake->properties[fake->property_count++];
+        prop->atom = property;
+        prop->items = NULL;
+        prop->text = NULL;
+    }
+
+    prop->type = type;
+    prop->format = format;
+    return prop;
+}
+
+void fake_set_property32(Window window, Atom property, Atom type, const long *items, int count) {
+    FakeProperty *prop = store_property(window, property, type, 32);
+    if (!prop) return;
+
+    prop->count = count;
+    prop->items = realloc(prop->items, (count > 0 ? count : 1) * sizeof(long));
+    assert(prop->items != NULL);
+    if (count > 0) memcpy(prop->items, items, count * sizeof(long));
+}
+
+/* PropModeAppend; a missing property is created */
+void fake_append_property32(Window window, Atom property, Atom type, const long *items, int count) {
+    FakeProperty *existing = fake_get_property(window, property);
+    int have = existing && existing->format == 32 ? existing->count : 0;
+    FakeProperty *prop = store_property(window, property, type, 32);
+    if (!prop) return;
+
+    prop->items = realloc(prop->items, (have + count > 0 ? have + count : 1) * sizeof(long));
+    assert(prop->items != NULL);
+    if (count > 0) memcpy(prop->items + have, items, count * sizeof(long));
+    prop->count = have + count;
+}
+
+void fake_set_text_property(Window window, Atom property, Atom type, const char *text, int length) {
+    FakeProperty *prop = store_property(window, property, type, 8);
+    if (!prop) return;
+
+    prop->count = length;
+    prop->text = realloc(prop->text, length + 1);
+    assert(prop->text != NULL);
+    memcpy(prop->text, text, length);
+    prop->text[length] = '\0';
+}
+
+static void delete_property(Window window, Atom property) {
+    FakeWindow *fake = live_window(window);
+    FakeProperty *prop = fake_get_property(window, property);
+    if (!prop) return;
+
+    free(prop->items);
+    free(prop->text);
+    *prop = fake->properties[--fake->property_count];
+
+    /* Deleting notifies like any other change, as swm pays for on the root */
+    if (fake->event_mask & PropertyChangeMask) {
+        XEvent event = {0};
+        event.xproperty.type = PropertyNotify;
+        event.xproperty.serial = serial;
+        event.xproperty.window = window;
+        event.xproperty.atom = property;
+        event.xproperty.state = PropertyDelete;
+        queue_event(&event);
+    }
+}
+
+int fake_stacking_order(Window *out, int max_windows) {
+    int count = 0;
+    for (int i = 0; i < stack_count && count < max_windows; i++) {
+        out[count++] = stack[i];
+    }
+    return count;
+}
+
+Window fake_focus(void) {
+    return focus;
+}
+
+static void queue_event(XEvent *event) {
+    assert(event_count < FAKE_MAX_EVENTS);
+    events[(event_head + event_count++) % FAKE_MAX_EVENTS] = *event;
+}
+
+bool fake_next_event(XEvent *event) {
+    if (event_count == 0) return false;
+    *event = events[event_head];
+    event_head = (event_head + 1) % FAKE_MAX_EVENTS;
+    event_count--;
+    return true;
+}
+
+/* Atoms interned by name get stable numbers until the next reset */
+Atom fake_intern_atom(const char *name) {
+    for (int i = 0; i < atom_count; i++) {
+        if (strcmp(atom_names[i], name) == 0) return FAKE_INTERN_BASE + i;
+    }
+    assert(atom_count < FAKE_MAX_ATOMS);
+    atom_names[atom_count] = strdup(name);
+    assert(atom_names[atom_count] != NULL);
+    return FAKE_INTERN_BASE + atom_count++;
+}
+
+KeyCode fake_keycode(KeySym keysym) {
+    for (int i = 0; i < keymap_count; i++) {
+        if (keymap[i] == keysym) return FAKE_MIN_KEYCODE + i;
+    }
+    assert(keymap_count < FAKE_MAX_KEYS);
+    keymap[keymap_count] = keysym;
+    return FAKE_MIN_KEYCODE + keymap_count++;
+}
+
+bool fake_key_grabbed(int keycode, unsigned int modifiers) {
+    for (int i = 0; i < grab_count; i++) {
+        if (grabs[i].keycode == keycode && grabs[i].modifiers == modifiers) return true;
+    }
+    return false;
+}
+
+int fake_grab_count(void) {
+    return grab_count;
+}
+
+void fake_stats_reset(void) {
+    memset(&fake_stats, 0, sizeof(fake_stats));
+}
+
+void fake_x_reset(void) {
+    for (int i = 0; i < window_capacity; i++) {
+        for (int p = 0; p < windows[i].property_count; p++) {
+            free(windows[i].properties[p].items);
+            free(windows[i].properties[p].text);
+        }
+        free(windows[i].properties);
+    }
+    free(windows);
+    free(stack);
+    windows = NULL;
+    window_capacity = window_count = 0;
+    stack = NULL;
+    stack_count = stack_capacity = 0;
+    focus = PointerRoot;
+    serial = 0;
+    for (int i = 0; i < atom_count; i++) {
+        free(atom_names[i]);
+    }
+    atom_count = 0;
+    keymap_count = 0;
+    grab_count = 0;
+    event_head = event_count = 0;
+    pointer_active = false;
+    pointer_window = None;
+    fake_stats_reset();
+    fake_create_window(FAKE_ROOT);
+}
+
+/* XOps implementation */
+
+static void count_op(int op, int requests) {
+    fake_stats.ops[op]++;
+    fake_stats.requests += requests;
+    serial += requests;
+}
+
+static void count_reply(void) {
+    fake_stats.round_trips++;
+}
+
+static void fake_move_resize(Display *display, Window window, int x, int y, int width, int height) {
+    (void)display;
+    count_op(FAKE_MOVE_RESIZE, 1);
+    FakeWindow *fake = live_window(window);
+    if (!fake) return;
+    fake->x = x;
+    fake->y = y;
+    fake->width = width;
+    fake->height = height;
+    update_pointer_window();
+}
+
+/* XSetWindowBorder + XSetWindowBorderWidth */
+static void fake_set_border(Display *display, Window window, unsigned long color, int width) {
+    (void)display;
+    count_op(FAKE_SET_BORDER, 2);
+    FakeWindow *fake = live_window(window);
+    if (!fake) return;
+    fake->border_color = color;
+    fake->border_width = width;
+    update_pointer_window();
+}
+
+static void fake_set_focus(Display *display, Window window) {
+    (void)display;
+    count_op(FAKE_SET_FOCUS, 1);
+    if (live_window(window)) focus = window;
+}
+
+/* XRestackWindows: windows[0] keeps its place, each following window goes
+ * directly below the one before it. Xlib sends one ConfigureWindow per move. */
+static void fake_restack(Display *display, Window *list, int count) {
+    (void)display;
+    count_op(FAKE_RESTACK, count > 1 ? count - 1 : 0);
+
+    for (int i = 1; i < count; i++) {
+        if (!live_window(list[i]) || stack_position(list[i - 1]) < 0) continue;
+        stack_unlink(list[i]);
+        stack_insert(stack_position(list[i - 1]), list[i]);
+    }
+    update_pointer_window();
+}
+
+static void fake_map(Display *display, Window window) {
+    (void)display;
+    count_op(FAKE_MAP, 1);
+    FakeWindow *fake = live_window(window);
+    if (!fake) return;
+    fake->mapped = true;
+    fake->map_serial = serial;
+    update_pointer_window();
+}
+
+/* Like the real server, only unmapping a mapped window generates UnmapNotify */
+static void fake_unmap(Display *display, Window window) {
+    (void)display;
+    count_op(FAKE_UNMAP, 1);
+    FakeWindow *fake = live_window(window);
+    if (!fake || !fake->mapped) return;
+    fake->mapped = false;
+    fake->unmap_serial = serial;
+
+    XEvent event = {0};
+    event.xunmap.type = UnmapNotify;
+    event.xunmap.event = FAKE_ROOT;
+    event.xunmap.window = window;
+    queue_event(&event);
+    update_pointer_window();
+}
+
+static void fake_select_input(Display *display, Window window, long mask) {
+    (void)display;
+    count_op(FAKE_SELECT_INPUT, 1);
+    FakeWindow *fake = live_window(window);
+    if (fake) fake->event_mask = mask;
+}
+
+/* The fake client goes away at once; its UnmapNotify is up to the test */
+static void fake_kill_client(Display *display, Window window) {
+    (void)display;
+    count_op(FAKE_KILL_CLIENT, 1);
+    FakeWindow *fake = live_window(window);
+    if (!fake) return;
+    fake->killed = true;
+    fake_destroy_window(window);
+}
+
+static void fake_no_operation(Display *display) {
+    (void)display;
+    count_op(FAKE_NO_OPERATION, 1);
+}
+
+static void fake_send_message(Display *display, Window window, Atom type, long data0, long data1) {
+    (void)display;
+    (void)data1;
+    count_op(FAKE_SEND_MESSAGE, 1);
+    FakeWindow *fake = live_window(window);
+    if (fake && type == FAKE_ATOM_BASE + 1 + WM_PROTOCOLS &&
+        data0 == FAKE_ATOM_BASE + 1 + WM_DELETE_WINDOW) {
+        fake->delete_requests++;
+    }
+}
+
+static void fake_change_property(Display *display, Window window, Atom property, Atom type,
+                                 int format, const void *data, int count) {
+    (void)display;
+    count_op(FAKE_CHANGE_PROPERTY, 1);
+    if (format == 8) {
+        fake_set_text_property(window, property, type, data, count);
+        return;
+    }
+    assert(format == 32);
+
+    long *items = malloc((count > 0 ? count : 1) * sizeof(long));
+    assert(items != NULL);
+    for (int i = 0; i < count; i++) {
+        /* Window and Atom arrays are unsigned long, same width as long */
+        items[i] = (long)((const unsigned long *)data)[i];
+    }
+    fake_set_property32(window, property, type, items, count);
+    free(items);
+}
+
+static void fake_grab_key(Display *display, Window window, int keycode, unsigned int modifiers) {
+    (void)display;
+    (void)window;
+    count_op(FAKE_GRAB_KEY, 1);
+    if (fake_key_grabbed(keycode, modifiers)) return;
+    assert(grab_count < FAKE_MAX_GRABS);
+    grabs[grab_count++] = (FakeGrab){keycode, modifiers};
+}
+
+static void fake_ungrab_keys(Display *display, Window window) {
+    (void)display;
+    (void)window;
+    count_op(FAKE_UNGRAB_KEYS, 1);
+    grab_count = 0;
+}
+
+static bool fake_window_exists(Display *display, Window window) {
+    (void)display;
+    count_op(FAKE_WINDOW_EXISTS, 1);
+    count_reply();
+    return live_window(window) != NULL;
+}
+
+static bool fake_get_size(Display *display, Window window, int *width, int *height) {
+    (void)display;
+    count_op(FAKE_GET_SIZE, 1);
+    count_reply();
+
+    FakeWindow *fake = live_window(window);
+    if (!fake) return false;
+    *width = fake->width;
+    *height = fake->height;
+    return true;
+}
+
+static int read_property32(Window window, Atom property, Atom type, bool delete,
+                          long *items, int max_items) {
+    if (!live_window(window)) return -1;
+    FakeProperty *prop = fake_get_property(window, property);
+    if (!prop || prop->format != 32 || (type != AnyPropertyType && prop->type != type)) return 0;
+
+    int count = prop->count < max_items ? prop->count : max_items;
+    memcpy(items, prop->items, count * sizeof(long));
+    if (delete && count == prop->count) {
+        delete_property(window, property);
+    }
+    return count;
+}
+
+static int fake_get_property32(Display *display, Window window, Atom property, Atom type,
+                               bool delete, long *items, int max_items) {
+    (void)display;
+    count_op(FAKE_GET_PROPERTY, 1);
+    count_reply();
+    return read_property32(window, property, type, delete, items, max_items);
+}
+
+static int fake_take_property32(Display *display, Window window, Atom property, Atom type,
+                                long **items) {
+    (void)display;
+    count_op(FAKE_GET_PROPERTY, 1);
+    count_reply();
+
+    *items = NULL;
+    if (!live_window(window)) return -1;
+    FakeProperty *prop = fake_get_property(window, property);
+    if (!prop || prop->format != 32 || (type != AnyPropertyType && prop->type != type)) return 0;
+
+    int count = prop->count;
+    if (count > 0) {
+        *items = malloc(count * sizeof(long));
+        assert(*items != NULL);
+        memcpy(*items, prop->items, count * sizeof(long));
+    }
+    delete_property(window, property);
+    return count;
+}
+
+static int read_text_property(Window window, Atom property, Atom type, char *buffer, int size) {
+    if (!live_window(window)) return -1;
+    FakeProperty *prop = fake_get_property(window, property);
+    int length = 0;
+    if (prop && prop->format == 8 && (type == AnyPropertyType || prop->type == type)) {
+        length = prop->count < size ? prop->count : size - 1;
+        memcpy(buffer, prop->text, length);
+    }
+    buffer[length] = '\0';
+    return length;
+}
+
+static int fake_get_text_property(Display *display, Window window, Atom property, Atom type,
+                                  char *buffer, int size) {
+    (void)display;
+    count_op(FAKE_GET_PROPERTY, 1);
+    count_reply();
+    return read_text_property(window, property, type, buffer, size);
+}
+
+static void fake_get_properties(Display *display, Window window, PropertyRead *reads, int count,
+                                int *width, int *height) {
+    (void)display;
+    assert(count <= PROPERTY_READS_MAX);
+    for (int i = 0; i < count; i++) {
+        count_op(FAKE_GET_PROPERTY, 1);
+    }
+    if (width) {
+        count_op(FAKE_GET_SIZE, 1);
+    }
+    if (count > 0 || width) {
+        count_reply();
+    }
+
+    for (int i = 0; i < count; i++) {
+        PropertyRead *read = &reads[i];
+        if (read->format == 32) {
+            read->count = read_property32(window, read->property, read->type, false,
+                                          read->data, read->size);
+        } else {
+            read->count = read_text_property(window, read->property, read->type,
+                                             read->data, read->size);
+        }
+    }
+    if (width) {
+        FakeWindow *fake = live_window(window);
+        *width = fake ? fake->width : 0;
+        *height = fake ? fake->height : 0;
+    }
+}
+
+static Atom fake_x_intern_atom(Display *display, const char *name) {
+    (void)display;
+    count_op(FAKE_INTERN_ATOM, 1);
+    count_reply();
+    return fake_intern_atom(name);
+}
+
+/* NumLock sits on Mod2, as on most X servers */
+static unsigned int fake_numlock_mask(Display *display) {
+    (void)display;
+    count_op(FAKE_GET_MODIFIERS, 1);
+    count_reply();
+    return Mod2Mask;
+}
+
+static KeyCode fake_keysym_to_keycode(Display *display, KeySym keysym) {
+    (void)display;
+    return fake_keycode(keysym);
+}
+
+static void fake_refresh_keyboard(XMappingEvent *event) {
+    (void)event;
+}
+
+static unsigned long fake_next_request(Display *display) {
+    (void)display;
+    return serial + 1;
+}
+
+const XOps fake_x_ops = {
+    .move_resize       = fake_move_resize,
+    .set_border        = fake_set_border,
+    .set_focus         = fake_set_focus,
+    .restack           = fake_restack,
+    .map               = fake_map,
+    .unmap             = fake_unmap,
+    .select_input      = fake_select_input,
+    .kill_client       = fake_kill_client,
+    .no_operation      = fake_no_operation,
+    .send_message      = fake_send_message,
+    .change_property   = fake_change_property,
+    .grab_key          = fake_grab_key,
+    .ungrab_keys       = fake_ungrab_keys,
+    .window_exists     = fake_window_exists,
+    .get_size          = fake_get_size,
+    .get_property32    = fake_get_property32,
+    .take_property32   = fake_take_property32,
+    .get_text_property = fake_get_text_property,
+    .get_properties    = fake_get_properties,
+    .intern_atom       = fake_x_intern_atom,
+    .numlock_mask      = fake_numlock_mask,
+    .keysym_to_keycode = fake_keysym_to_keycode,
+    .refresh_keyboard  = fake_refresh_keyboard,
+    .next_request      = fake_next_request,
+};
+
+/* Display manager */
+
+/* Takes ownership of zones */
+DisplayManager *fake_display_manager(LogicalZone *zones, int zone_count) {
+    return fake_screen_manager(0, FAKE_ROOT, zones, zone_count);
+}
+
+DisplayManager *fake_screen_manager(int screen, Window root, LogicalZone *zones, int zone_count) {
+    DisplayManager *display = calloc(1, sizeof(DisplayManager));
+    assert(display != NULL);
+
+    display->x_display = NULL;
+    display->screen = screen;
+    display->root = root;
+    display->zones = zones;
+    display->zone_count = zone_count;
+    display->zone_clients = calloc(display->zone_count, sizeof(Client*));
+    display->zone_current_index = malloc(display->zone_count * sizeof(int));
+    display->zone_stack = calloc(display->zone_count, sizeof(Client*));
+    display->zone_stack_dirty = calloc(display->zone_count, sizeof(bool));
+    display->zone_monocle = calloc(display->zone_count, sizeof(bool));
+    assert(display->zone_clients && display->zone_current_index);
+    assert(display->zone_stack && display->zone_stack_dirty && display->zone_monocle);
+
+    for (int i = 0; i < display->zone_count; i++) {
+        display->zone_current_index[i] = -1;
+        display->zone_monocle[i] = MONOCLE_DEFAULT;
+    }
+
+    /* Atoms are fixed numbers the fake server recognises */
+    Atom atom = FAKE_ATOM_BASE;
+    display->command_atom = atom++;
+    for (int i = 0; i < WM_ATOM_COUNT; i++) display->wm_atoms[i] = atom++;
+    for (int i = 0; i < NET_ATOM_COUNT; i++) display->net_atoms[i] = atom++;
+    display->utf8_string_atom = atom++;
+
+    /* Window types can also be named by rules, which intern them */
+    display->net_atoms[NET_WM_WINDOW_TYPE_DIALOG] = fake_intern_atom("_NET_WM_WINDOW_TYPE_DIALOG");
+    display->net_atoms[NET_WM_WINDOW_TYPE_UTILITY] = fake_intern_atom("_NET_WM_WINDOW_TYPE_UTILITY");
+    display->net_atoms[NET_WM_WINDOW_TYPE_SPLASH] = fake_intern_atom("_NET_WM_WINDOW_TYPE_SPLASH");
+    display->net_atoms[NET_WM_WINDOW_TYPE_TOOLBAR] = fake_intern_atom("_NET_WM_WINDOW_TYPE_TOOLBAR");
+    display->net_atoms[NET_WM_WINDOW_TYPE_DOCK] = fake_intern_atom("_NET_WM_WINDOW_TYPE_DOCK");
+
+    /* The roots listen for property changes as swm's do */
+    if (!fake_window(root)) {
+        fake_create_window(root);
+    }
+    fake_window(root)->event_mask = SubstructureRedirectMask | PropertyChangeMask;
+    return display;
+}
+
+void fake_display_manager_free(DisplayManager *display) {
+    for (int zone = 0; zone < display->zone_count; zone++) {
+        while (display->zone_clients[zone]) {
+            Client *client = display->zone_clients[zone];
+            remove_client_from_zone(display, zone, client);
+            free(client);
+        }
+    }
+    free_docks(display);
+    free(display->zones);
+    free(display->zone_clients);
+    free(display->zone_current_index);
+    free(display->zone_stack);
+    free(display->zone_stack_dirty);
+    free(display->zone_monocle);
+    free(display);
+}
+
+static int saved_stdout = -1;
+
+void silence_debug_output(bool silence) {
+    fflush(stdout);
+    if (silence && saved_stdout < 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        if (null_fd < 0) return;
+        saved_stdout = dup(STDOUT_FILENO);
+        dup2(null_fd, STDOUT_FILENO);
+        close(null_fd);
+    } else if (!silence && saved_stdout >= 0) {
+        dup2(saved_stdout, STDOUT_FILENO);
+        close(saved_stdout);
+        saved_stdout = -1;
+    }
+}
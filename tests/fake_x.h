@@ -0,0 +1,107 @@
+#ifndef FAKE_X_H
+#define FAKE_X_H
+
+#include <stdbool.h>
+#include <X11/Xlib.h>
+#include "core.h"
+#include "xops.h"
+
+/* In-memory fake X server for running wm.c headless
+ *
+ * Keeps just enough server state to check what the handlers did (window
+ * geometry, borders, mapping, stacking order, focus, properties) and counts
+ * every request and round trip the handlers cost. */
+
+enum {
+    FAKE_MOVE_RESIZE,
+    FAKE_SET_BORDER,
+    FAKE_SET_FOCUS,
+    FAKE_RESTACK,
+    FAKE_MAP,
+    FAKE_UNMAP,
+    FAKE_SELECT_INPUT,
+    FAKE_KILL_CLIENT,
+    FAKE_SEND_MESSAGE,
+    FAKE_CHANGE_PROPERTY,
+    FAKE_GRAB_KEY,
+    FAKE_UNGRAB_KEYS,
+    FAKE_NO_OPERATION,
+    FAKE_WINDOW_EXISTS,
+    FAKE_GET_SIZE,
+    FAKE_GET_PROPERTY,
+    FAKE_INTERN_ATOM,
+    FAKE_GET_MODIFIERS,
+    FAKE_OP_COUNT
+};
+
+typedef struct {
+    Atom atom;
+    Atom type;
+    int format;                  /* 32: items, 8: text */
+    int count;
+    long *items;
+    char *text;
+} FakeProperty;
+
+typedef struct {
+    Window window;
+    bool exists;
+    bool mapped;
+    bool killed;
+    int x, y, width, height;
+    unsigned long border_color;
+    int border_width;
+    long event_mask;
+    int delete_requests;         /* WM_DELETE_WINDOW messages received */
+    unsigned long map_serial;    /* Request count when last mapped / unmapped */
+    unsigned long unmap_serial;
+    FakeProperty *properties;
+    int property_count;
+} FakeWindow;
+
+typedef struct {
+    unsigned long requests;      /* X protocol requests, as Xlib would send them */
+    unsigned long round_trips;   /* Calls that block on a reply */
+    unsigned long ops[FAKE_OP_COUNT];
+} FakeStats;
+
+extern const XOps fake_x_ops;
+extern FakeStats fake_stats;
+
+/* Server state */
+void fake_x_reset(void);
+void fake_stats_reset(void);
+FakeWindow *fake_create_window(Window window);
+FakeWindow *fake_window(Window window);
+void fake_destroy_window(Window window);
+void fake_set_property32(Window window, Atom property, Atom type, const long *items, int count);
+void fake_append_property32(Window window, Atom property, Atom type, const long *items, int count);
+void fake_set_text_property(Window window, Atom property, Atom type, const char *text, int length);
+FakeProperty *fake_get_property(Window window, Atom property);
+int fake_stacking_order(Window *windows, int max_windows);
+Window fake_focus(void);
+Atom fake_intern_atom(const char *name);
+
+/* Keyboard: every keysym has a key, NumLock is Mod2 */
+KeyCode fake_keycode(KeySym keysym);
+bool fake_key_grabbed(int keycode, unsigned int modifiers);
+int fake_grab_count(void);
+
+/* Events the server generated in response to requests, oldest first */
+bool fake_next_event(XEvent *event);
+
+/* Pointer tracking. Once the pointer is placed, any request or pointer move
+ * that changes the window under it queues an EnterNotify carrying the serial
+ * of the last request processed, as the real server does. */
+void fake_warp_pointer(int x, int y);
+
+/* A display manager wired to the fake server, with its root window created */
+DisplayManager *fake_display_manager(LogicalZone *zones, int zone_count);
+/* The same for another X screen with its own root */
+DisplayManager *fake_screen_manager(int screen, Window root, LogicalZone *zones, int zone_count);
+void fake_display_manager_free(DisplayManager *display);
+
+/* Send swm's [DEBUG] output to /dev/null around timed sections */
+void silence_debug_output(bool silence);
+
+#endif /* FAKE_X_H */
@@ -0,0 +1,328 @@
+#define _DEFAULT_SOURCE  /* For clock_gettime */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <time.h>
+#include <unistd.h>
+#include <X11/Xlib.h>
+#include "config.h"
+#include <X11/Xatom.h>
+#include "core.h"
+#include "record.h"
+#include "span.h"
+#include "wm.h"
+#include "fake_x.h"
+
+/* Headless replay of swm event traces
+ *
+ * Feeds a trace recorded with SWM_TRACE through swm's real event handlers
+ * against the fake server in fake_x.c, then reports the resulting layout,
+ * per-event timing and the X requests and round trips it would have cost,
+ * failing if any handler went over its declared round trip budget.
+ * It can also generate a deterministic synthetic trace, which `make test`
+ * replays against a latency budget as a perf regression check. */
+
+static const char *record_type_names[RECORD_TYPE_COUNT] = {
+    [RECORD_MAP]      = "map",
+    [RECORD_UNMAP]    = "unmap",
+    [RECORD_ENTER]    = "enter",
+    [RECORD_COMMAND]  = "command",
+    [RECORD_ACTIVATE] = "activate",
+    [RECORD_CLOSE]    = "close",
+    [RECORD_DESTROY]  = "destroy",
+};
+
+typedef struct {
+    unsigned long count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+} TypeTiming;
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/* Turn one trace record back into the XEvent swm saw and dispatch it. The
+ * fake server is updated first so handlers see the same world swm did. */
+void replay_event(DisplayManager *display, const RecordEvent *event) {
+    Window window = (Window)event->window;
+    XEvent xevent = {0};
+
+    switch (event->type) {
+        case RECORD_MAP:
+            if (find_client_by_window(display, window)) return;
+            fake_create_window(window);
+            xevent.xmaprequest.type = MapRequest;
+            xevent.xmaprequest.window = window;
+            break;
+        case RECORD_UNMAP:
+            /* Trace clients destroy their windows once unmapped */
+            fake_destroy_window(window);
+            xevent.xunmap.type = UnmapNotify;
+            xevent.xunmap.window = window;
+            break;
+        case RECORD_DESTROY:
+            fake_destroy_window(window);
+            xevent.xdestroywindow.type = DestroyNotify;
+            xevent.xdestroywindow.window = window;
+            break;
+        case RECORD_ENTER:
+            xevent.xcrossing.type = EnterNotify;
+            xevent.xcrossing.window = window;
+            break;
+        case RECORD_COMMAND: {
+            long items[3] = {event->arg, (long)event->window, event->arg2};
+            fake_set_property32(display->root, display->command_atom, XA_INTEGER, items, 3);
+            xevent.xproperty.type = PropertyNotify;
+            xevent.xproperty.window = display->root;
+            xevent.xproperty.atom = display->command_atom;
+            break;
+        }
+        case RECORD_ACTIVATE:
+        case RECORD_CLOSE:
+            xevent.xclient.type = ClientMessage;
+            xevent.xclient.window = window;
+            xevent.xclient.message_type = display->net_atoms[event->type == RECORD_ACTIVATE ?
+                                                             NET_ACTIVE_WINDOW : NET_CLOSE_WINDOW];
+            xevent.xclient.format = 32;
+            break;
+    }
+
+    dispatch_event(&xevent);
+    commit_batch();
+
+    /* Events swm's own requests caused, such as monocle unmaps */
+    while (fake_next_event(&xevent)) {
+        dispatch_event(&xevent);
+    }
+    commit_batch();
+}
+
+void print_state(DisplayManager *display) {
+    printf("Final state: %d managed clients, active zone %d\n",
+           count_managed_clients(display), display->active_zone);
+    for (int zone = 0; zone < display->zone_count; zone++) {
+        Client *current = get_current_client_in_zone(display, zone);
+        printf("  zone %d (%dx%d+%d+%d): %d clients, current 0x%lx\n", zone,
+               display->zones[zone].geometry.width, display->zones[zone].geometry.height,
+               display->zones[zone].geometry.x, display->zones[zone].geometry.y,
+               count_clients_in_zone(display, zone), current ? current->window : 0UL);
+    }
+}
+
+int replay_trace(const char *path, bool quiet, double budget_ns, const char *span_path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        return 1;
+    }
+
+    LogicalZone *zones = NULL;
+    int zone_count = record_read_header(file, &zones);
+    if (zone_count < 0) {
+        fprintf(stderr, "%s: not an swm trace\n", path);
+        fclose(file);
+        return 1;
+    }
+
+    fake_x_reset();
+    if (span_path && span_open(SPAN_BUFFER_SIZE)) {
+        wm_init(span_wrap_ops(&fake_x_ops));
+    } else {
+        wm_init(&fake_x_ops);
+    }
+    DisplayManager *display = fake_display_manager(zones, zone_count);
+    wm.displays = display;
+    wm.active_display = display;
+    wm.display_count = 1;
+    TypeTiming timing[RECORD_TYPE_COUNT] = {{0}};
+    unsigned long total_events = 0;
+    uint64_t total_ns = 0;
+    uint64_t trace_us = 0;
+    unsigned long start_tick = wm.timers.current_tick;
+
+    silence_debug_output(true);
+    RecordEvent event;
+    while (wm.running && record_read_event(file, &event)) {
+        if (event.type == 0 || event.type >= RECORD_TYPE_COUNT) continue;
+        trace_us += event.delta_us;
+
+        uint64_t start = monotonic_ns();
+        /* Timers due by now in trace time, such as the focus dwell and kill
+         * deadlines, fire before the event as they did in swm */
+        if (timer_wheel_advance(&wm.timers, start_tick + trace_us / (TIMER_TICK_MS * 1000))) {
+            commit_batch();
+        }
+        replay_event(display, &event);
+        uint64_t elapsed = monotonic_ns() - start;
+
+        TypeTiming *t = &timing[event.type];
+        t->count++;
+        t->total_ns += elapsed;
+        if (elapsed > t->max_ns) t->max_ns = elapsed;
+        total_events++;
+        total_ns += elapsed;
+    }
+    silence_debug_output(false);
+    fclose(file);
+
+    double mean_ns = total_events ? (double)total_ns / total_events : 0.0;
+
+    if (!quiet) {
+        print_state(display);
+    }
+    printf("Replayed %lu events (%.3fs of recorded time) in %.3fms, mean %.0fns/event\n",
+           total_events, trace_us / 1e6, total_ns / 1e6, mean_ns);
+    for (int type = 1; type < RECORD_TYPE_COUNT; type++) {
+        if (!timing[type].count) continue;
+        printf("  %-8s %9lu events  mean %7.0fns  max %9lluns\n", record_type_names[type],
+               timing[type].count, (double)timing[type].total_ns / timing[type].count,
+               (unsigned long long)timing[type].max_ns);
+    }
+    if (total_events) {
+        printf("X traffic: %lu requests (%.2f/event), %lu round trips (%.2f/event)\n",
+               fake_stats.requests, (double)fake_stats.requests / total_events,
+               fake_stats.round_trips, (double)fake_stats.round_trips / total_events);
+    }
+
+    if (!quiet) {
+        print_handler_stats(stdout);
+    }
+    int violations = check_handler_budgets(stderr);
+
+    if (span_is_active()) {
+        if (span_dump(span_path)) {
+            printf("Wrote event spans to %s\n", span_path);
+        }
+        span_close();
+    }
+
+    fake_display_manager_free(display);
+    wm_cleanup();
+
+    if (budget_ns > 0 && mean_ns > budget_ns) {
+        fprintf(stderr, "FAIL: mean %.0fns/event exceeds budget of %.0fns\n", mean_ns, budget_ns);
+        return 1;
+    }
+    if (violations) {
+        fprintf(stderr, "FAIL: %d handler budgets exceeded\n", violations);
+        return 1;
+    }
+    return 0;
+}
+
+/* Deterministic synthetic workload: a mix of maps, unmaps, pointer crossings
+ * and commands over a bounded window population on a mixed monitor layout */
+int generate_trace(const char *path, unsigned long count) {
+    XineramaScreenInfo monitors[] = {
+        {0, 0, 0, 1920, 1080},
+        {1, 1920, 0, 5120, 1440}
+    };
+    LogicalZone *zones = NULL;
+    int zone_count = calculate_zones(monitors, 2, &zones);
+
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        perror(path);
+        free(zones);
+        return 1;
+    }
+    record_write_header(file, zones, zone_count);
+    free(zones);
+
+    enum { MAX_LIVE = 64 };
+    Window live[MAX_LIVE];
+    int live_count = 0;
+    Window next_window = 0x200000;
+    uint32_t seed = 12345;
+
+    static const int commands[] = {
+        CMD_CYCLE_WINDOW_NEXT, CMD_CYCLE_WINDOW_PREV,
+        CMD_CYCLE_MONITOR_LEFT, CMD_CYCLE_MONITOR_RIGHT,
+        CMD_MOVE_WINDOW_LEFT, CMD_MOVE_WINDOW_RIGHT,
+        CMD_TOGGLE_MONOCLE
+    };
+
+    for (unsigned long i = 0; i < count; i++) {
+        seed = seed * 1103515245 + 12345;
+        int roll = (seed >> 16) % 100;
+        int pick = (seed >> 8) % MAX_LIVE;
+        RecordEvent event = {.delta_us = 1000 + (seed % 50000)};
+
+        if (live_count == 0 || (roll < 25 && live_count < MAX_LIVE)) {
+            event.type = RECORD_MAP;
+            event.window = next_window++;
+            live[live_count++] = event.window;
+        } else if (roll < 40) {
+            int index = pick % live_count;
+            event.type = RECORD_UNMAP;
+            event.window = live[index];
+            live[index] = live[--live_count];
+        } else if (roll < 65) {
+            event.type = RECORD_ENTER;
+            event.window = live[pick % live_count];
+        } else {
+            event.type = RECORD_COMMAND;
+            event.arg = commands[pick % (sizeof(commands) / sizeof(commands[0]))];
+        }
+
+        record_write_event(file, &event);
+    }
+
+    fclose(file);
+    printf("Generated %lu-event synthetic trace in %s\n", count, path);
+    return 0;
+}
+
+void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [-q] [-b budget_ns] [-p spans.json] <trace>\n", name);
+    fprintf(stderr, "       %s -s count <trace>\n", name);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "  -q            Only print timing, not the final layout\n");
+    fprintf(stderr, "  -b budget_ns  Fail if the mean time per event exceeds the budget\n");
+    fprintf(stderr, "  -p spans.json Write the last handler spans as Chrome trace JSON\n");
+    fprintf(stderr, "  -s count      Write a deterministic synthetic trace instead of replaying\n");
+}
+
+int main(int argc, char *argv[]) {
+    bool quiet = false;
+    double budget_ns = 0;
+    unsigned long synthetic = 0;
+    const char *span_path = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "qb:s:p:")) != -1) {
+        switch (opt) {
+            case 'q':
+                quiet = true;
+                break;
+            case 'b':
+                budget_ns = atof(optarg);
+                break;
+            case 's':
+                synthetic = strtoul(optarg, NULL, 10);
+                break;
+            case 'p':
+                span_path = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (synthetic) {
+        return generate_trace(argv[optind], synthetic);
+    }
+    return replay_trace(argv[optind], quiet, budget_ns, span_path);
+}
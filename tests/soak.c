@@ -0,0 +1,568 @@
+#define _DEFAULT_SOURCE  /* For clock_gettime and sysconf */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include <X11/Xlib.h>
+#include "config.h"
+#include <X11/Xatom.h>
+#include "core.h"
+#include "wm.h"
+#include "fake_x.h"
+
+/* Client churn soak test
+ *
+ * Drives millions of maps, unmaps, destroys, closes, kills, moves and
+ * cycles through swm's real event handlers against the fake server in
+ * fake_x.c, the way a long session would. Windows come from a bounded pool
+ * of ids, so a correct window manager runs in bounded memory and time.
+ *
+ * A model of which windows should be managed is kept alongside and checked
+ * against swm's client and dock lists at every sample, along with heap in
+ * use, RSS and the mean time per operation. The run fails on the first
+ * stale or missing entry, or if memory or latency keeps growing once warmed
+ * up. */
+
+#define POOL_SIZE 256             /* Window ids in circulation */
+#define POOL_BASE 0x400000
+#define MAX_LIVE 64               /* Windows open at once, a busy session */
+#define HEAP_SLACK (32 * 1024)    /* Bytes the heap may trend up by after warm-up */
+#define RSS_SLACK (1024 * 1024)   /* Bytes RSS may peak above its post-warm-up peak */
+#define LATENCY_GROWTH 3.0        /* Latest mean over first mean */
+#define LATENCY_FLOOR_NS 2000     /* Growth below this is noise */
+
+enum {
+    OP_MAP,
+    OP_WITHDRAW,
+    OP_DESTROY,
+    OP_CLOSE,
+    OP_RESPOND,
+    OP_STILLBORN,
+    OP_MOVE,
+    OP_CYCLE,
+    OP_MONOCLE,
+    OP_REMAP,
+    OP_ENTER,
+    OP_SPLIT,
+    OP_FOCUS_ZONE,
+    OP_COUNT
+};
+
+static const char *op_names[OP_COUNT] = {
+    [OP_MAP]        = "map",
+    [OP_WITHDRAW]   = "withdraw",
+    [OP_DESTROY]    = "destroy",
+    [OP_CLOSE]      = "close",
+    [OP_RESPOND]    = "respond",
+    [OP_STILLBORN]  = "stillborn",
+    [OP_MOVE]       = "move",
+    [OP_CYCLE]      = "cycle",
+    [OP_MONOCLE]    = "monocle",
+    [OP_REMAP]      = "remap",
+    [OP_ENTER]      = "enter",
+    [OP_SPLIT]      = "split",
+    [OP_FOCUS_ZONE] = "focus zone",
+};
+
+/* Cumulative share of each operation, out of 100 */
+static const int op_weights[OP_COUNT] = {
+    [OP_MAP]        = 20,
+    [OP_WITHDRAW]   = 29,
+    [OP_DESTROY]    = 36,
+    [OP_CLOSE]      = 43,
+    [OP_RESPOND]    = 48,
+    [OP_STILLBORN]  = 50,
+    [OP_MOVE]       = 58,
+    [OP_CYCLE]      = 70,
+    [OP_MONOCLE]    = 72,
+    [OP_REMAP]      = 77,
+    [OP_ENTER]      = 90,
+    [OP_SPLIT]      = 92,
+    [OP_FOCUS_ZONE] = 100,
+};
+
+enum { SLOT_FREE, SLOT_CLIENT, SLOT_DOCK };
+
+static int slots[POOL_SIZE];
+static int model_clients = 0;
+static int model_docks = 0;
+static uint32_t rng_state;
+
+typedef struct {
+    unsigned long ops;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    long rss_kb;
+    long heap_kb;                 /* -1 without mallinfo2() */
+    int clients;
+    int docks;
+} Sample;
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/* xorshift32: cheap, and the same run for the same seed */
+static uint32_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static long rss_kb(void) {
+    FILE *file = fopen("/proc/self/statm", "r");
+    if (!file) return -1;
+    long size, resident;
+    int fields = fscanf(file, "%ld %ld", &size, &resident);
+    fclose(file);
+    return fields == 2 ? resident * (sysconf(_SC_PAGESIZE) / 1024) : -1;
+}
+
+static long heap_kb(void) {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    return (long)(mallinfo2().uordblks / 1024);
+#else
+    return -1;
+#endif
+}
+
+static Window slot_window(int slot) {
+    return POOL_BASE + slot;
+}
+
+/* What the server sends */
+
+static void deliver_unmap(Window window, bool synthetic) {
+    XEvent event = {0};
+    event.xunmap.type = UnmapNotify;
+    event.xunmap.window = window;
+    event.xunmap.send_event = synthetic;
+    dispatch_event(&event);
+}
+
+static void deliver_destroy(Window window) {
+    XEvent event = {0};
+    event.xdestroywindow.type = DestroyNotify;
+    event.xdestroywindow.window = window;
+    dispatch_event(&event);
+}
+
+static void deliver_map_request(Window window) {
+    XEvent event = {0};
+    event.xmaprequest.type = MapRequest;
+    event.xmaprequest.window = window;
+    dispatch_event(&event);
+}
+
+static void deliver_command(DisplayManager *display, long command, long argument, long argument2,
+                            int argument_count) {
+    long items[3] = {command, argument, argument2};
+    fake_set_property32(display->root, display->command_atom, XA_INTEGER, items, 1 + argument_count);
+    XEvent event = {0};
+    event.xproperty.type = PropertyNotify;
+    event.xproperty.window = display->root;
+    event.xproperty.atom = display->command_atom;
+    dispatch_event(&event);
+}
+
+/* A mapped window being destroyed is unmapped first */
+static void destroy_slot(int slot) {
+    Window window = slot_window(slot);
+    FakeWindow *fake = fake_window(window);
+    if (fake && fake->exists) {
+        bool mapped = fake->mapped;
+        fake_destroy_window(window);
+        if (mapped) deliver_unmap(window, false);
+    }
+    deliver_destroy(window);
+
+    if (slots[slot] == SLOT_CLIENT) model_clients--;
+    if (slots[slot] == SLOT_DOCK) model_docks--;
+    slots[slot] = SLOT_FREE;
+}
+
+/* Windows swm killed are already gone from the server; only the
+ * DestroyNotify is left to deliver */
+static void reap_killed(void) {
+    for (int slot = 0; slot < POOL_SIZE; slot++) {
+        if (slots[slot] == SLOT_FREE) continue;
+        FakeWindow *fake = fake_window(slot_window(slot));
+        if (!fake->exists) {
+            destroy_slot(slot);
+        }
+    }
+}
+
+static void map_slot(DisplayManager *display, int slot) {
+    Window window = slot_window(slot);
+    fake_create_window(window);
+    uint32_t roll = next_random();
+
+    if (roll % 50 == 0) {
+        long dock = display->net_atoms[NET_WM_WINDOW_TYPE_DOCK];
+        fake_set_property32(window, display->net_atoms[NET_WM_WINDOW_TYPE], XA_ATOM, &dock, 1);
+        long strut[STRUT_VALUES] = {0, 0, 20 + (roll >> 8) % 20, 0, 0, 0, 0, 0, 0, 1919, 0, 0};
+        fake_set_property32(window, display->net_atoms[NET_WM_STRUT_PARTIAL], XA_CARDINAL,
+                            strut, STRUT_VALUES);
+        slots[slot] = SLOT_DOCK;
+        model_docks++;
+    } else {
+        /* Half the clients answer WM_DELETE_WINDOW, the rest get killed */
+        if (roll & 0x100) {
+            long protocol = display->wm_atoms[WM_DELETE_WINDOW];
+            fake_set_property32(window, display->wm_atoms[WM_PROTOCOLS], XA_ATOM, &protocol, 1);
+        }
+        slots[slot] = SLOT_CLIENT;
+        model_clients++;
+    }
+    deliver_map_request(window);
+}
+
+/* A random slot in the given state, or -1 */
+static int pick_slot(int state) {
+    int start = next_random() % POOL_SIZE;
+    for (int i = 0; i < POOL_SIZE; i++) {
+        int slot = (start + i) % POOL_SIZE;
+        if (slots[slot] == state) return slot;
+    }
+    return -1;
+}
+
+static int run_op(DisplayManager *display, int op) {
+    int slot;
+    switch (op) {
+        case OP_MAP:
+            if (model_clients + model_docks >= MAX_LIVE || (slot = pick_slot(SLOT_FREE)) < 0) {
+                return run_op(display, OP_WITHDRAW);
+            }
+            map_slot(display, slot);
+            break;
+        case OP_WITHDRAW: {
+            /* The client unmaps, then destroys its window. A window swm hid
+             * gets a synthetic UnmapNotify instead. */
+            if ((slot = pick_slot(SLOT_CLIENT)) < 0) return run_op(display, OP_MAP);
+            Window window = slot_window(slot);
+            FakeWindow *fake = fake_window(window);
+            bool mapped = fake->mapped;
+            fake->mapped = false;
+            deliver_unmap(window, !mapped);
+            destroy_slot(slot);
+            break;
+        }
+        case OP_DESTROY:
+            slot = pick_slot(next_random() % 4 ? SLOT_CLIENT : SLOT_DOCK);
+            if (slot < 0) return run_op(display, OP_MAP);
+            destroy_slot(slot);
+            break;
+        case OP_CLOSE:
+            deliver_command(display, CMD_KILL_WINDOW, 0, 0, 0);
+            break;
+        case OP_RESPOND:
+            /* Clients asked to close mostly do, eventually */
+            if ((slot = pick_slot(SLOT_CLIENT)) < 0) return run_op(display, OP_MAP);
+            if (fake_window(slot_window(slot))->delete_requests == 0) return run_op(display, OP_ENTER);
+            destroy_slot(slot);
+            break;
+        case OP_STILLBORN: {
+            /* Destroyed before swm got to its MapRequest */
+            if ((slot = pick_slot(SLOT_FREE)) < 0) return run_op(display, OP_DESTROY);
+            Window window = slot_window(slot);
+            fake_create_window(window);
+            fake_destroy_window(window);
+            deliver_map_request(window);
+            deliver_destroy(window);
+            break;
+        }
+        case OP_MOVE:
+            deliver_command(display, next_random() & 1 ? CMD_MOVE_WINDOW_LEFT : CMD_MOVE_WINDOW_RIGHT,
+                            0, 0, 0);
+            break;
+        case OP_CYCLE: {
+            static const int cycles[] = {
+                CMD_CYCLE_WINDOW_NEXT, CMD_CYCLE_WINDOW_PREV,
+                CMD_CYCLE_MONITOR_LEFT, CMD_CYCLE_MONITOR_RIGHT
+            };
+            deliver_command(display, cycles[next_random() % 4], 0, 0, 0);
+            break;
+        }
+        case OP_MONOCLE:
+            deliver_command(display, CMD_TOGGLE_MONOCLE, 0, 0, 0);
+            break;
+        case OP_REMAP:
+            if ((slot = pick_slot(next_random() % 16 ? SLOT_CLIENT : SLOT_DOCK)) < 0) {
+                return run_op(display, OP_MAP);
+            }
+            deliver_map_request(slot_window(slot));
+            break;
+        case OP_ENTER: {
+            if ((slot = pick_slot(SLOT_CLIENT)) < 0) return run_op(display, OP_MAP);
+            XEvent event = {0};
+            event.xcrossing.type = EnterNotify;
+            event.xcrossing.window = slot_window(slot);
+            dispatch_event(&event);
+            break;
+        }
+        case OP_SPLIT:
+            deliver_command(display, CMD_MOVE_SPLIT, -1, next_random() & 1 ? 64 : -64, 2);
+            break;
+        case OP_FOCUS_ZONE:
+            deliver_command(display, CMD_FOCUS_ZONE, next_random() % display->zone_count, 0, 1);
+            break;
+    }
+    return op;
+}
+
+/* One operation and everything it sets off, as the main loop would run it */
+static int soak_step(DisplayManager *display) {
+    unsigned long kills = fake_stats.ops[FAKE_KILL_CLIENT];
+    int roll = next_random() % 100;
+    int op = 0;
+    while (roll >= op_weights[op]) op++;
+
+    /* Time moves on, firing focus dwells, close deadlines and strut reads */
+    if (timer_wheel_advance(&wm.timers, wm.timers.current_tick + next_random() % 4)) {
+        commit_batch();
+    }
+    op = run_op(display, op);
+    commit_batch();
+
+    XEvent event;
+    while (fake_next_event(&event)) {
+        dispatch_event(&event);
+    }
+    if (fake_stats.ops[FAKE_KILL_CLIENT] != kills) {
+        reap_killed();
+    }
+    commit_batch();
+    return op;
+}
+
+/* Every window in the model is managed as what it is, and nothing else is */
+static bool check_model(DisplayManager *display) {
+    int docks = 0;
+    for (Dock *dock = display->docks; dock; dock = dock->next) {
+        docks++;
+    }
+    if (count_managed_clients(display) != model_clients || docks != model_docks) {
+        fprintf(stderr, "FAIL: swm manages %d clients and %d docks, expected %d and %d\n",
+                count_managed_clients(display), docks, model_clients, model_docks);
+        return false;
+    }
+    for (int slot = 0; slot < POOL_SIZE; slot++) {
+        Window window = slot_window(slot);
+        bool client = find_client_by_window(display, window) != NULL;
+        bool dock = find_dock(display, window) != NULL;
+        if (client != (slots[slot] == SLOT_CLIENT) || dock != (slots[slot] == SLOT_DOCK)) {
+            fprintf(stderr, "FAIL: window 0x%lx is %s, expected %s\n", window,
+                    client ? "a client" : dock ? "a dock" : "unmanaged",
+                    slots[slot] == SLOT_CLIENT ? "a client" :
+                    slots[slot] == SLOT_DOCK ? "a dock" : "unmanaged");
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Least-squares slope of heap in use over samples [first, count), in KB
+ * per sample */
+static double heap_slope(const Sample *samples, int first, int count) {
+    double n = count - first, sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0;
+    for (int i = first; i < count; i++) {
+        sum_x += i;
+        sum_y += samples[i].heap_kb;
+        sum_xx += (double)i * i;
+        sum_xy += (double)i * samples[i].heap_kb;
+    }
+    double spread = n * sum_xx - sum_x * sum_x;
+    return spread > 0 ? (n * sum_xy - sum_x * sum_y) / spread : 0.0;
+}
+
+/* The first half of the run is warm-up: malloc's caches of free chunks
+ * count as in use and take a few million calls to fill, and the pool has
+ * to reach its working mix. A leak or a list that keeps growing shows up
+ * as a trend in the second half, whatever the live window count happened
+ * to be at each sample; a filling cache has levelled off by then. */
+static int check_growth(const Sample *samples, int count) {
+    int warmup = count / 2;
+    int middle = warmup + (count - warmup) / 2;
+    int quarter = (count - warmup) / 4 > 0 ? (count - warmup) / 4 : 1;
+    long early_rss = 0, late_rss = 0;
+    uint64_t early_ns = 0, late_ns = 0;
+    unsigned long early_ops = 0, late_ops = 0;
+    int failures = 0;
+
+    for (int i = warmup; i < count; i++) {
+        long *rss = i < middle ? &early_rss : &late_rss;
+        if (samples[i].rss_kb > *rss) *rss = samples[i].rss_kb;
+        if (i < warmup + quarter) {
+            early_ns += samples[i].total_ns;
+            early_ops += samples[i].ops;
+        } else if (i >= count - quarter) {
+            late_ns += samples[i].total_ns;
+            late_ops += samples[i].ops;
+        }
+    }
+
+    /* The fitted trend across the second half, so single noisy samples
+     * neither hide nor fake growth */
+    double heap_growth = heap_slope(samples, warmup, count) * (count - 1 - warmup);
+    if (samples[0].heap_kb >= 0 && heap_growth > HEAP_SLACK / 1024) {
+        fprintf(stderr, "FAIL: heap in use grew by %.0fKB over the second half of the run\n",
+                heap_growth);
+        failures++;
+    }
+    if (samples[0].rss_kb >= 0 && late_rss > early_rss + RSS_SLACK / 1024) {
+        fprintf(stderr, "FAIL: RSS grew from %ldKB to %ldKB\n", early_rss, late_rss);
+        failures++;
+    }
+    double early_mean = early_ops ? (double)early_ns / early_ops : 0.0;
+    double late_mean = late_ops ? (double)late_ns / late_ops : 0.0;
+    if (late_mean > early_mean * LATENCY_GROWTH && late_mean - early_mean > LATENCY_FLOOR_NS) {
+        fprintf(stderr, "FAIL: mean time per operation grew from %.0fns to %.0fns\n",
+                early_mean, late_mean);
+        failures++;
+    }
+    return failures;
+}
+
+int soak(unsigned long total_ops, int sample_count, uint32_t seed) {
+    XineramaScreenInfo monitors[] = {
+        {0, 0, 0, 1920, 1080},
+        {1, 1920, 0, 5120, 1440}
+    };
+    LogicalZone *zones = NULL;
+    int zone_count = calculate_zones(monitors, 2, &zones);
+
+    fake_x_reset();
+    wm_init(&fake_x_ops);
+    DisplayManager *display = fake_display_manager(zones, zone_count);
+    wm.displays = display;
+    wm.active_display = display;
+    wm.display_count = 1;
+    fake_warp_pointer(960, 540);
+
+    memset(slots, 0, sizeof(slots));
+    model_clients = 0;
+    model_docks = 0;
+    rng_state = seed ? seed : 1;
+
+    Sample *samples = calloc(sample_count, sizeof(Sample));
+    if (!samples) {
+        perror("calloc");
+        return 1;
+    }
+    unsigned long op_counts[OP_COUNT] = {0};
+    unsigned long interval = total_ops / sample_count;
+    bool model_ok = true;
+
+    printf("Soaking %lu operations over %d windows, seed %u\n", total_ops, POOL_SIZE, seed);
+    printf("%8s %12s %9s %11s %9s %9s %8s %6s\n",
+           "sample", "ops", "mean ns", "max ns", "rss KB", "heap KB", "clients", "docks");
+
+    silence_debug_output(true);
+    int taken;
+    for (taken = 0; taken < sample_count && model_ok && wm.running; taken++) {
+        Sample *sample = &samples[taken];
+        for (unsigned long i = 0; i < interval; i++) {
+            uint64_t start = monotonic_ns();
+            int op = soak_step(display);
+            uint64_t elapsed = monotonic_ns() - start;
+            op_counts[op]++;
+            sample->ops++;
+            sample->total_ns += elapsed;
+            if (elapsed > sample->max_ns) sample->max_ns = elapsed;
+        }
+        model_ok = check_model(display);
+        sample->rss_kb = rss_kb();
+        sample->heap_kb = heap_kb();
+        sample->clients = count_managed_clients(display);
+        sample->docks = model_docks;
+
+        silence_debug_output(false);
+        printf("%8d %12lu %9.0f %11llu %9ld %9ld %8d %6d\n", taken + 1,
+               (taken + 1) * interval, (double)sample->total_ns / sample->ops,
+               (unsigned long long)sample->max_ns, sample->rss_kb, sample->heap_kb,
+               sample->clients, sample->docks);
+        fflush(stdout);
+        silence_debug_output(true);
+    }
+    silence_debug_output(false);
+
+    printf("Operations:");
+    for (int op = 0; op < OP_COUNT; op++) {
+        printf(" %s %lu%s", op_names[op], op_counts[op], op + 1 < OP_COUNT ? "," : "\n");
+    }
+    printf("X traffic: %lu requests, %lu round trips\n", fake_stats.requests, fake_stats.round_trips);
+    int violations = check_handler_budgets(stderr);
+
+    /* Tear down as swm does on exit, so leak checkers see a clean heap */
+    fake_display_manager_free(display);
+    wm_cleanup();
+
+    int failures = 0;
+    if (!model_ok) {
+        failures++;
+    } else if (!wm.running) {
+        fprintf(stderr, "FAIL: swm stopped running\n");
+        failures++;
+    } else {
+        failures += check_growth(samples, taken);
+    }
+    free(samples);
+
+    if (violations) {
+        fprintf(stderr, "FAIL: %d handler budgets exceeded\n", violations);
+        failures++;
+    }
+    if (failures == 0) {
+        printf("✓ Soak passed: memory and time per operation stayed flat\n");
+    }
+    return failures ? 1 : 0;
+}
+
+void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [-n operations] [-i samples] [-s seed]\n", name);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "  -n operations Operations to run (default 5000000)\n");
+    fprintf(stderr, "  -i samples    Times to sample memory and latency (default 20)\n");
+    fprintf(stderr, "  -s seed       Seed for the operation mix (default 1)\n");
+}
+
+int main(int argc, char *argv[]) {
+    unsigned long total_ops = 5000000;
+    int sample_count = 20;
+    uint32_t seed = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:i:s:")) != -1) {
+        switch (opt) {
+            case 'n':
+                total_ops = strtoul(optarg, NULL, 10);
+                break;
+            case 'i':
+                sample_count = atoi(optarg);
+                break;
+            case 's':
+                seed = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (optind != argc || sample_count < 4 || total_ops < (unsigned long)sample_count) {
+        usage(argv[0]);
+        return 1;
+    }
+    return soak(total_ops, sample_count, seed);
+}
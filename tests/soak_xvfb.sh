@@ -0,0 +1,169 @@
+#!/bin/bash
+
+# soak_xvfb.sh - Churn client windows through SWM on Xvfb and watch its memory
+# The shorter, real-server counterpart of tests/soak: rounds of test clients
+# are mapped, cycled, moved, killed and left to exit, and SWM's RSS is read
+# from /proc after each round. Fails if SWM dies, if it still manages windows
+# once every client is gone, or if its RSS keeps growing.
+
+set -e
+
+# Determine script directory and project root
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+PROJECT_ROOT="$(cd "$SCRIPT_DIR/.." && pwd)"
+
+# Configuration
+DISPLAY_NUM=97
+XVFB_DISPLAY=":$DISPLAY_NUM"
+XVFB_RESOLUTION="1920x1080"
+TEST_LOG="/tmp/swm_soak.log"
+ROUNDS="${SOAK_ROUNDS:-30}"       # Rounds of churn
+BATCH=8                           # Clients started per round
+RSS_SLACK_KB=512                  # RSS the last rounds may use over the first
+
+XVFB_PID=""
+SWM_PID=""
+
+# Colors for output
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+BLUE='\033[0;34m'
+NC='\033[0m' # No Color
+
+log() {
+    echo -e "${BLUE}[SOAK]${NC} $1"
+}
+
+success() {
+    echo -e "${GREEN}[SUCCESS]${NC} $1"
+}
+
+error() {
+    echo -e "${RED}[ERROR]${NC} $1"
+}
+
+warn() {
+    echo -e "${YELLOW}[WARN]${NC} $1"
+}
+
+cleanup() {
+    if [ -n "$SWM_PID" ] && kill -0 "$SWM_PID" 2>/dev/null; then
+        kill "$SWM_PID" 2>/dev/null || true
+    fi
+    pkill -f "$SCRIPT_DIR/test_client" 2>/dev/null || true
+    if [ -n "$XVFB_PID" ] && kill -0 "$XVFB_PID" 2>/dev/null; then
+        kill "$XVFB_PID" 2>/dev/null || true
+    fi
+}
+
+trap cleanup EXIT INT TERM
+
+swm_rss_kb() {
+    awk '/^VmRSS:/ { print $2 }' "/proc/$SWM_PID/status"
+}
+
+# Windows SWM still manages, as exported to status bars
+managed_windows() {
+    DISPLAY="$XVFB_DISPLAY" "$PROJECT_ROOT/swmc" status 2>/dev/null |
+        awk '$1 == "zone" && $4 == "clients" { total += $5 } END { print total + 0 }'
+}
+
+swmctl() {
+    DISPLAY="$XVFB_DISPLAY" "$PROJECT_ROOT/swmctl" "$@" >/dev/null 2>&1 || true
+}
+
+start_environment() {
+    if xdpyinfo -display "$XVFB_DISPLAY" >/dev/null 2>&1; then
+        error "Display $XVFB_DISPLAY is already in use"
+        return 1
+    fi
+
+    Xvfb "$XVFB_DISPLAY" -screen 0 "${XVFB_RESOLUTION}x24" -ac +extension GLX +render +xinerama -noreset > "$TEST_LOG" 2>&1 &
+    XVFB_PID=$!
+    for i in {1..10}; do
+        xdpyinfo -display "$XVFB_DISPLAY" >/dev/null 2>&1 && break
+        sleep 0.5
+    done
+
+    # The debug output of a long churn is large; only keep the errors
+    DISPLAY="$XVFB_DISPLAY" "$PROJECT_ROOT/swm" > /dev/null 2> "$TEST_LOG.swm" &
+    SWM_PID=$!
+    sleep 1
+    if ! kill -0 "$SWM_PID" 2>/dev/null; then
+        error "Failed to start SWM"
+        cat "$TEST_LOG.swm"
+        return 1
+    fi
+    success "SWM started (PID: $SWM_PID)"
+}
+
+# Start a batch of short-lived clients and work them over while they live
+churn_round() {
+    local pids=()
+    for ((i = 0; i < BATCH; i++)); do
+        DISPLAY="$XVFB_DISPLAY" "$SCRIPT_DIR/test_client" $((1 + i % 2)) >/dev/null 2>&1 &
+        pids+=($!)
+    done
+    sleep 0.3
+
+    swmctl cycle-window-next
+    swmctl move-window-right
+    swmctl toggle-monocle
+    swmctl cycle-window-prev
+    swmctl kill-window
+    swmctl toggle-monocle
+    swmctl cycle-monitor-right
+    swmctl kill-window
+
+    wait "${pids[@]}" 2>/dev/null || true
+}
+
+main() {
+    if ! command -v Xvfb >/dev/null 2>&1 || ! command -v xdpyinfo >/dev/null 2>&1; then
+        warn "Xvfb or xdpyinfo not found, skipping the Xvfb soak"
+        exit 0
+    fi
+
+    start_environment || exit 1
+
+    local samples=()
+    log "Churning $ROUNDS rounds of $BATCH clients..."
+    for ((round = 1; round <= ROUNDS; round++)); do
+        churn_round
+        if ! kill -0 "$SWM_PID" 2>/dev/null; then
+            error "SWM died in round $round"
+            cat "$TEST_LOG.swm"
+            exit 1
+        fi
+        sleep 0.2
+        samples+=("$(swm_rss_kb)")
+        log "Round $round: RSS ${samples[-1]}KB, $(managed_windows) windows managed"
+    done
+
+    # Every client has exited or been killed, so nothing may be left behind
+    local left
+    left=$(managed_windows)
+    if [ "$left" -ne 0 ]; then
+        error "SWM still manages $left windows after every client exited"
+        exit 1
+    fi
+
+    # Compare the peak of the last third with the first third, skipping the
+    # first round while allocations settle
+    local third=$((ROUNDS / 3)) early=0 late=0
+    for ((i = 1; i <= third; i++)); do
+        if [ "${samples[i]}" -gt "$early" ]; then early=${samples[i]}; fi
+    done
+    for ((i = ROUNDS - third; i < ROUNDS; i++)); do
+        if [ "${samples[i]}" -gt "$late" ]; then late=${samples[i]}; fi
+    done
+    if [ "$late" -gt $((early + RSS_SLACK_KB)) ]; then
+        error "SWM's RSS grew from ${early}KB to ${late}KB"
+        exit 1
+    fi
+
+    success "Soak passed: RSS ${early}KB early, ${late}KB late, no windows left behind"
+}
+
+main "$@"
@@ -1,8 +1,11 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include <stdbool.h>
 #include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/keysym.h>
 #include <X11/extensions/Xinerama.h>
 #include "config.h"
 #include "core.h"
@@ -19,12 +22,19 @@ DisplayManager *create_test_display_manager(int zone_count) {
     display->zone_count = zone_count;
     display->active_zone = 0;
     display->command_atom = 0;
+    display->wm_check_window = None;
+    display->ewmh_dirty = 0;
+    display->docks = NULL;
+    display->struts_dirty = false;
     display->next = NULL;
     
     /* Allocate zone-based client management arrays */
     display->zone_clients = calloc(zone_count, sizeof(Client*));
     display->zone_current_index = malloc(zone_count * sizeof(int));
+    display->zone_stack = calloc(zone_count, sizeof(Client*));
+    display->zone_stack_dirty = calloc(zone_count, sizeof(bool));
     assert(display->zone_clients != NULL && display->zone_current_index != NULL);
+    assert(display->zone_stack != NULL && display->zone_stack_dirty != NULL);
     
     /* Initialize all zones to have no clients */
     for (int i = 0; i < zone_count; i++) {
@@ -40,6 +50,9 @@ void cleanup_test_display_manager(DisplayManager *display) {
         if (display->zones) free(display->zones);
         if (display->zone_clients) free(display->zone_clients);
         if (display->zone_current_index) free(display->zone_current_index);
+        if (display->zone_stack) free(display->zone_stack);
+        if (display->zone_stack_dirty) free(display->zone_stack_dirty);
+        free_docks(display);
         free(display);
     }
 }
@@ -360,6 +373,635 @@ void test_window_movement_logic(void) {
     printf("✓ Window movement logic test passed\n");
 }
 
+void test_ewmh_state(void) {
+    printf("Testing EWMH state collection and dirty coalescing...\n");
+    
+    DisplayManager *display = create_test_display_manager(3);
+    
+    /* A burst of 100 maps marks the client list dirty 100 times... */
+    Client clients[100];
+    for (int i = 0; i < 100; i++) {
+        clients[i] = (Client){.window = 100 + i};
+        add_client_to_zone(display, i % 3, &clients[i]);
+        mark_ewmh_dirty(display, EWMH_DIRTY_CLIENT_LIST | EWMH_DIRTY_ACTIVE_WINDOW);
+    }
+    
+    /* ...but publishing takes it exactly once */
+    assert(take_ewmh_dirty(display) == (EWMH_DIRTY_CLIENT_LIST | EWMH_DIRTY_ACTIVE_WINDOW));
+    assert(take_ewmh_dirty(display) == 0);
+    
+    /* Client list covers every zone */
+    assert(count_managed_clients(display) == 100);
+    Window windows[100];
+    assert(collect_client_windows(display, windows, 100) == 100);
+    assert(collect_client_windows(display, windows, 10) == 10);
+    
+    /* Active window follows the active zone's current client */
+    assert(get_active_window(display) == clients[99].window);
+    display->active_zone = 1;
+    assert(get_active_window(display) == clients[97].window);
+    
+    /* Index lookup matches get_current_client_in_zone */
+    int index = find_client_index_in_zone(display, 1, &clients[1]);
+    assert(index == 32);
+    display->zone_current_index[1] = index;
+    assert(get_current_client_in_zone(display, 1) == &clients[1]);
+    assert(find_client_index_in_zone(display, 0, &clients[1]) == -1);
+    
+    /* Empty zone reports no active window */
+    DisplayManager *empty = create_test_display_manager(1);
+    assert(get_active_window(empty) == None);
+    cleanup_test_display_manager(empty);
+    
+    cleanup_test_display_manager(display);
+    printf("✓ EWMH state test passed\n");
+}
+
+void test_transaction_dedup(void) {
+    printf("Testing X request transaction deduplication...\n");
+    
+    Transaction txn;
+    txn_init(&txn);
+    assert(txn_is_empty(&txn));
+    
+    /* Repeated changes to one window collapse into one entry */
+    Rectangle first = {0, 0, 100, 100};
+    Rectangle last = {50, 0, 200, 100};
+    txn_set_border(&txn, 1, 0x111111);
+    txn_set_geometry(&txn, 1, first);
+    txn_set_border(&txn, 1, 0x222222);
+    txn_set_geometry(&txn, 1, last);
+    txn_set_border(&txn, 2, 0x333333);
+    assert(txn.count == 2);
+    
+    TxnEntry *entry = txn_find(&txn, 1);
+    assert(entry != NULL);
+    assert(entry->flags == (TXN_BORDER | TXN_GEOMETRY));
+    assert(entry->border_color == 0x222222);
+    assert(entry->geometry.x == 50 && entry->geometry.width == 200);
+    
+    /* Only the last focus request survives */
+    txn_focus(&txn, 1);
+    txn_focus(&txn, 2);
+    assert(txn.focus == 2);
+    
+    /* Dropping a window forgets its requests and any focus on it */
+    txn_drop_window(&txn, 2);
+    assert(txn.count == 1);
+    assert(txn_find(&txn, 2) == NULL);
+    assert(txn.focus == None);
+    
+    /* Client state and selections keep their last value; a kill replaces a
+     * close and outlives the window being dropped */
+    txn_set_state(&txn, 3, IconicState);
+    txn_set_state(&txn, 3, NormalState);
+    txn_select_input(&txn, 3, PropertyChangeMask);
+    txn_close(&txn, 3);
+    txn_kill(&txn, 3);
+    txn_close(&txn, 3);
+    entry = txn_find(&txn, 3);
+    assert(entry->flags == (TXN_STATE | TXN_INPUT | TXN_KILL));
+    assert(entry->state == NormalState && entry->event_mask == PropertyChangeMask);
+    txn_drop_window(&txn, 3);
+    assert(txn_find(&txn, 3)->flags == TXN_KILL);
+    txn_close(&txn, 4);
+    txn_drop_window(&txn, 4);
+    assert(txn_find(&txn, 4) == NULL);
+    
+    /* Entries grow past the initial capacity */
+    for (Window w = 10; w < 100; w++) {
+        txn_map(&txn, w);
+    }
+    assert(txn.count == 92);
+    assert(txn_find(&txn, 99)->flags == TXN_MAP);
+    
+    txn_reset(&txn);
+    assert(txn_is_empty(&txn));
+    txn_free(&txn);
+    
+    printf("✓ Transaction deduplication test passed\n");
+}
+
+void test_state_transitions(void) {
+    printf("Testing shared state transitions...\n");
+    
+    DisplayManager *display = create_test_display_manager(3);
+    
+    Client a = {.window = 1}, b = {.window = 2}, c = {.window = 3};
+    insert_new_client(display, &a, 0);
+    insert_new_client(display, &b, 0);
+    insert_new_client(display, &c, 0);
+    
+    /* Newest client is current and on top */
+    assert(get_current_client_in_zone(display, 0) == &c);
+    assert(stack_top(display, 0) == &c);
+    assert(!display->zone_stack_dirty[0]);
+    assert(find_client_by_window(display, 2) == &b);
+    assert(find_client_by_window(display, 42) == NULL);
+    
+    /* Stepping wraps in both directions */
+    assert(step_zone_current(display, 1) == &b);
+    assert(step_zone_current(display, 1) == &a);
+    assert(step_zone_current(display, 1) == &c);
+    assert(step_zone_current(display, -1) == &a);
+    
+    /* Zone stepping wraps too */
+    assert(step_active_zone(display, -1) == 2);
+    assert(step_active_zone(display, 1) == 0);
+    
+    /* Nothing to cycle in an empty zone */
+    display->active_zone = 1;
+    assert(step_zone_current(display, 1) == NULL);
+    
+    /* Pointer or EWMH activation jumps straight to a client */
+    make_client_current(display, &b);
+    assert(display->active_zone == 0);
+    assert(get_current_client_in_zone(display, 0) == &b);
+    
+    /* Moving lands the client on top of the target zone */
+    move_client_to_zone(display, &b, 2);
+    assert(b.zone_index == 2);
+    assert(count_clients_in_zone(display, 0) == 2);
+    assert(stack_top(display, 2) == &b);
+    assert(display->zone_stack_dirty[2]);
+    assert(find_client_index_in_zone(display, 0, &b) == -1);
+    
+    /* Swapping with the first client keeps the swapped client current */
+    Client d = {.window = 4};
+    insert_new_client(display, &d, 0);
+    make_client_current(display, &a);
+    assert(swap_with_first(display, &a) == &d);
+    assert(display->zone_clients[0] == &a && a.next == &c && c.next == &d);
+    assert(get_current_client_in_zone(display, 0) == &a);
+    
+    /* The first client swaps with the second, which is adjacent either way */
+    assert(swap_with_first(display, &a) == &c);
+    assert(display->zone_clients[0] == &c && c.next == &a && a.next == &d);
+    assert(get_current_client_in_zone(display, 0) == &a);
+    assert(swap_with_first(display, &a) == &c);
+    assert(display->zone_clients[0] == &a && a.next == &c);
+    assert(swap_with_first(display, &b) == NULL);
+    
+    cleanup_test_display_manager(display);
+    printf("✓ State transitions test passed\n");
+}
+
+void test_stacking_model(void) {
+    printf("Testing per-zone stacking model...\n");
+    
+    DisplayManager *display = create_test_display_manager(2);
+    
+    Client a = {.window = 1}, b = {.window = 2}, c = {.window = 3};
+    add_client_to_zone(display, 0, &a);
+    stack_push(display, 0, &a);
+    add_client_to_zone(display, 0, &b);
+    stack_push(display, 0, &b);
+    add_client_to_zone(display, 0, &c);
+    stack_push(display, 0, &c);
+    
+    Window order[3];
+    assert(collect_zone_stack(display, 0, order, 3) == 3);
+    assert(order[0] == 3 && order[1] == 2 && order[2] == 1);
+    assert(stack_top(display, 0) == &c);
+    
+    /* Raising the window already on top is a no-op and needs no restack */
+    assert(!stack_raise(display, 0, &c));
+    assert(!display->zone_stack_dirty[0]);
+    
+    /* Raising a buried window changes the visible order */
+    assert(stack_raise(display, 0, &a));
+    assert(display->zone_stack_dirty[0]);
+    collect_zone_stack(display, 0, order, 3);
+    assert(order[0] == 1 && order[1] == 3 && order[2] == 2);
+    
+    /* Cycling order is untouched by stacking */
+    assert(get_current_client_in_zone(display, 0) == &c);
+    
+    /* Removing a client drops it from both orders */
+    remove_client_from_zone(display, 0, &a);
+    assert(stack_top(display, 0) == &c);
+    assert(collect_zone_stack(display, 0, order, 3) == 2);
+    
+    /* Floating clients stay above the tiled ones they share a zone with */
+    Client f = {.window = 6, .floating = true};
+    add_client_to_zone(display, 0, &f);
+    stack_push(display, 0, &f);
+    display->zone_stack_dirty[0] = false;
+    assert(stack_raise(display, 0, &b));
+    assert(stack_top(display, 0) == &f);
+    assert(!stack_raise(display, 0, &b));
+    collect_zone_stack(display, 0, order, 3);
+    assert(order[0] == 6 && order[1] == 2 && order[2] == 3);
+    
+    /* Other zones are independent */
+    assert(stack_top(display, 1) == NULL);
+    assert(!display->zone_stack_dirty[1]);
+
+    /* A whole zone moves in front of the target's clients and floats stay on top */
+    Client g = {.window = 7};
+    add_client_to_zone(display, 1, &g);
+    stack_push(display, 1, &g);
+    Client *current = get_current_client_in_zone(display, 0);
+    assert(move_zone_clients(display, 0, 1) == 3);
+    assert(display->zone_clients[0] == NULL && stack_top(display, 0) == NULL);
+    assert(display->zone_clients[1] == &f && g.next == NULL);
+    assert(f.zone_index == 1 && b.zone_index == 1 && c.zone_index == 1);
+    assert(get_current_client_in_zone(display, 1) == current);
+    Window moved_order[4];
+    assert(collect_zone_stack(display, 1, moved_order, 4) == 4);
+    assert(moved_order[0] == 6 && moved_order[1] == 2 && moved_order[2] == 3 && moved_order[3] == 7);
+    assert(display->zone_stack_dirty[1]);
+    assert(move_zone_clients(display, 0, 1) == 0);
+    assert(move_zone_clients(display, 1, 1) == 0);
+
+    cleanup_test_display_manager(display);
+    printf("✓ Stacking model test passed\n");
+}
+
+static int timer_fired_count = 0;
+
+static void count_timer_callback(Timer *timer) {
+    (void)timer;
+    timer_fired_count++;
+}
+
+static void rescheduling_timer_callback(Timer *timer) {
+    timer_fired_count++;
+    timer_schedule(timer->data, timer, 5);
+}
+
+void test_timer_wheel(void) {
+    printf("Testing timer wheel...\n");
+    
+    TimerWheel wheel;
+    timer_wheel_init(&wheel, 1000);
+    
+    Timer short_timer, long_timer, cancelled_timer;
+    timer_init(&short_timer, count_timer_callback, NULL);
+    timer_init(&long_timer, count_timer_callback, NULL);
+    timer_init(&cancelled_timer, count_timer_callback, NULL);
+    
+    /* Long timer lands in the same slot as the short one, a revolution later */
+    timer_schedule(&wheel, &short_timer, 10);
+    timer_schedule(&wheel, &long_timer, 10 + TIMER_WHEEL_SLOTS);
+    timer_schedule(&wheel, &cancelled_timer, 20);
+    assert(wheel.active_count == 3);
+    
+    timer_cancel(&wheel, &cancelled_timer);
+    assert(!cancelled_timer.active);
+    assert(wheel.active_count == 2);
+    
+    /* Nothing is due yet */
+    timer_fired_count = 0;
+    assert(timer_wheel_advance(&wheel, 1009) == 0);
+    
+    /* Short timer fires, the long one stays queued in the same slot */
+    assert(timer_wheel_advance(&wheel, 1010) == 1);
+    assert(!short_timer.active);
+    assert(long_timer.active);
+    assert(wheel.active_count == 1);
+    
+    /* Cancelled timer never fires */
+    assert(timer_wheel_advance(&wheel, 1030) == 0);
+    
+    /* A stall longer than a revolution still fires overdue timers */
+    assert(timer_wheel_advance(&wheel, 1000 + 10 * TIMER_WHEEL_SLOTS) == 1);
+    assert(wheel.active_count == 0);
+    assert(timer_fired_count == 2);
+    
+    /* Rescheduling an active timer moves it instead of duplicating it */
+    timer_schedule(&wheel, &short_timer, 3);
+    timer_schedule(&wheel, &short_timer, 7);
+    assert(wheel.active_count == 1);
+    unsigned long base = wheel.current_tick;
+    assert(timer_wheel_advance(&wheel, base + 3) == 0);
+    assert(timer_wheel_advance(&wheel, base + 7) == 1);
+    
+    /* Callbacks may reschedule themselves */
+    Timer periodic;
+    timer_init(&periodic, rescheduling_timer_callback, &wheel);
+    timer_schedule(&wheel, &periodic, 5);
+    timer_fired_count = 0;
+    base = wheel.current_tick;
+    for (unsigned long tick = 1; tick <= 20; tick++) {
+        timer_wheel_advance(&wheel, base + tick);
+    }
+    assert(timer_fired_count == 4);
+    assert(periodic.active);
+    timer_cancel(&wheel, &periodic);
+    assert(wheel.active_count == 0);
+    
+    /* After an idle spell a new timer waits its full delay from now */
+    timer_fired_count = 0;
+    base = wheel.current_tick + 1000;
+    timer_wheel_sync(&wheel, base);
+    assert(wheel.current_tick == base);
+    timer_schedule(&wheel, &short_timer, 300);
+    assert(timer_wheel_advance(&wheel, base + 1) == 0);
+    assert(timer_wheel_advance(&wheel, base + 299) == 0);
+    assert(timer_wheel_advance(&wheel, base + 300) == 1);
+    
+    /* Pending timers keep the clock; syncing then would skip their slots */
+    timer_schedule(&wheel, &short_timer, 10);
+    timer_wheel_sync(&wheel, base + 1000);
+    assert(wheel.current_tick == base + 300);
+    assert(timer_wheel_advance(&wheel, base + 1000) == 1);
+    assert(timer_fired_count == 2 && wheel.active_count == 0);
+    
+    printf("✓ Timer wheel test passed\n");
+}
+
+void test_window_rules(void) {
+    printf("Testing window rule compilation and matching...\n");
+    
+    static const WindowRule rules[] = {
+        {"firefox", NULL,     NULL,     NULL,     1, false, true},
+        {NULL,      NULL,     "htop",   NULL,     2, false, true},
+        {"URxvt",   "scratch", NULL,    NULL,    -1, true,  true},
+        {"URxvt",   NULL,     NULL,     NULL,     0, false, false},
+        {NULL,      NULL,     NULL,     "dialog", -1, true, true},
+    };
+    RuleSet set;
+    rules_compile(&set, rules, 5);
+    set.type_atoms[4] = 77;  /* Resolved by the caller in swm */
+    assert(set.needs == (RULE_NEEDS_CLASS | RULE_NEEDS_TITLE | RULE_NEEDS_TYPE | RULE_NEEDS_SIZE));
+    
+    /* Class lookups, with instance refining a class */
+    WindowInfo info = {.class_name = "firefox", .instance = "Navigator"};
+    assert(rules_match(&set, &info) == &rules[0]);
+    info = (WindowInfo){.class_name = "URxvt", .instance = "scratch"};
+    assert(rules_match(&set, &info) == &rules[2]);
+    info = (WindowInfo){.class_name = "URxvt", .instance = "urxvt"};
+    assert(rules_match(&set, &info) == &rules[3]);
+    
+    /* Wildcard rules interleave with class rules in declaration order */
+    info = (WindowInfo){.class_name = "URxvt", .instance = "urxvt", .title = "htop - load"};
+    assert(rules_match(&set, &info) == &rules[1]);
+    info = (WindowInfo){.class_name = "Gimp", .types = {12, 77}, .type_count = 2};
+    assert(rules_match(&set, &info) == &rules[4]);
+    
+    /* No properties, no match */
+    info = (WindowInfo){0};
+    assert(rules_match(&set, &info) == NULL);
+    
+    rules_free(&set);
+    
+    /* An empty rule set needs nothing and matches nothing */
+    rules_compile(&set, NULL, 0);
+    assert(set.needs == 0);
+    info = (WindowInfo){.class_name = "firefox"};
+    assert(rules_match(&set, &info) == NULL);
+    rules_free(&set);
+    
+    printf("✓ Window rules test passed\n");
+}
+
+void test_serial_ranges(void) {
+    printf("Testing request serial ranges...\n");
+    
+    /* Ends are exclusive: the serial after a burst belongs to whatever
+     * request closed it */
+    SerialRanges ranges = {0};
+    serial_ranges_add(&ranges, 10, 15);
+    serial_ranges_add(&ranges, 20, 21);
+    
+    assert(!serial_ranges_contains(&ranges, 9));
+    assert(serial_ranges_contains(&ranges, 10));
+    assert(serial_ranges_contains(&ranges, 14));
+    assert(!serial_ranges_contains(&ranges, 15));
+    assert(ranges.count == 1);  /* An event past a range retires it */
+    assert(serial_ranges_contains(&ranges, 20));
+    assert(!serial_ranges_contains(&ranges, 21));
+    assert(ranges.count == 0);
+    
+    /* Overflowing the slots folds the oldest ranges together */
+    for (int i = 0; i < SERIAL_RANGE_SLOTS + 2; i++) {
+        serial_ranges_add(&ranges, 100 + i * 10, 100 + i * 10 + 2);
+    }
+    assert(ranges.count == SERIAL_RANGE_SLOTS);
+    assert(serial_ranges_contains(&ranges, 101));
+    assert(serial_ranges_contains(&ranges, 115));
+    assert(serial_ranges_contains(&ranges, 191));
+    
+    printf("✓ Serial ranges test passed\n");
+}
+
+void test_key_table(void) {
+    printf("Testing key binding lookup...\n");
+    
+    KeyBinding bindings[] = {
+        {Mod4Mask,             XK_j,   CMD_CYCLE_WINDOW_NEXT, 0},
+        {Mod4Mask | ShiftMask, XK_j,   CMD_MOVE_WINDOW_LEFT,  0},
+        {Mod4Mask,             XK_k,   CMD_CYCLE_WINDOW_PREV, 0},
+        {Mod4Mask,             XK_j,   CMD_QUIT,              0},  /* Shadowed by the first */
+        {Mod4Mask,             XK_F35, CMD_QUIT,              0},  /* No key for it */
+    };
+    KeyCode keycodes[] = {44, 44, 45, 44, 0};
+    unsigned int numlock = Mod2Mask;
+    
+    KeyTable table;
+    keys_compile(&table, bindings, keycodes, 5, LockMask | numlock);
+    
+    assert(keys_lookup(&table, 44, Mod4Mask)->command == CMD_CYCLE_WINDOW_NEXT);
+    assert(keys_lookup(&table, 44, Mod4Mask | ShiftMask)->command == CMD_MOVE_WINDOW_LEFT);
+    assert(keys_lookup(&table, 45, Mod4Mask)->command == CMD_CYCLE_WINDOW_PREV);
+    
+    /* CapsLock, NumLock and mouse buttons held don't matter */
+    assert(keys_lookup(&table, 44, Mod4Mask | LockMask)->command == CMD_CYCLE_WINDOW_NEXT);
+    assert(keys_lookup(&table, 44, Mod4Mask | numlock | LockMask)->command == CMD_CYCLE_WINDOW_NEXT);
+    assert(keys_lookup(&table, 45, Mod4Mask | Button1Mask)->command == CMD_CYCLE_WINDOW_PREV);
+    
+    /* Other modifiers do */
+    assert(keys_lookup(&table, 44, 0) == NULL);
+    assert(keys_lookup(&table, 44, Mod4Mask | ControlMask) == NULL);
+    assert(keys_lookup(&table, 45, Mod4Mask | ShiftMask) == NULL);
+    assert(keys_lookup(&table, 46, Mod4Mask) == NULL);
+    assert(keys_lookup(&table, 0, Mod4Mask) == NULL);
+    assert(keys_lookup(&table, 300, Mod4Mask) == NULL);
+    
+    keys_free(&table);
+    assert(keys_lookup(&table, 44, Mod4Mask) == NULL);
+    
+    printf("✓ Key binding lookup test passed\n");
+}
+
+void test_struts(void) {
+    printf("Testing dock struts...\n");
+    
+    XineramaScreenInfo monitors[] = {
+        {0, 0, 0, 1920, 1080},     /* Regular monitor */
+        {1, 1920, 0, 5120, 1440}   /* Ultrawide monitor, zones 1-3 */
+    };
+    DisplayManager *display = create_test_display_manager(4);
+    calculate_zones(monitors, 2, &display->zones);
+    assert(display->zones[1].area.x == 1920 && display->zones[1].area.width == 1280);
+    bool changed[4];
+    
+    /* No docks: nothing reserved */
+    assert(apply_struts(display, changed) == 0);
+    
+    /* A top bar along the first monitor only shrinks its zone */
+    Dock *top = calloc(1, sizeof(Dock));
+    top->window = 1;
+    top->strut[2] = 30;
+    top->strut[8] = 0;
+    top->strut[9] = 1919;
+    display->docks = top;
+    assert(apply_struts(display, changed) == 1);
+    assert(changed[0] && !changed[1] && !changed[2] && !changed[3]);
+    assert(display->zones[0].geometry.y == 30 && display->zones[0].geometry.height == 1050);
+    assert(display->zones[0].area.y == 0 && display->zones[0].area.height == 1080);
+    
+    /* Applying the same struts again changes nothing */
+    assert(apply_struts(display, changed) == 0);
+    
+    /* A bottom bar under the ultrawide's center zone, counted from the
+     * bottom of the taller monitor */
+    Dock *bottom = calloc(1, sizeof(Dock));
+    bottom->window = 2;
+    bottom->strut[3] = 40;
+    bottom->strut[10] = 1920 + 1280;
+    bottom->strut[11] = 1920 + 3839;
+    bottom->next = display->docks;
+    display->docks = bottom;
+    assert(apply_struts(display, changed) == 1);
+    assert(changed[2]);
+    assert(display->zones[2].geometry.height == 1400);
+    assert(display->zones[0].geometry.height == 1050);
+    assert(display->zones[1].geometry.height == 1440 && display->zones[3].geometry.height == 1440);
+    
+    /* The legacy strut reserves the whole edge, but a left strut narrower
+     * than the first monitor never reaches the ultrawide */
+    long legacy[4] = {100, 0, 0, 0};
+    strut_from_legacy(legacy, top->strut);
+    assert(apply_struts(display, changed) == 1);
+    assert(display->zones[0].geometry.x == 100 && display->zones[0].geometry.width == 1820);
+    assert(display->zones[0].geometry.y == 0);
+    assert(display->zones[1].geometry.x == 1920);
+    
+    /* Removing the docks gives the zones back */
+    assert(find_dock(display, 2) == bottom);
+    assert(remove_dock(display, 2));
+    assert(!remove_dock(display, 2));
+    assert(apply_struts(display, changed) == 1);
+    assert(display->zones[2].geometry.height == 1440);
+    free_docks(display);
+    assert(display->docks == NULL);
+    assert(apply_struts(display, changed) == 1);
+    assert(display->zones[0].geometry.x == 0 && display->zones[0].geometry.width == 1920);
+    
+    cleanup_test_display_manager(display);
+    printf("✓ Dock struts test passed\n");
+}
+
+void test_settings(void) {
+    printf("Testing settings parsing and zone resplitting...\n");
+    
+    Settings settings;
+    settings_defaults(&settings);
+    assert(settings.border_width == BORDER_WIDTH);
+    assert(settings.focus_dwell_ticks == (FOCUS_DWELL_MS + TIMER_TICK_MS - 1) / TIMER_TICK_MS);
+    
+    /* Values are resolved once: colors to pixels, times to ticks */
+    const char *text =
+        "# swmrc\n"
+        "border_width = 4\n"
+        "  focus_color=#ff8800  \n"
+        "unfocus_color = 0x101010\n"
+        "\n"
+        "focus_follows_mouse = off\n"
+        "focus_dwell_ms = 25\n"
+        "zone_left_ratio = 0.3\n"
+        "zone_center_ratio = 0.4\n"
+        "zone_right_ratio = 0.3";
+    FILE *err = tmpfile();
+    assert(err != NULL);
+    assert(settings_parse(&settings, text, "swmrc", err));
+    assert(settings.border_width == 4);
+    assert(settings.focus_color == 0xff8800 && settings.unfocus_color == 0x101010);
+    assert(!settings.focus_follows_mouse);
+    assert(settings.focus_dwell_ticks == (25 + TIMER_TICK_MS - 1) / TIMER_TICK_MS);
+    assert(settings.layout.left_ratio == 0.3 && settings.layout.center_ratio == 0.4);
+    assert(settings.kill_timeout_ticks == KILL_TIMEOUT_MS / TIMER_TICK_MS);
+    
+    /* A bad line rejects the whole text and names where it is */
+    Settings before = settings;
+    assert(!settings_parse(&settings, "border_width = 1\nfocus_color = blue\n", "swmrc", err));
+    assert(!settings_parse(&settings, "border_with = 1\n", "swmrc", err));
+    assert(!settings_parse(&settings, "border_width\n", "swmrc", err));
+    assert(!settings_parse(&settings, "zone_center_ratio = 0.6\n", "swmrc", err));
+    assert(memcmp(&before, &settings, sizeof(settings)) == 0);
+    char message[256];
+    rewind(err);
+    assert(fgets(message, sizeof(message), err));
+    assert(strcmp(message, "swmrc:2: focus_color: expected a color as #RRGGBB or 0xRRGGBB\n") == 0);
+    fclose(err);
+    
+    /* A missing file leaves the defaults */
+    assert(settings_load(&settings, "/nonexistent/swmrc", stderr));
+    assert(settings.border_width == BORDER_WIDTH);
+    
+    /* Resplitting moves only the zones whose share changed */
+    XineramaScreenInfo monitors[] = {
+        {0, 0, 0, 1920, 1080},
+        {1, 1920, 0, 5120, 1440}
+    };
+    DisplayManager *display = create_test_display_manager(4);
+    calculate_zones(monitors, 2, &display->zones);
+    ZoneLayout layout = {ULTRAWIDE_THRESHOLD, 0.30, 0.45, 0.25};
+    assert(resplit_zones(display, &layout) == 2);
+    assert(display->zones[1].area.width == 1536 && display->zones[2].area.x == 1920 + 1536);
+    assert(display->zones[3].area.x == 1920 + 3840 && display->zones[3].area.width == 1280);
+    assert(display->zones[0].area.width == 1920);
+    assert(resplit_zones(display, &layout) == 0);
+    
+    /* Usable areas follow once struts are applied again */
+    bool changed[4];
+    assert(apply_struts(display, changed) == 2 && changed[1] && changed[2]);
+    assert(display->zones[1].geometry.width == 1536);
+    
+    /* A layout that would change how many zones there are is refused */
+    layout.ultrawide_threshold = 6000;
+    assert(resplit_zones(display, &layout) == -1);
+    assert(display->zones[1].area.width == 1536);
+    
+    cleanup_test_display_manager(display);
+    printf("✓ Settings test passed\n");
+}
+
+void test_zone_splits(void) {
+    printf("Testing zone split moves...\n");
+    
+    XineramaScreenInfo monitors[] = {
+        {0, 0, 0, 5120, 1440},     /* Zones 0-2 */
+        {1, 5120, 0, 1920, 1080}   /* Zone 3 */
+    };
+    DisplayManager *display = create_test_display_manager(4);
+    calculate_zones(monitors, 2, &display->zones);
+    
+    /* The split moves within the monitor, taking from one neighbour only */
+    assert(set_zone_split(display, 0, 1600));
+    assert(display->zones[0].area.width == 1600);
+    assert(display->zones[1].area.x == 1600 && display->zones[1].area.width == 3840 - 1600);
+    assert(display->zones[2].area.x == 3840 && display->zones[2].area.width == 1280);
+    assert(!set_zone_split(display, 0, 1600));
+    
+    /* Neither side gets narrower than ZONE_MIN_WIDTH */
+    assert(set_zone_split(display, 1, 5120));
+    assert(display->zones[2].area.width == ZONE_MIN_WIDTH);
+    assert(display->zones[2].area.x + display->zones[2].area.width == 5120);
+    assert(set_zone_split(display, 0, -100));
+    assert(display->zones[0].area.width == ZONE_MIN_WIDTH);
+    
+    /* There is no split between monitors or after the last zone */
+    assert(!set_zone_split(display, 2, 100));
+    assert(!set_zone_split(display, 3, 100));
+    assert(display->zones[3].area.x == 5120);
+    
+    cleanup_test_display_manager(display);
+    printf("✓ Zone split test passed\n");
+}
+
 int main(void) {
     printf("Running SWM simplified approach tests...\n\n");
     
@@ -370,6 +1012,17 @@ int main(void) {
     test_zone_based_client_management();
     test_window_cycling_with_indices();
     test_window_movement_logic();
+    test_timer_wheel();
+    test_ewmh_state();
+    test_transaction_dedup();
+    test_stacking_model();
+    test_state_transitions();
+    test_window_rules();
+    test_serial_ranges();
+    test_key_table();
+    test_struts();
+    test_settings();
+    test_zone_splits();
     
     printf("\n✓ All tests passed! Simplified zone-based logic is working correctly.\n");
     return 0;
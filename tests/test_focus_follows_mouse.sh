@@ -381,6 +381,59 @@ test_focus_follows_mouse_multiple_zones() {
     return 0
 }
 
+test_no_focus_thrash_on_keyboard_cycle() {
+    log "Testing keyboard cycling with the pointer resting on the zone..."
+    
+    DISPLAY="$XVFB_DISPLAY" "$SCRIPT_DIR/test_client" 30 &
+    PID1=$!
+    sleep 1
+    DISPLAY="$XVFB_DISPLAY" "$SCRIPT_DIR/test_client" 30 &
+    PID2=$!
+    sleep 1
+    DISPLAY="$XVFB_DISPLAY" "$SCRIPT_DIR/test_client" 30 &
+    PID3=$!
+    sleep 2
+    
+    # Park the pointer in the middle of the zone, over whichever window is on top
+    DISPLAY="$XVFB_DISPLAY" xdotool mousemove 960 540
+    sleep 0.5
+    
+    local enters_before=$(grep -c "focus_under_pointer: Focusing" "$TEST_LOG.swm" || true)
+    local thrash=0
+    
+    # The earlier tests focused windows with the pointer, so a zero count
+    # means the pattern no longer matches what SWM logs
+    if [ "$enters_before" -eq 0 ]; then
+        kill "$PID1" "$PID2" "$PID3" 2>/dev/null || true
+        error "No pointer focus changes found in $TEST_LOG.swm; has the log message changed?"
+        return 1
+    fi
+    
+    for i in {1..6}; do
+        DISPLAY="$XVFB_DISPLAY" "$PROJECT_ROOT/swmctl" cycle-window-next
+        sleep 0.3
+        local chosen=$(get_focused_window)
+        sleep 0.3
+        local after=$(get_focused_window)
+        if [ "$chosen" != "$after" ]; then
+            warn "Cycle $i: focus moved from $chosen to $after without pointer motion"
+            thrash=1
+        fi
+    done
+    
+    local enters_after=$(grep -c "focus_under_pointer: Focusing" "$TEST_LOG.swm" || true)
+    
+    kill "$PID1" "$PID2" "$PID3" 2>/dev/null || true
+    
+    if [ "$thrash" -ne 0 ] || [ "$enters_after" -ne "$enters_before" ]; then
+        error "Keyboard cycling caused $((enters_after - enters_before)) pointer focus changes"
+        return 1
+    fi
+    
+    success "No focus thrash during keyboard cycling"
+    return 0
+}
+
 run_interactive_test() {
     log "Starting interactive focus follows mouse test..."
     log "You can now:"
@@ -446,6 +499,10 @@ main() {
             exit 1
         fi
         
+        if ! test_no_focus_thrash_on_keyboard_cycle; then
+            exit 1
+        fi
+        
         success "All focus follows mouse tests completed successfully!"
     fi
 }
@@ -0,0 +1,1717 @@
+#define _DEFAULT_SOURCE  /* For clock_gettime */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+#include <X11/keysym.h>
+#include <X11/extensions/Xinerama.h>
+#include "config.h"
+#include "core.h"
+#include "wm.h"
+#include "ipc.h"
+#include "span.h"
+#include "fake_x.h"
+
+/* Event handler tests against the in-memory fake server
+ *
+ * Each test builds a fresh fake server and window manager, feeds XEvents
+ * through dispatch_event() and checks the resulting server state along with
+ * how many requests and round trips it took. */
+
+static DisplayManager *setup(XineramaScreenInfo *monitors, int monitor_count) {
+    fake_x_reset();
+    wm = (WindowManager){0};
+    wm_init(&fake_x_ops);
+
+    LogicalZone *zones = NULL;
+    int zone_count = calculate_zones(monitors, monitor_count, &zones);
+    DisplayManager *display = fake_display_manager(zones, zone_count);
+    wm.displays = display;
+    wm.active_display = display;
+    wm.display_count = 1;
+    return display;
+}
+
+static void teardown(DisplayManager *display) {
+    fake_display_manager_free(display);
+    wm_cleanup();
+    wm = (WindowManager){0};
+}
+
+static DisplayManager *setup_two_monitors(void) {
+    XineramaScreenInfo monitors[] = {
+        {0, 0, 0, 1920, 1080},
+        {1, 1920, 0, 1920, 1080}
+    };
+    return setup(monitors, 2);
+}
+
+/* Events as the server would deliver them */
+
+static void send_map_request_on(Window parent, Window window) {
+    fake_create_window(window);
+    XEvent event = {0};
+    event.xmaprequest.type = MapRequest;
+    event.xmaprequest.parent = parent;
+    event.xmaprequest.window = window;
+    dispatch_event(&event);
+}
+
+static void send_map_request(Window window) {
+    send_map_request_on(None, window);
+}
+
+static void send_unmap_notify(Window window) {
+    fake_destroy_window(window);
+    XEvent event = {0};
+    event.xunmap.type = UnmapNotify;
+    event.xunmap.window = window;
+    dispatch_event(&event);
+}
+
+static void notify_command_property(DisplayManager *display) {
+    XEvent event = {0};
+    event.xproperty.type = PropertyNotify;
+    event.xproperty.window = display->root;
+    event.xproperty.atom = display->command_atom;
+    dispatch_event(&event);
+}
+
+/* Like swmc send, appending, so commands sent in one batch queue up */
+static void send_command_arguments(DisplayManager *display, int command, long argument,
+                                   long argument2) {
+    long items[3] = {command, argument, argument2};
+    fake_append_property32(display->root, display->command_atom, XA_INTEGER, items, 3);
+    notify_command_property(display);
+}
+
+/* What swmc send does: append, so a command already queued survives */
+static void append_command(DisplayManager *display, const long *items, int count) {
+    fake_append_property32(display->root, display->command_atom, XA_INTEGER, items, count);
+}
+
+static void send_command_argument(DisplayManager *display, int command, long argument) {
+    send_command_arguments(display, command, argument, 0);
+}
+
+static void send_command(DisplayManager *display, int command) {
+    long item = command;
+    fake_append_property32(display->root, display->command_atom, XA_INTEGER, &item, 1);
+    notify_command_property(display);
+}
+
+static void send_enter_notify(Window window) {
+    XEvent event = {0};
+    event.xcrossing.type = EnterNotify;
+    event.xcrossing.window = window;
+    dispatch_event(&event);
+}
+
+/* Let the pointer rest where it is for the focus dwell, firing any timer due */
+static void rest_pointer(void) {
+    timer_wheel_advance(&wm.timers, wm.timers.current_tick +
+                        (FOCUS_DWELL_MS + TIMER_TICK_MS - 1) / TIMER_TICK_MS);
+    commit_batch();
+}
+
+static void map_and_commit(Window window) {
+    send_map_request(window);
+    commit_batch();
+}
+
+static Window top_of_stack(void) {
+    Window order[64];
+    int count = fake_stacking_order(order, 64);
+    return count ? order[count - 1] : None;
+}
+
+/* Tests */
+
+void test_map_request(void) {
+    printf("Testing map request handling...\n");
+
+    DisplayManager *display = setup_two_monitors();
+
+    map_and_commit(0x100);
+    FakeWindow *first = fake_window(0x100);
+    assert(find_client_by_window(display, 0x100) != NULL);
+    assert(first->mapped);
+    assert(first->x == 0 && first->y == 0);
+    assert(first->width == 1920 - 2 * BORDER_WIDTH);
+    assert(first->height == 1080 - 2 * BORDER_WIDTH);
+    assert(first->border_color == FOCUS_COLOR && first->border_width == BORDER_WIDTH);
+    assert(fake_focus() == 0x100);
+#if FOCUS_FOLLOWS_MOUSE
+    assert(first->event_mask & EnterWindowMask);
+#endif
+
+    map_and_commit(0x101);
+    assert(fake_window(0x100)->border_color == UNFOCUS_COLOR);
+    assert(fake_window(0x101)->border_color == FOCUS_COLOR);
+    assert(fake_focus() == 0x101);
+    assert(top_of_stack() == 0x101);
+
+    FakeProperty *client_list = fake_get_property(display->root, display->net_atoms[NET_CLIENT_LIST]);
+    assert(client_list && client_list->count == 2);
+    FakeProperty *active = fake_get_property(display->root, display->net_atoms[NET_ACTIVE_WINDOW]);
+    assert(active && active->count == 1 && active->items[0] == 0x101);
+
+    teardown(display);
+    printf("✓ Map request test passed\n");
+}
+
+void test_cycle_and_unmap(void) {
+    printf("Testing window cycling and unmap refocus...\n");
+
+    DisplayManager *display = setup_two_monitors();
+    map_and_commit(0x100);
+    map_and_commit(0x101);
+    map_and_commit(0x102);
+
+    fake_stats_reset();
+    send_command(display, CMD_CYCLE_WINDOW_NEXT);
+    commit_batch();
+    Window focused = fake_focus();
+    assert(focused != 0x102);
+    assert(fake_window(focused)->border_color == FOCUS_COLOR);
+    assert(fake_window(0x102)->border_color == UNFOCUS_COLOR);
+    assert(top_of_stack() == focused);
+    assert(fake_stats.ops[FAKE_SET_FOCUS] == 1);
+    assert(fake_get_property(display->root, display->command_atom) == NULL);
+
+    /* Unmapping the focused window hands focus to the zone's new current */
+    send_unmap_notify(focused);
+    commit_batch();
+    assert(find_client_by_window(display, focused) == NULL);
+    Client *current = get_current_client_in_zone(display, 0);
+    assert(current && fake_focus() == current->window);
+    assert(fake_window(current->window)->border_color == FOCUS_COLOR);
+
+    teardown(display);
+    printf("✓ Cycle and unmap test passed\n");
+}
+
+void test_monitor_cycle_no_restack(void) {
+    printf("Testing monitor cycling leaves stacking alone...\n");
+
+    DisplayManager *display = setup_two_monitors();
+    map_and_commit(0x100);
+    map_and_commit(0x101);
+    send_command(display, CMD_CYCLE_MONITOR_RIGHT);
+    map_and_commit(0x200);
+
+    /* Flipping between zones refocuses windows already on top */
+    fake_stats_reset();
+    for (int i = 0; i < 10; i++) {
+        send_command(display, CMD_CYCLE_MONITOR_RIGHT);
+        commit_batch();
+    }
+    assert(fake_stats.ops[FAKE_RESTACK] == 0);
+    assert(fake_stats.ops[FAKE_SET_FOCUS] == 10);
+    assert(display->active_zone == 1 && fake_focus() == 0x200);
+
+    teardown(display);
+    printf("✓ Monitor cycle restack test passed\n");
+}
+
+void test_kill_deadline(void) {
+    printf("Testing close with WM_DELETE_WINDOW and kill deadline...\n");
+
+    DisplayManager *display = setup_two_monitors();
+
+    /* A client without WM_DELETE_WINDOW is killed at once */
+    map_and_commit(0x100);
+    send_command(display, CMD_KILL_WINDOW);
+    commit_batch();
+    assert(fake_window(0x100)->killed);
+    send_unmap_notify(0x100);
+    commit_batch();
+    assert(count_managed_clients(display) == 0);
+
+    /* A polite client gets a WM_DELETE_WINDOW and the deadline timer */
+    map_and_commit(0x101);
+    long protocols[] = {display->wm_atoms[WM_DELETE_WINDOW]};
+    fake_set_property32(0x101, display->wm_atoms[WM_PROTOCOLS], XA_ATOM, protocols, 1);
+    send_command(display, CMD_KILL_WINDOW);
+    commit_batch();
+    assert(fake_window(0x101)->delete_requests == 1);
+    assert(!fake_window(0x101)->killed);
+    assert(wm.timers.active_count == 1);
+
+    /* It ignores the request; the deadline force kills it */
+    timer_wheel_advance(&wm.timers, wm.timers.current_tick + KILL_TIMEOUT_MS / TIMER_TICK_MS - 1);
+    commit_batch();
+    assert(!fake_window(0x101)->killed);
+    timer_wheel_advance(&wm.timers, wm.timers.current_tick + 1);
+    assert(!fake_window(0x101)->killed);
+    commit_batch();
+    assert(fake_window(0x101)->killed);
+    send_unmap_notify(0x101);
+    commit_batch();
+
+    /* A client that complies in time has its deadline cancelled */
+    map_and_commit(0x102);
+    fake_set_property32(0x102, display->wm_atoms[WM_PROTOCOLS], XA_ATOM, protocols, 1);
+    send_command(display, CMD_KILL_WINDOW);
+    send_unmap_notify(0x102);
+    commit_batch();
+    assert(wm.timers.active_count == 0);
+    assert(!fake_window(0x102)->killed);
+
+    teardown(display);
+    printf("✓ Kill deadline test passed\n");
+}
+
+void test_move_window(void) {
+    printf("Testing moving windows between zones...\n");
+
+    DisplayManager *display = setup_two_monitors();
+    map_and_commit(0x100);
+    map_and_commit(0x101);
+
+    send_command(display, CMD_MOVE_WINDOW_RIGHT);
+    commit_batch();
+    FakeWindow *moved = fake_window(0x101);
+    assert(display->active_zone == 1);
+    assert(find_client_by_window(display, 0x101)->zone_index == 1);
+    assert(moved->x == 1920 && moved->width == 1920 - 2 * BORDER_WIDTH);
+
+    teardown(display);
+    printf("✓ Move window test passed\n");
+}
+
+void test_direct_commands(void) {
+    printf("Testing commands addressing a zone or window directly...\n");
+
+    XineramaScreenInfo monitors[] = {
+        {0, 0, 0, 5760, 1080},
+        {1, 5760, 0, 1920, 1080}
+    };
+    DisplayManager *display = setup(monitors, 2);
+    assert(display->zone_count == 4);
+    map_and_commit(0x100);
+    map_and_commit(0x101);
+
+    /* Three zones over in one step and a single resize */
+    fake_stats_reset();
+    send_command_argument(display, CMD_MOVE_WINDOW_TO_ZONE, 3);
+    commit_batch();
+    assert(fake_stats.ops[FAKE_MOVE_RESIZE] == 1);
+    assert(find_client_by_window(display, 0x101)->zone_index == 3);
+    assert(fake_window(0x101)->x == 5760);
+    assert(display->active_zone == 3);
+
+    send_command_argument(display, CMD_FOCUS_ZONE, 0);
+    commit_batch();
+    assert(display->active_zone == 0 && fake_focus() == 0x100);
+    assert(fake_window(0x101)->border_color == UNFOCUS_COLOR);
+
+    /* Zones and windows that do not exist are ignored */
+    fake_stats_reset();
+    send_command_argument(display, CMD_FOCUS_ZONE, 9);
+    send_command_argument(display, CMD_MOVE_WINDOW_TO_ZONE, -1);
+    send_command_argument(display, CMD_FOCUS_WINDOW, 0x999);
+    commit_batch();
+    assert(fake_stats.ops[FAKE_SET_FOCUS] == 0 && fake_stats.ops[FAKE_MOVE_RESIZE] == 0);
+    assert(display->active_zone == 0);
+
+    send_command_argument(display, CMD_FOCUS_WINDOW, 0x101);
+    commit_batch();
+    assert(display->active_zone == 3 && fake_focus() == 0x101);
+
+    /* Swapping reorders the zone without moving anything */
+    map_and_commit(0x102);
+    send_command_argument(display, CMD_FOCUS_WINDOW, 0x101);
+    commit_batch();
+    fake_stats_reset();
+    send_command(display, CMD_SWAP_FIRST);
+    commit_batch();
+    assert(display->zone_clients[3]->window == 0x101);
+    assert(get_current_client_in_zone(display, 3)->window == 0x101);
+    assert(fake_stats.ops[FAKE_MOVE_RESIZE] == 0 && fake_stats.ops[FAKE_SET_FOCUS] == 0);
+
+    teardown(display);
+    printf("✓ Direct commands test passed\n");
+}
+
+void test_command_queue(void) {
+    printf("Testing commands queued in _SWM_COMMAND all run in order...\n");
+
+    XineramaScreenInfo monitors[] = {
+        {0, 0, 0, 5760, 1080},
+        {1, 5760, 0, 1920, 1080}
+    };
+    DisplayManager *display = setup(monitors, 2);
+    map_and_commit(0x100);
+    map_and_commit(0x101);
+    map_and_commit(0x102);
+
+    /* Three clients append before swm reads; one read takes all */
+    long move[] = {CMD_MOVE_WINDOW_TO_ZONE, 3};
+    long focus[] = {CMD_FOCUS_ZONE, 0};
+    long gather[] = {CMD_GATHER_WINDOWS};
+    append_command(display, move, 2);
+    append_command(display, focus, 2);
+    append_command(display, gather, 1);
+    fake_stats_reset();
+    notify_command_property(display);
+    notify_command_property(display);
+    notify_command_property(display);
+    commit_batch();
+    assert(fake_stats.round_trips == 1);
+    assert(fake_get_property(display->root, display->command_atom) == NULL);
+
+    assert(wm.stats[STATS_COMMAND + CMD_MOVE_WINDOW_TO_ZONE].calls == 1);
+    assert(wm.stats[STATS_COMMAND + CMD_GATHER_WINDOWS].calls == 1);
+    assert(display->active_zone == 0);
+    assert(find_client_by_window(display, 0x102)->zone_index == 0);
+    assert(fake_stats.ops[FAKE_SET_FOCUS] == 1);
+
+    /* Our own delete of the queue notifies too, and is not read again */
+    XEvent deleted;
+    assert(fake_next_event(&deleted) && deleted.xproperty.state == PropertyDelete);
+    fake_stats_reset();
+    dispatch_event(&deleted);
+    commit_batch();
+    assert(fake_stats.round_trips == 0);
+
+    /* A long burst loses nothing and still costs one read */
+    long next[] = {CMD_CYCLE_WINDOW_NEXT};
+    for (int i = 0; i < 1000; i++) {
+        append_command(display, next, 1);
+    }
+    fake_stats_reset();
+    notify_command_property(display);
+    commit_batch();
+    assert(fake_stats.round_trips == 1);
+    assert(wm.stats[STATS_COMMAND + CMD_CYCLE_WINDOW_NEXT].calls == 1000);
+
+    /* Padding from three-item writers is skipped; an unknown command ends the queue */
+    long padded[] = {CMD_FOCUS_ZONE, 1, 0};
+    long unknown[] = {99, 2};
+    append_command(display, padded, 3);
+    append_command(display, unknown, 2);
+    append_command(display, focus, 2);
+    notify_command_property(display);
+    commit_batch();
+    assert(display->active_zone == 1);
+
+    teardown(display);
+    printf("✓ Command queue test passed\n");
+}
+
+void test_command_macros(void) {
+    printf("Testing macros and inline batches reach the server once...\n");
+
+    XineramaScreenInfo monitors[] = {
+        {0, 0, 0, 5760, 1080},
+        {1, 5760, 0, 1920, 1080}
+    };
+    DisplayManager *display = setup(monitors, 2);
+    map_and_commit(0x100);
+    map_and_commit(0x101);
+    assert(fake_focus() == 0x101);
+
+    /* Macro 0 throws the window right and stays: one resize, one focus */
+    fake_stats_reset();
+    send_command_argument(display, CMD_RUN_MACRO, 0);
+    commit_batch();
+    assert(find_client_by_window(display, 0x101)->zone_index == 1);
+    assert(display->active_zone == 0 && fake_focus() == 0x100);
+    assert(fake_stats.ops[FAKE_MOVE_RESIZE] == 1 && fake_stats.ops[FAKE_SET_FOCUS] == 1);
+    assert(wm.stats[STATS_COMMAND + CMD_MOVE_WINDOW_RIGHT].calls == 1);
+
+    /* An inline batch in one append: the intermediate zones are never sent */
+    long batch[] = {CMD_MOVE_WINDOW_RIGHT, CMD_MOVE_WINDOW_RIGHT, CMD_MOVE_WINDOW_LEFT};
+    append_command(display, batch, 3);
+    fake_stats_reset();
+    notify_command_property(display);
+    commit_batch();
+    assert(find_client_by_window(display, 0x100)->zone_index == 1);
+    assert(fake_window(0x100)->x == display->zones[1].geometry.x);
+    assert(fake_stats.ops[FAKE_MOVE_RESIZE] == 1);
+
+    /* Focus went with the window and ended where it started, so none is sent */
+    assert(fake_focus() == 0x100 && fake_stats.ops[FAKE_SET_FOCUS] == 0);
+    assert(fake_stats.round_trips == 1);
+
+    /* Macros that do not exist do nothing */
+    fake_stats_reset();
+    send_command_argument(display, CMD_RUN_MACRO, 99);
+    send_command_argument(display, CMD_RUN_MACRO, -1);
+    commit_batch();
+    assert(fake_stats.ops[FAKE_MOVE_RESIZE] == 0 && fake_stats.ops[FAKE_SET_FOCUS] == 0);
+
+    teardown(display);
+    printf("✓ Command macros test passed\n");
+}
+
+void test_bulk_zone_commands(void) {
+    printf("Testing whole-zone moves, gathers and closes...\n");
+
+    XineramaScreenInfo monitors[] = {
+        {0, 0, 0, 5760, 1080},
+        {1, 5760, 0, 1920, 1080}
+    };
+    DisplayManager *display = setup(monitors, 2);
+    for (Window window = 0x100; window < 0x105; window++) {
+        map_and_commit(window);
+    }
+    assert(display->active_zone == 0);
+    Window current = get_current_client_in_zone(display, 0)->window;
+
+    /* Five windows move in one batch with a single focus change */
+    fake_stats_reset();
+    send_command_arguments(display, CMD_MOVE_ZONE_WINDOWS, -1, 2);
+    commit_batch();
+    assert(fake_stats.round_trips == 1);
+    assert(fake_stats.ops[FAKE_MOVE_RESIZE] == 5);
+    assert(fake_stats.ops[FAKE_SET_FOCUS] == 1);
+    assert(display->zone_clients[0] == NULL);
+    for (Window window = 0x100; window < 0x105; window++) {
+        Client *client = find_client_by_window(display, window);
+        assert(client->zone_index == 2);
+        assert(fake_window(window)->x == display->zones[2].geometry.x);
+    }
+    assert(display->active_zone == 2);
+    assert(get_current_client_in_zone(display, 2)->window == current);
+    assert(fake_focus() == current);
+
+    /* Moving an empty zone, or a zone onto itself, does nothing */
+    fake_stats_reset();
+    send_command_arguments(display, CMD_MOVE_ZONE_WINDOWS, 0, 1);
+    send_command_arguments(display, CMD_MOVE_ZONE_WINDOWS, 2, 2);
+    commit_batch();
+    assert(fake_stats.requests == 1 && fake_stats.round_trips == 1);
+
+    /* Gathering pulls every zone onto the active one and keeps its focus */
+    send_command_argument(display, CMD_FOCUS_ZONE, 3);
+    commit_batch();
+    map_and_commit(0x105);
+    fake_stats_reset();
+    send_command(display, CMD_GATHER_WINDOWS);
+    commit_batch();
+    assert(fake_stats.ops[FAKE_MOVE_RESIZE] == 5);
+    assert(display->active_zone == 3 && fake_focus() == 0x105);
+    for (Window window = 0x100; window < 0x106; window++) {
+        assert(find_client_by_window(display, window)->zone_index == 3);
+    }
+
+    /* Closing the zone asks every window at once */
+    fake_stats_reset();
+    send_command_argument(display, CMD_CLOSE_ZONE_WINDOWS, -1);
+    commit_batch();
+    assert(fake_stats.ops[FAKE_KILL_CLIENT] + fake_stats.ops[FAKE_SEND_MESSAGE] == 6);
+
+    teardown(display);
+    printf("✓ Bulk zone commands test passed\n");
+}
+
+void test_ewmh_coalescing(void) {
+    printf("Testing root property writes are coalesced per batch...\n");
+
+    DisplayManager *display = setup_two_monitors();
+
+    /* One batch of 100 maps writes each root property once, besides the
+     * two state properties of every window */
+    for (Window window = 0x100; window < 0x100 + 100; window++) {
+        send_map_request(window);
+    }
+    fake_stats_reset();
+    commit_batch();
+    assert(fake_stats.ops[FAKE_CHANGE_PROPERTY] == 2 + 2 * 100);
+    assert(fake_stats.ops[FAKE_SET_FOCUS] == 1);
+    assert(fake_stats.ops[FAKE_MAP] == 100);
+
+    FakeProperty *client_list = fake_get_property(display->root, display->net_atoms[NET_CLIENT_LIST]);
+    assert(client_list && client_list->count == 100);
+
+    /* Nothing changed, nothing sent */
+    fake_stats_reset();
+    commit_batch();
+    assert(fake_stats.requests == 0 && fake_stats.round_trips == 0);
+
+    teardown(display);
+    printf("✓ EWMH coalescing test passed\n");
+}
+
+void test_handler_budgets(void) {
+    printf("Testing per-handler round trip and request budgets...\n");
+
+    DisplayManager *display = setup_two_monitors();
+    fake_stats_reset();
+
+    /* Every handler and command at least once, each event in its own batch */
+    for (Window window = 0x100; window < 0x106; window++) {
+        map_and_commit(window);
+    }
+    for (int command = 1; command < CMD_COUNT; command++) {
+        if (command == CMD_QUIT || command == CMD_KILL_WINDOW ||
+            command == CMD_CLOSE_ZONE_WINDOWS) continue;
+        send_command(display, command);
+        commit_batch();
+    }
+
+    XEvent event = {0};
+    event.xclient.type = ClientMessage;
+    event.xclient.window = 0x101;
+    event.xclient.message_type = display->net_atoms[NET_ACTIVE_WINDOW];
+    event.xclient.format = 32;
+    dispatch_event(&event);
+    commit_batch();
+    send_command(display, CMD_KILL_WINDOW);
+    commit_batch();
+    send_unmap_notify(0x101);
+    commit_batch();
+
+    fake_destroy_window(0x102);
+    event = (XEvent){0};
+    event.xdestroywindow.type = DestroyNotify;
+    event.xdestroywindow.window = 0x102;
+    dispatch_event(&event);
+    commit_batch();
+#if FOCUS_FOLLOWS_MOUSE
+    send_enter_notify(0x103);
+    commit_batch();
+#endif
+
+    assert(wm.stats[STATS_MAP].calls == 6);
+    assert(wm.stats[STATS_COMMAND + CMD_CYCLE_WINDOW_NEXT].calls == 1);
+    assert(wm.stats[STATS_COMMAND_READ].round_trips == CMD_COUNT - 3);
+    assert(wm.stats[STATS_COMMAND + CMD_KILL_WINDOW].max_round_trips == 1);
+    assert(check_handler_budgets(stderr) == 0);
+
+    /* Round trips are counted above the backend: every reply the server
+     * sent is charged to some handler */
+    unsigned long charged = 0;
+    for (int slot = 0; slot < STATS_COUNT; slot++) {
+        charged += wm.stats[slot].round_trips;
+    }
+    assert(charged == fake_stats.round_trips);
+
+    /* A handler that starts waiting on the server is caught */
+    wm.stats[STATS_COMMAND + CMD_CYCLE_WINDOW_NEXT].max_round_trips = 1;
+    silence_debug_output(true);
+    int violations = check_handler_budgets(stdout);
+    silence_debug_output(false);
+    assert(violations == 1);
+
+    teardown(display);
+    printf("✓ Handler budget test passed\n");
+}
+
+static void send_key_press(KeySym keysym, unsigned int state) {
+    XEvent event = {0};
+    event.xkey.type = KeyPress;
+    event.xkey.keycode = fake_keycode(keysym);
+    event.xkey.state = state;
+    dispatch_event(&event);
+}
+
+void test_key_bindings(void) {
+    printf("Testing built-in key bindings...\n");
+
+    DisplayManager *display = setup_two_monitors();
+    static const KeyBinding bindings[] = {
+        {Mod4Mask,             XK_j, CMD_CYCLE_WINDOW_NEXT, 0},
+        {Mod4Mask | ShiftMask, XK_l, CMD_MOVE_WINDOW_RIGHT, 0},
+        {Mod4Mask,             XK_1, CMD_FOCUS_ZONE,        0},
+    };
+    load_key_bindings(display, bindings, 3);
+
+    /* Each binding is grabbed with every CapsLock/NumLock combination */
+    assert(fake_grab_count() == 12);
+    KeyCode j = fake_keycode(XK_j);
+    assert(fake_key_grabbed(j, Mod4Mask));
+    assert(fake_key_grabbed(j, Mod4Mask | LockMask));
+    assert(fake_key_grabbed(j, Mod4Mask | Mod2Mask));
+    assert(fake_key_grabbed(j, Mod4Mask | Mod2Mask | LockMask));
+
+    map_and_commit(0x100);
+    map_and_commit(0x101);
+
+    /* A key press runs its command without a single round trip */
+    fake_stats_reset();
+    send_key_press(XK_j, Mod4Mask | Mod2Mask);
+    assert(fake_stats.requests == 0 && fake_stats.round_trips == 0);
+    commit_batch();
+    assert(fake_focus() == 0x100);
+    assert(fake_stats.round_trips == 0);
+
+    send_key_press(XK_l, Mod4Mask | ShiftMask | LockMask);
+    commit_batch();
+    assert(find_client_by_window(display, 0x100)->zone_index == 1);
+
+    /* Unbound keys and modifier combinations do nothing */
+    send_key_press(XK_j, Mod4Mask | ControlMask);
+    send_key_press(XK_k, Mod4Mask);
+    commit_batch();
+    assert(display->active_zone == 1 && fake_focus() == 0x100);
+
+    /* Bindings pass their argument along */
+    send_key_press(XK_1, Mod4Mask);
+    commit_batch();
+    assert(display->active_zone == 0 && fake_focus() == 0x101);
+
+    /* A keyboard remap regrabs from scratch */
+    XEvent event = {0};
+    event.xmapping.type = MappingNotify;
+    event.xmapping.request = MappingKeyboard;
+    dispatch_event(&event);
+    assert(fake_grab_count() == 12);
+
+    teardown(display);
+    assert(wm.keys.count == 0);
+    printf("✓ Key bindings test passed\n");
+}
+
+#if AUTO_FLOAT
+void test_floating_windows(void) {
+    printf("Testing floating transients, dialogs and fixed-size windows...\n");
+
+    DisplayManager *display = setup_two_monitors();
+    map_and_commit(0x100);
+    send_command(display, CMD_MOVE_WINDOW_RIGHT);
+    send_command_argument(display, CMD_FOCUS_ZONE, 0);
+    commit_batch();
+
+    /* A transient opens over its parent's zone at its own size, read in
+     * the same round trip as its properties */
+    fake_create_window(0x101)->width = 400;
+    fake_window(0x101)->height = 200;
+    long parent = 0x100;
+    fake_set_property32(0x101, XA_WM_TRANSIENT_FOR, XA_WINDOW, &parent, 1);
+    fake_stats_reset();
+    map_and_commit(0x101);
+    assert(fake_stats.round_trips == 1);
+    Client *transient = find_client_by_window(display, 0x101);
+    assert(transient->floating && transient->zone_index == 1);
+    FakeWindow *window = fake_window(0x101);
+    assert(window->width == 400 && window->height == 200);
+    assert(window->x == 1920 + (1920 - 400 - 2 * BORDER_WIDTH) / 2);
+    assert(window->y == (1080 - 200 - 2 * BORDER_WIDTH) / 2);
+    assert(fake_focus() == 0x101 && display->active_zone == 1);
+
+    /* Tiled windows mapped later stay below it */
+    map_and_commit(0x102);
+    assert(fake_window(0x102)->width == 1920 - 2 * BORDER_WIDTH);
+    assert(top_of_stack() == 0x101);
+    assert(fake_focus() == 0x102);
+
+    /* Size hints with min == max win over the current size */
+    fake_create_window(0x103);
+    long hints[18] = {PMinSize | PMaxSize, 0, 0, 0, 0, 300, 100, 300, 100};
+    fake_set_property32(0x103, XA_WM_NORMAL_HINTS, XA_WM_SIZE_HINTS, hints, 18);
+    fake_stats_reset();
+    map_and_commit(0x103);
+    assert(fake_stats.round_trips == 1);
+    assert(find_client_by_window(display, 0x103)->floating);
+    assert(fake_window(0x103)->width == 300 && fake_window(0x103)->height == 100);
+
+    /* Dialog-like types float too; resizable normal windows do not */
+    fake_create_window(0x104)->width = 640;
+    long utility = display->net_atoms[NET_WM_WINDOW_TYPE_UTILITY];
+    fake_set_property32(0x104, display->net_atoms[NET_WM_WINDOW_TYPE], XA_ATOM, &utility, 1);
+    map_and_commit(0x104);
+    assert(find_client_by_window(display, 0x104)->floating);
+    assert(fake_window(0x104)->width == 640);
+    hints[7] = 600;
+    fake_create_window(0x105);
+    fake_set_property32(0x105, XA_WM_NORMAL_HINTS, XA_WM_SIZE_HINTS, hints, 18);
+    map_and_commit(0x105);
+    assert(!find_client_by_window(display, 0x105)->floating);
+
+    /* Monocle hides tiled windows only */
+    send_command(display, CMD_TOGGLE_MONOCLE);
+    commit_batch();
+    assert(fake_window(0x101)->mapped && fake_window(0x104)->mapped);
+    assert(!fake_window(0x100)->mapped && fake_window(0x105)->mapped);
+
+    /* Moving keeps the size and recenters */
+    send_command_argument(display, CMD_FOCUS_WINDOW, 0x101);
+    send_command(display, CMD_MOVE_WINDOW_LEFT);
+    commit_batch();
+    assert(find_client_by_window(display, 0x101)->zone_index == 0);
+    assert(window->x == (1920 - 400 - 2 * BORDER_WIDTH) / 2 && window->width == 400);
+
+    teardown(display);
+    printf("✓ Floating windows test passed\n");
+}
+#endif
+
+#if DOCK_STRUTS
+static void set_dock_strut(DisplayManager *display, Window window, long top, long start, long end) {
+    long strut[STRUT_VALUES] = {0, 0, top, 0, 0, 0, 0, 0, start, end, 0, 0};
+    fake_set_property32(window, display->net_atoms[NET_WM_STRUT_PARTIAL], XA_CARDINAL,
+                        strut, STRUT_VALUES);
+    XEvent event = {0};
+    event.xproperty.type = PropertyNotify;
+    event.xproperty.window = window;
+    event.xproperty.atom = display->net_atoms[NET_WM_STRUT_PARTIAL];
+    dispatch_event(&event);
+}
+
+void test_docks(void) {
+    printf("Testing docks and their struts...\n");
+
+    DisplayManager *display = setup_two_monitors();
+    map_and_commit(0x100);
+    send_command(display, CMD_MOVE_WINDOW_RIGHT);
+    send_command_argument(display, CMD_FOCUS_ZONE, 0);
+    map_and_commit(0x101);
+    map_and_commit(0x102);
+
+    /* A top bar on the first monitor is mapped unmanaged and unfocused, and
+     * only the two windows of the zone under it are refitted */
+    fake_create_window(0x200);
+    long dock = display->net_atoms[NET_WM_WINDOW_TYPE_DOCK];
+    fake_set_property32(0x200, display->net_atoms[NET_WM_WINDOW_TYPE], XA_ATOM, &dock, 1);
+    long strut[STRUT_VALUES] = {0, 0, 30, 0, 0, 0, 0, 0, 0, 1919, 0, 0};
+    fake_set_property32(0x200, display->net_atoms[NET_WM_STRUT_PARTIAL], XA_CARDINAL,
+                        strut, STRUT_VALUES);
+    fake_stats_reset();
+    map_and_commit(0x200);
+    assert(fake_window(0x200)->mapped && find_dock(display, 0x200));
+    assert(!find_client_on_any_display(wm.displays, 0x200, NULL) && count_managed_clients(display) == 3);
+    assert(fake_focus() == 0x102 && fake_stats.ops[FAKE_SET_BORDER] == 0);
+    assert(fake_stats.ops[FAKE_MOVE_RESIZE] == 2);
+    assert(fake_window(0x101)->y == 30 && fake_window(0x102)->y == 30);
+    assert(fake_window(0x102)->height == 1050 - 2 * BORDER_WIDTH);
+    assert(fake_window(0x100)->y == 0 && fake_window(0x100)->height == 1080 - 2 * BORDER_WIDTH);
+    assert(check_handler_budgets(stdout) == 0);
+
+    /* Asking to be mapped again does not add a second dock */
+    map_and_commit(0x200);
+    assert(find_dock(display, 0x200) && !find_dock(display, 0x200)->next);
+
+    /* New windows in that zone fit under the bar */
+    map_and_commit(0x103);
+    assert(fake_window(0x103)->y == 30);
+
+    /* An auto-hiding panel sliding away is only read once it has settled */
+    fake_stats_reset();
+    for (long top = 25; top >= 0; top -= 5) {
+        set_dock_strut(display, 0x200, top, 0, 1919);
+        timer_wheel_advance(&wm.timers, wm.timers.current_tick + 1);
+        commit_batch();
+    }
+    assert(fake_stats.requests == 0 && fake_stats.round_trips == 0);
+    timer_wheel_advance(&wm.timers, wm.timers.current_tick +
+                        (STRUT_SETTLE_MS + TIMER_TICK_MS - 1) / TIMER_TICK_MS);
+    commit_batch();
+    assert(fake_stats.round_trips == 1 && fake_stats.ops[FAKE_MOVE_RESIZE] == 3);
+    assert(fake_window(0x101)->y == 0 && fake_window(0x103)->height == 1080 - 2 * BORDER_WIDTH);
+
+    /* A strut along the other monitor leaves the first one alone */
+    set_dock_strut(display, 0x200, 40, 1920, 3839);
+    timer_wheel_advance(&wm.timers, wm.timers.current_tick +
+                        (STRUT_SETTLE_MS + TIMER_TICK_MS - 1) / TIMER_TICK_MS);
+    fake_stats_reset();
+    commit_batch();
+    assert(fake_stats.ops[FAKE_MOVE_RESIZE] == 1 && fake_window(0x100)->y == 40);
+
+    /* The zone gets its space back when the dock goes */
+    fake_stats_reset();
+    send_unmap_notify(0x200);
+    commit_batch();
+    assert(!find_dock(display, 0x200) && fake_stats.ops[FAKE_MOVE_RESIZE] == 1);
+    assert(fake_window(0x100)->y == 0 && fake_window(0x100)->height == 1080 - 2 * BORDER_WIDTH);
+    assert(fake_focus() == 0x103);
+
+    teardown(display);
+    printf("✓ Docks test passed\n");
+}
+#endif
+
+static void write_settings(const char *path, const char *text) {
+    FILE *file = fopen(path, "w");
+    assert(file);
+    fputs(text, file);
+    fclose(file);
+}
+
+void test_reload_settings(void) {
+    printf("Testing settings reload...\n");
+
+    XineramaScreenInfo monitors[] = {
+        {0, 0, 0, 5120, 1440},
+        {1, 5120, 0, 1920, 1080}
+    };
+    DisplayManager *display = setup(monitors, 2);
+    char path[] = "/tmp/swm-settings-XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+    wm.settings_path = path;
+
+    /* One window in each zone, focus ending in the last */
+    for (int zone = 0; zone < 4; zone++) {
+        send_command_argument(display, CMD_FOCUS_ZONE, zone);
+        map_and_commit(0x100 + zone);
+    }
+    assert(fake_focus() == 0x103);
+
+    /* A wider left zone only refits the two zones whose share changed */
+    write_settings(path, "zone_left_ratio = 0.30\nzone_center_ratio = 0.45\n");
+    fake_stats_reset();
+    send_command(display, CMD_RELOAD_SETTINGS);
+    commit_batch();
+    assert(fake_stats.ops[FAKE_MOVE_RESIZE] == 2 && fake_stats.ops[FAKE_SET_BORDER] == 0);
+    assert(fake_window(0x100)->width == 1536 - 2 * BORDER_WIDTH);
+    assert(fake_window(0x101)->x == 1536 && fake_window(0x101)->width == 2304 - 2 * BORDER_WIDTH);
+    assert(display->zones[1].geometry.width == 2304);
+
+    /* New colors re-border every window without moving any */
+    write_settings(path, "zone_left_ratio = 0.30\nzone_center_ratio = 0.45\n"
+                         "focus_color = #ff8800\nunfocus_color = #101010\n");
+    fake_stats_reset();
+    send_command(display, CMD_RELOAD_SETTINGS);
+    commit_batch();
+    assert(fake_stats.ops[FAKE_MOVE_RESIZE] == 0 && fake_stats.ops[FAKE_SET_BORDER] == 4);
+    assert(fake_window(0x103)->border_color == 0xff8800);
+    assert(fake_window(0x100)->border_color == 0x101010);
+
+    /* A new border width refits everything; lines left out are back to
+     * their defaults */
+    write_settings(path, "border_width = 5\n");
+    fake_stats_reset();
+    send_command(display, CMD_RELOAD_SETTINGS);
+    commit_batch();
+    assert(fake_stats.ops[FAKE_MOVE_RESIZE] == 4 && fake_stats.ops[FAKE_SET_BORDER] == 4);
+    assert(fake_window(0x100)->width == 1280 - 10 && fake_window(0x100)->border_width == 5);
+    assert(fake_window(0x103)->border_color == FOCUS_COLOR);
+    assert(fake_stats.round_trips == 1);
+
+    /* A file with an error changes nothing */
+    write_settings(path, "border_width = 5\nborder_width = wide\n");
+    fake_stats_reset();
+    send_command(display, CMD_RELOAD_SETTINGS);
+    commit_batch();
+    assert(fake_stats.requests == 1 && wm.settings.border_width == 5);
+
+#if FOCUS_FOLLOWS_MOUSE
+    /* Focus can stop following the mouse without a restart */
+    write_settings(path, "focus_follows_mouse = 0\n");
+    send_command(display, CMD_RELOAD_SETTINGS);
+    commit_batch();
+    send_enter_notify(0x100);
+    rest_pointer();
+    assert(fake_focus() == 0x103);
+#endif
+
+    unlink(path);
+    teardown(display);
+    printf("✓ Settings reload test passed\n");
+}
+
+void test_zone_split_commands(void) {
+    printf("Testing live zone split resizing...\n");
+
+    XineramaScreenInfo monitors[] = {
+        {0, 0, 0, 5120, 1440},
+        {1, 5120, 0, 1920, 1080}
+    };
+    DisplayManager *display = setup(monitors, 2);
+    for (int zone = 0; zone < 4; zone++) {
+        send_command_argument(display, CMD_FOCUS_ZONE, zone);
+        map_and_commit(0x100 + zone);
+    }
+    send_command_argument(display, CMD_FOCUS_ZONE, 1);
+    commit_batch();
+
+    /* Repeated steps queued together resize each window of the two zones
+     * once, to the final split, and leave the other zones alone */
+    long steps[] = {CMD_MOVE_SPLIT, -1, 100, CMD_MOVE_SPLIT, -1, 100, CMD_MOVE_SPLIT, -1, 56};
+    append_command(display, steps, 9);
+    fake_stats_reset();
+    notify_command_property(display);
+    commit_batch();
+    assert(fake_stats.ops[FAKE_MOVE_RESIZE] == 2 && fake_stats.round_trips == 1);
+    assert(fake_stats.ops[FAKE_SET_FOCUS] == 0);
+    assert(display->zones[1].geometry.width == 2560 + 256);
+    assert(fake_window(0x101)->width == 2560 + 256 - 2 * BORDER_WIDTH);
+    assert(fake_window(0x102)->x == 3840 + 256 && fake_window(0x102)->width == 1280 - 256 - 2 * BORDER_WIDTH);
+    assert(fake_window(0x100)->width == 1280 - 2 * BORDER_WIDTH);
+
+    /* An absolute split counts from the monitor's left edge */
+    fake_stats_reset();
+    send_command_arguments(display, CMD_SET_SPLIT, 0, 1600);
+    commit_batch();
+    assert(fake_stats.ops[FAKE_MOVE_RESIZE] == 2);
+    assert(fake_window(0x100)->width == 1600 - 2 * BORDER_WIDTH && fake_window(0x101)->x == 1600);
+
+    /* Monitors have no split between them */
+    fake_stats_reset();
+    send_command_arguments(display, CMD_MOVE_SPLIT, 2, 100);
+    commit_batch();
+    assert(fake_stats.ops[FAKE_MOVE_RESIZE] == 0);
+    assert(check_handler_budgets(stdout) == 0);
+
+    teardown(display);
+    printf("✓ Zone split commands test passed\n");
+}
+
+void test_window_rules_at_map(void) {
+    printf("Testing window rules at map time...\n");
+
+    DisplayManager *display = setup_two_monitors();
+    static const WindowRule rules[] = {
+        {"Chat",  NULL, NULL, NULL,                          1, false, false},
+        {"Term",  NULL, NULL, NULL,                          1, false, true},
+        {NULL,    NULL, NULL, "_NET_WM_WINDOW_TYPE_DIALOG", -1, true,  true},
+    };
+    load_window_rules(display, rules, 3);
+
+    map_and_commit(0x100);
+    assert(display->active_zone == 0 && fake_focus() == 0x100);
+
+    /* Sent to zone 1 without taking focus */
+    fake_create_window(0x101);
+    fake_set_text_property(0x101, XA_WM_CLASS, XA_STRING, "chat\0Chat", 10);
+    fake_stats_reset();
+    map_and_commit(0x101);
+    assert(find_client_by_window(display, 0x101)->zone_index == 1);
+    assert(fake_window(0x101)->x == 1920);
+    assert(fake_window(0x101)->border_color == UNFOCUS_COLOR);
+    assert(display->active_zone == 0 && fake_focus() == 0x100);
+    assert(fake_stats.ops[FAKE_SET_FOCUS] == 0);
+
+    /* Sent to zone 1 and focused there */
+    fake_create_window(0x102);
+    fake_set_text_property(0x102, XA_WM_CLASS, XA_STRING, "term\0Term", 10);
+    map_and_commit(0x102);
+    assert(display->active_zone == 1 && fake_focus() == 0x102);
+    assert(fake_window(0x100)->border_color == UNFOCUS_COLOR);
+
+    /* Floating dialogs keep their own size */
+    fake_create_window(0x103)->width = 400;
+    long dialog = fake_intern_atom("_NET_WM_WINDOW_TYPE_DIALOG");
+    fake_set_property32(0x103, display->net_atoms[NET_WM_WINDOW_TYPE], XA_ATOM, &dialog, 1);
+    map_and_commit(0x103);
+    assert(find_client_by_window(display, 0x103)->zone_index == 1);
+    assert(fake_window(0x103)->width == 400);
+    assert(fake_focus() == 0x103);
+
+    /* Classification and the rules share one batch of reads, however
+     * many rules there are */
+    WindowRule many[64];
+    for (int i = 0; i < 64; i++) {
+        many[i] = (WindowRule){"Other", NULL, "title", NULL, 0, false, true};
+    }
+    many[0] = (WindowRule){NULL, NULL, NULL, "_NET_WM_WINDOW_TYPE_DIALOG", -1, true, true};
+    many[63].class_name = "Chat";
+    load_window_rules(display, many, 64);
+    fake_create_window(0x104);
+    fake_set_text_property(0x104, XA_WM_CLASS, XA_STRING, "chat\0Chat", 10);
+    fake_set_text_property(0x104, display->net_atoms[NET_WM_NAME], display->utf8_string_atom, "a title", 7);
+    fake_stats_reset();
+    send_map_request(0x104);
+    assert(fake_stats.round_trips == 1);
+    assert(find_client_by_window(display, 0x104)->zone_index == 0);
+    commit_batch();
+
+    /* Reading every property rules can look at still fits the map budget */
+    assert(wm.stats[STATS_MAP].max_round_trips == 1 && wm.stats[STATS_MAP].max_requests == 7);
+    assert(check_handler_budgets(stdout) == 0);
+
+    /* A second round trip at map is caught, whatever rules are loaded */
+    wm.stats[STATS_MAP].max_round_trips = 2;
+    silence_debug_output(true);
+    int violations = check_handler_budgets(stdout);
+    silence_debug_output(false);
+    assert(violations == 1);
+
+    teardown(display);
+    printf("✓ Window rules at map test passed\n");
+}
+
+/* Deliver whatever the fake server generated for swm's own requests */
+static void deliver_server_events(void) {
+    XEvent event;
+    while (fake_next_event(&event)) {
+        dispatch_event(&event);
+    }
+}
+
+static void drain_server_events(void) {
+    deliver_server_events();
+    commit_batch();
+    rest_pointer();
+}
+
+static bool client_is_iconic(DisplayManager *display, Window window) {
+    FakeProperty *state = fake_get_property(window, display->wm_atoms[WM_STATE]);
+    FakeProperty *net_state = fake_get_property(window, display->net_atoms[NET_WM_STATE]);
+    assert(state && net_state);
+    bool iconic = state->items[0] == IconicState;
+    assert(iconic == (net_state->count == 1 &&
+                      (Atom)net_state->items[0] == display->net_atoms[NET_WM_STATE_HIDDEN]));
+    return iconic;
+}
+
+void test_monocle(void) {
+    printf("Testing monocle zones...\n");
+
+    DisplayManager *display = setup_two_monitors();
+    map_and_commit(0x100);
+    map_and_commit(0x101);
+    map_and_commit(0x102);
+    assert(!client_is_iconic(display, 0x100));
+
+    /* Only the current window stays mapped; our unmaps are not withdrawals */
+    send_command(display, CMD_TOGGLE_MONOCLE);
+    commit_batch();
+    drain_server_events();
+    assert(count_managed_clients(display) == 3);
+    assert(!fake_window(0x100)->mapped && !fake_window(0x101)->mapped);
+    assert(fake_window(0x102)->mapped);
+    assert(client_is_iconic(display, 0x100) && !client_is_iconic(display, 0x102));
+
+    /* Cycling maps the new window before unmapping the old one */
+    send_command(display, CMD_CYCLE_WINDOW_NEXT);
+    commit_batch();
+    drain_server_events();
+    Window shown = fake_focus();
+    assert(shown != 0x102 && fake_window(shown)->mapped);
+    assert(!fake_window(0x102)->mapped);
+    assert(fake_window(shown)->map_serial < fake_window(0x102)->unmap_serial);
+    assert(count_managed_clients(display) == 3);
+
+    /* New windows in a monocle zone hide the previous current one */
+    map_and_commit(0x103);
+    drain_server_events();
+    assert(fake_window(0x103)->mapped && !fake_window(shown)->mapped);
+
+    /* A hidden window mapping itself is shown, not managed a second time */
+    map_and_commit(shown);
+    drain_server_events();
+    assert(count_managed_clients(display) == 4 && fake_focus() == shown);
+    assert(fake_window(shown)->mapped && !fake_window(0x103)->mapped);
+    map_and_commit(0x103);
+    drain_server_events();
+    assert(count_managed_clients(display) == 4 && fake_focus() == 0x103);
+
+    /* Hiding and showing within one batch sends nothing */
+    fake_stats_reset();
+    send_command(display, CMD_TOGGLE_MONOCLE);
+    send_command(display, CMD_TOGGLE_MONOCLE);
+    commit_batch();
+    assert(fake_stats.ops[FAKE_MAP] == 0 && fake_stats.ops[FAKE_UNMAP] == 0);
+    XEvent event;
+    while (fake_next_event(&event)) {
+        assert(event.type == PropertyNotify && event.xproperty.state == PropertyDelete);
+    }
+
+    /* A hidden client withdrawing sends a synthetic UnmapNotify */
+    XEvent withdraw = {0};
+    withdraw.xunmap.type = UnmapNotify;
+    withdraw.xunmap.window = 0x100;
+    withdraw.xunmap.send_event = True;
+    dispatch_event(&withdraw);
+    assert(find_client_by_window(display, 0x100) == NULL);
+
+    /* A hidden client being destroyed only produces DestroyNotify */
+    fake_destroy_window(0x101);
+    XEvent destroy = {0};
+    destroy.xdestroywindow.type = DestroyNotify;
+    destroy.xdestroywindow.window = 0x101;
+    dispatch_event(&destroy);
+    assert(find_client_by_window(display, 0x101) == NULL);
+    commit_batch();
+
+    /* Leaving monocle maps everything again */
+    send_command(display, CMD_TOGGLE_MONOCLE);
+    commit_batch();
+    assert(fake_window(0x102)->mapped && fake_window(0x103)->mapped);
+    assert(!client_is_iconic(display, 0x102));
+    for (int zone = 0; zone < display->zone_count; zone++) {
+        for (Client *client = display->zone_clients[zone]; client; client = client->next) {
+            assert(!client->hidden && client->ignore_unmap == 0);
+        }
+    }
+
+    teardown(display);
+    printf("✓ Monocle test passed\n");
+}
+
+void test_multiple_screens(void) {
+    printf("Testing windows and monitor cycling across X screens...\n");
+
+    DisplayManager *first = setup_two_monitors();
+    XineramaScreenInfo monitor = {0, 0, 0, 1280, 1024};
+    LogicalZone *zones = NULL;
+    int zone_count = calculate_zones(&monitor, 1, &zones);
+    DisplayManager *second = fake_screen_manager(1, 0x2, zones, zone_count);
+    first->next = second;
+    wm.display_count = 2;
+
+    /* Windows go to the screen whose root they were created on */
+    send_map_request_on(first->root, 0x100);
+    commit_batch();
+    send_map_request_on(second->root, 0x200);
+    commit_batch();
+    assert(find_client_by_window(first, 0x100) != NULL);
+    assert(find_client_by_window(second, 0x200) != NULL);
+    assert(find_client_by_window(first, 0x200) == NULL);
+    assert(fake_window(0x200)->width == 1280 - 2 * BORDER_WIDTH);
+    assert(wm.active_display == second);
+    assert(fake_focus() == 0x200);
+    assert(fake_window(0x100)->border_color == UNFOCUS_COLOR);
+    assert(fake_window(0x200)->border_color == FOCUS_COLOR);
+
+    /* Only the screen holding focus has an active window */
+    FakeProperty *active = fake_get_property(first->root, first->net_atoms[NET_ACTIVE_WINDOW]);
+    assert(active && active->count == 1 && active->items[0] == None);
+    active = fake_get_property(second->root, second->net_atoms[NET_ACTIVE_WINDOW]);
+    assert(active && active->count == 1 && active->items[0] == 0x200);
+
+    /* Past the last zone of a screen is the first zone of the next one,
+     * and commands work from any screen's root */
+    send_command(second, CMD_CYCLE_MONITOR_RIGHT);
+    commit_batch();
+    assert(wm.active_display == first && first->active_zone == 0);
+    assert(fake_focus() == 0x100);
+    assert(fake_window(0x100)->border_color == FOCUS_COLOR);
+    assert(fake_window(0x200)->border_color == UNFOCUS_COLOR);
+
+    send_command(first, CMD_CYCLE_MONITOR_LEFT);
+    commit_batch();
+    assert(wm.active_display == second && fake_focus() == 0x200);
+
+    /* An empty zone on the next screen leaves its root focused */
+    send_command(second, CMD_CYCLE_MONITOR_LEFT);
+    commit_batch();
+    assert(wm.active_display == first && first->active_zone == 1);
+    assert(fake_focus() == first->root);
+    send_command(first, CMD_CYCLE_MONITOR_RIGHT);
+    commit_batch();
+    assert(wm.active_display == second && fake_focus() == 0x200);
+
+    /* Withdrawals are found on whichever screen manages the window, and
+     * one on an unfocused screen does not move focus */
+    send_map_request_on(first->root, 0x101);
+    commit_batch();
+    assert(wm.active_display == first && fake_focus() == 0x101);
+    send_unmap_notify(0x200);
+    commit_batch();
+    assert(find_client_by_window(second, 0x200) == NULL);
+    assert(fake_focus() == 0x101);
+
+    first->next = NULL;
+    fake_display_manager_free(second);
+    teardown(first);
+    printf("✓ Multiple screens test passed\n");
+}
+
+void test_state_export(void) {
+    printf("Testing shared-memory state export...\n");
+
+    char name[64];
+    snprintf(name, sizeof(name), "/swm-test-%d", (int)getpid());
+    assert(ipc_state_open(name));
+    const SwmState *shared = ipc_state_attach(name);
+    assert(shared != NULL);
+
+    DisplayManager *display = setup_two_monitors();
+    SwmState state;
+
+    fake_create_window(0x100);
+    fake_set_text_property(0x100, display->net_atoms[NET_WM_NAME], display->utf8_string_atom, "editor", 6);
+    /* The title fetched with the map batch is reused by the export */
+    fake_stats_reset();
+    map_and_commit(0x100);
+    assert(fake_stats.round_trips == 1);
+    assert(ipc_state_read(shared, &state) && strcmp(state.focused_title, "editor") == 0);
+    map_and_commit(0x101);
+    assert(ipc_state_read(shared, &state));
+    assert(state.magic == SWM_STATE_MAGIC && state.pid == (uint32_t)getpid());
+    assert(state.zone_count == (uint32_t)display->zone_count);
+    assert(state.focused_window == 0x101 && state.focused_title[0] == '\0');
+    assert(state.zones[0].client_count == 2 && state.zones[0].current_window == 0x101);
+    assert(state.zones[0].width == display->zones[0].geometry.width);
+    assert((state.sequence & 1) == 0);
+    uint64_t updates = state.updates;
+
+    /* Clients now report title changes */
+    assert(fake_window(0x101)->event_mask & PropertyChangeMask);
+
+    /* Nothing visible changed: no new version and no title read */
+    fake_stats_reset();
+    commit_batch();
+    assert(ipc_state_read(shared, &state) && state.updates == updates);
+    assert(fake_stats.round_trips == 0);
+
+    /* Moving focus reads the new window's title once */
+    send_command(display, CMD_CYCLE_WINDOW_NEXT);
+    commit_batch();
+    assert(ipc_state_read(shared, &state) && state.updates == updates + 1);
+    assert(state.focused_window == 0x100 && strcmp(state.focused_title, "editor") == 0);
+
+    /* Retitling the focused window is picked up through PropertyNotify */
+    fake_set_text_property(0x100, display->net_atoms[NET_WM_NAME], display->utf8_string_atom, "editor *", 8);
+    XEvent event = {0};
+    event.xproperty.type = PropertyNotify;
+    event.xproperty.window = 0x100;
+    event.xproperty.atom = display->net_atoms[NET_WM_NAME];
+    dispatch_event(&event);
+    commit_batch();
+    assert(ipc_state_read(shared, &state) && strcmp(state.focused_title, "editor *") == 0);
+
+    /* Zone switches and monocle show up per zone */
+    send_command(display, CMD_TOGGLE_MONOCLE);
+    send_command(display, CMD_CYCLE_MONITOR_RIGHT);
+    commit_batch();
+    assert(ipc_state_read(shared, &state));
+    assert(state.zones[0].monocle == 1);
+    assert(state.active_zone == display->active_zone && state.active_zone != 0);
+
+    teardown(display);
+    ipc_state_detach(shared);
+    ipc_state_close();
+    assert(ipc_state_attach(name) == NULL);
+    printf("✓ State export test passed\n");
+}
+
+/* Read every event a subscriber has been sent so far */
+static int read_events(int fd, SwmEvent *events, int max_events) {
+    int count = 0;
+    ssize_t length;
+    while (count < max_events &&
+           (length = recv(fd, &events[count], sizeof(SwmEvent), MSG_DONTWAIT)) == (ssize_t)sizeof(SwmEvent)) {
+        count++;
+    }
+    return count;
+}
+
+void test_event_subscriptions(void) {
+    printf("Testing event subscriptions...\n");
+
+    char name[64];
+    snprintf(name, sizeof(name), "/swm-test-%d", (int)getpid());
+    assert(ipc_server_open(name) >= 0);
+    int all = ipc_subscribe(name, SWM_EVENT_MASK_ALL);
+    int maps = ipc_subscribe(name, SWM_EVENT_MASK(SWM_EVENT_MAP));
+    assert(all >= 0 && maps >= 0);
+    ipc_server_dispatch();
+    assert(ipc_subscriber_count() == 2);
+
+    DisplayManager *display = setup_two_monitors();
+    SwmEvent events[64];
+
+    map_and_commit(0x100);
+    map_and_commit(0x101);
+    ipc_server_flush();
+    int count = read_events(all, events, 64);
+    assert(count == 4);
+    assert(events[0].type == SWM_EVENT_MAP && events[0].window == 0x100 && events[0].zone == 0);
+    assert(events[1].type == SWM_EVENT_FOCUS && events[1].window == 0x100);
+    assert(events[2].type == SWM_EVENT_MAP && events[3].type == SWM_EVENT_FOCUS);
+    assert(read_events(maps, events, 64) == 2);
+
+    /* A burst of commands reports where focus and the zone ended up */
+    send_command(display, CMD_MOVE_WINDOW_RIGHT);
+    send_command(display, CMD_CYCLE_MONITOR_LEFT);
+    send_command(display, CMD_CYCLE_MONITOR_RIGHT);
+    commit_batch();
+    ipc_server_flush();
+    count = read_events(all, events, 64);
+    assert(count == 2);
+    assert(events[0].type == SWM_EVENT_MOVE && events[0].window == 0x101 && events[0].zone == 1);
+    assert(events[1].type == SWM_EVENT_ZONE && events[1].zone == 1);
+    assert(read_events(maps, events, 64) == 0);
+
+    send_unmap_notify(0x101);
+    commit_batch();
+    ipc_server_flush();
+    count = read_events(all, events, 64);
+    assert(count == 2);
+    assert(events[0].type == SWM_EVENT_UNMAP && events[0].window == 0x101 && events[0].zone == 1);
+    assert(events[1].type == SWM_EVENT_FOCUS && events[1].window == None);
+
+    /* A subscriber that stops reading loses events, never blocks swm, and is
+     * told how many it lost */
+    const int flood = 100000;
+    for (int i = 0; i < flood; i++) {
+        ipc_emit(SWM_EVENT_MAP, 0x1000 + i, 0);
+        ipc_server_flush();
+    }
+    unsigned long received = 0, dropped = 0;
+    for (;;) {
+        /* Drained sockets become writable and get the rest of the queue */
+        ipc_server_dispatch();
+        ipc_server_flush();
+        count = read_events(maps, events, 64);
+        if (count == 0) break;
+        for (int i = 0; i < count; i++) {
+            assert(events[i].type == SWM_EVENT_MAP || events[i].type == SWM_EVENT_DROPPED);
+            received += events[i].type == SWM_EVENT_MAP;
+            dropped += events[i].dropped;
+        }
+    }
+    assert(dropped > 0);
+    assert(received + dropped == (unsigned long)flood);
+
+    /* A mask update split across writes takes effect once it is whole */
+    uint32_t update = SWM_EVENT_MASK(SWM_EVENT_FOCUS);
+    assert(send(maps, &update, 2, 0) == 2);
+    ipc_server_dispatch();
+    ipc_emit(SWM_EVENT_MAP, 0x200, 0);
+    ipc_server_flush();
+    assert(read_events(maps, events, 64) == 1 && events[0].type == SWM_EVENT_MAP);
+    assert(send(maps, (const char *)&update + 2, 2, 0) == 2);
+    ipc_server_dispatch();
+    ipc_emit(SWM_EVENT_MAP, 0x200, 0);
+    ipc_emit(SWM_EVENT_FOCUS, 0x200, 0);
+    ipc_server_flush();
+    assert(read_events(maps, events, 64) == 1 && events[0].type == SWM_EVENT_FOCUS);
+
+    /* Hanging up ends the subscription */
+    close(all);
+    close(maps);
+    ipc_server_dispatch();
+    assert(ipc_subscriber_count() == 0);
+
+    teardown(display);
+    ipc_server_close();
+    printf("✓ Event subscription test passed\n");
+}
+
+/* Dump the span buffer and count its begins and ends */
+static char *dump_spans(int *begins, int *ends) {
+    char path[] = "/tmp/swm-spans-XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+    assert(span_dump(path));
+
+    FILE *file = fopen(path, "r");
+    assert(file);
+    static char buffer[65536];
+    size_t length = fread(buffer, 1, sizeof(buffer) - 1, file);
+    buffer[length] = '\0';
+    fclose(file);
+    unlink(path);
+
+    *begins = *ends = 0;
+    for (const char *at = buffer; (at = strstr(at, "\"ph\":\"")); at++) {
+        if (at[6] == 'B') (*begins)++;
+        if (at[6] == 'E') (*ends)++;
+    }
+    return buffer;
+}
+
+void test_event_spans(void) {
+    printf("Testing Chrome trace spans of event handling...\n");
+
+    DisplayManager *display = setup_two_monitors();
+    assert(!span_is_active());
+    assert(span_open(256));
+    wm_use_ops(span_wrap_ops(&fake_x_ops));
+
+    /* Handlers, commands, round trips and commits each get a span */
+    map_and_commit(0x100);
+    send_command(display, CMD_CYCLE_WINDOW_NEXT);
+    commit_batch();
+    int begins, ends;
+    char *json = dump_spans(&begins, &ends);
+    assert(strncmp(json, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", 39) == 0);
+    assert(strstr(json, "\"name\":\"MapRequest\",\"cat\":\"swm\",\"ph\":\"B\""));
+    assert(strstr(json, "\"args\":{\"window\":\"0x100\"}"));
+    assert(strstr(json, "\"name\":\"get_properties\""));
+    assert(strstr(json, "\"name\":\"cycle window next\""));
+    assert(strstr(json, "\"name\":\"commit\""));
+    assert(begins > 0 && begins == ends);
+
+    /* A full ring keeps the newest spans and drops ends it lost the begin of */
+    assert(span_open(4));
+    send_command(display, CMD_CYCLE_WINDOW_NEXT);
+    commit_batch();
+    json = dump_spans(&begins, &ends);
+    assert(begins == 1 && ends == 1);
+    assert(strstr(json, "\"name\":\"commit\"") && !strstr(json, "PropertyNotify"));
+
+    span_close();
+    assert(!span_dump("/nonexistent"));
+    teardown(display);
+    printf("✓ Event spans test passed\n");
+}
+
+#if FOCUS_FOLLOWS_MOUSE
+void test_self_inflicted_enter(void) {
+    printf("Testing crossing events caused by swm are ignored...\n");
+
+    DisplayManager *display = setup_two_monitors();
+    map_and_commit(0x100);
+    map_and_commit(0x101);
+    fake_warp_pointer(960, 540);
+    drain_server_events();
+    assert(fake_focus() == 0x101);
+
+    /* Moving the focused window away uncovers 0x100 under the pointer */
+    send_command(display, CMD_MOVE_WINDOW_RIGHT);
+    commit_batch();
+    drain_server_events();
+    assert(display->active_zone == 1 && fake_focus() == 0x101);
+
+    /* Keyboard cycling with the pointer resting on the zone keeps the
+     * keyboard's choice */
+    map_and_commit(0x102);
+    drain_server_events();
+    fake_warp_pointer(1920 + 960, 540);
+    drain_server_events();
+    for (int i = 0; i < 5; i++) {
+        send_command(display, CMD_CYCLE_WINDOW_NEXT);
+        commit_batch();
+        Window chosen = fake_focus();
+        drain_server_events();
+        assert(fake_focus() == chosen);
+    }
+
+    /* Real pointer motion still focuses */
+    fake_warp_pointer(960, 540);
+    drain_server_events();
+    assert(display->active_zone == 0 && fake_focus() == 0x100);
+
+    /* Grab and inferior crossings never do */
+    XEvent event = {0};
+    event.xcrossing.type = EnterNotify;
+    event.xcrossing.window = 0x101;
+    event.xcrossing.serial = 1000000;
+    event.xcrossing.mode = NotifyGrab;
+    dispatch_event(&event);
+    event.xcrossing.mode = NotifyNormal;
+    event.xcrossing.detail = NotifyInferior;
+    dispatch_event(&event);
+    commit_batch();
+    assert(fake_focus() == 0x100);
+
+    teardown(display);
+    printf("✓ Self-inflicted EnterNotify test passed\n");
+}
+
+void test_enter_after_layout(void) {
+    printf("Testing crossing events right after a layout burst...\n");
+
+    XineramaScreenInfo monitors[] = {{0, 0, 0, 5120, 1440}};
+    DisplayManager *display = setup(monitors, 1);
+    map_and_commit(0x100);
+    send_command_argument(display, CMD_FOCUS_ZONE, 1);
+    map_and_commit(0x101);
+    assert(fake_focus() == 0x101);
+
+    /* A split move leaves focus alone, so only a no-op closes the burst;
+     * the pointer entering a window right after is real motion */
+    fake_stats_reset();
+    send_command_arguments(display, CMD_SET_SPLIT, 0, 1600);
+    commit_batch();
+    assert(fake_stats.ops[FAKE_MOVE_RESIZE] == 2 && fake_stats.ops[FAKE_SET_FOCUS] == 0);
+    assert(fake_stats.ops[FAKE_NO_OPERATION] == 1);
+    fake_warp_pointer(800, 720);
+    drain_server_events();
+    assert(display->active_zone == 0 && fake_focus() == 0x100);
+
+    /* A burst that ends in a focus request needs no no-op */
+    fake_stats_reset();
+    send_command(display, CMD_CYCLE_MONITOR_RIGHT);
+    send_command_arguments(display, CMD_SET_SPLIT, 0, 1280);
+    commit_batch();
+    assert(fake_stats.ops[FAKE_SET_FOCUS] == 1 && fake_stats.ops[FAKE_NO_OPERATION] == 0);
+
+    teardown(display);
+    printf("✓ Enter after layout test passed\n");
+}
+
+#if FOCUS_DWELL_MS > 0
+void test_focus_dwell(void) {
+    printf("Testing focus follows the pointer only once it rests...\n");
+
+    DisplayManager *display = setup_two_monitors();
+    map_and_commit(0x100);
+    map_and_commit(0x101);
+    map_and_commit(0x102);
+    assert(fake_focus() == 0x102);
+
+    /* Sweeping across windows sends nothing until the pointer stops */
+    fake_stats_reset();
+    send_enter_notify(0x100);
+    commit_batch();
+    send_enter_notify(0x101);
+    commit_batch();
+    timer_wheel_advance(&wm.timers, wm.timers.current_tick + FOCUS_DWELL_MS / TIMER_TICK_MS - 1);
+    commit_batch();
+    assert(fake_stats.requests == 0 && fake_focus() == 0x102);
+
+    /* Then only the window it stopped in is focused */
+    rest_pointer();
+    assert(fake_focus() == 0x101);
+    assert(fake_stats.ops[FAKE_SET_FOCUS] == 1);
+    assert(fake_window(0x100)->border_color == UNFOCUS_COLOR);
+
+    /* Coming back to the focused window drops the pending change */
+    send_enter_notify(0x100);
+    send_enter_notify(0x101);
+    commit_batch();
+    rest_pointer();
+    assert(fake_focus() == 0x101);
+    assert(wm.timers.active_count == 0);
+
+    /* The keyboard moves focus at once and is not overridden afterwards */
+    send_enter_notify(0x100);
+    send_command_argument(display, CMD_FOCUS_WINDOW, 0x102);
+    commit_batch();
+    assert(fake_focus() == 0x102);
+    rest_pointer();
+    assert(fake_focus() == 0x102);
+
+    /* A window that goes away while the pointer rests in it is forgotten */
+    send_enter_notify(0x100);
+    send_unmap_notify(0x100);
+    commit_batch();
+    fake_stats_reset();
+    rest_pointer();
+    assert(fake_stats.requests == 0 && fake_focus() == 0x102);
+
+    teardown(display);
+    printf("✓ Focus dwell test passed\n");
+}
+#endif
+#endif
+
+/* Benchmarks */
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+typedef struct {
+    uint64_t elapsed_ns;
+    FakeStats stats;
+} BenchResult;
+
+static void report(const char *name, int iterations, BenchResult *result) {
+    printf("  %-16s %8.2fus/op  %5.1f requests/op  %4.1f round trips/op\n", name,
+           result->elapsed_ns / 1000.0 / iterations,
+           (double)result->stats.requests / iterations,
+           (double)result->stats.round_trips / iterations);
+}
+
+static void bench_begin(void) {
+    silence_debug_output(true);
+    fake_stats_reset();
+}
+
+static void bench_end(BenchResult *result, uint64_t start) {
+    result->elapsed_ns = monotonic_ns() - start;
+    result->stats = fake_stats;
+    silence_debug_output(false);
+}
+
+void benchmark_handlers(void) {
+    printf("Benchmarking handlers against the fake server...\n");
+
+    enum { WINDOWS = 32, ITERATIONS = 10000 };
+    DisplayManager *display = setup_two_monitors();
+    BenchResult result;
+    uint64_t start;
+
+    bench_begin();
+    start = monotonic_ns();
+    for (int i = 0; i < ITERATIONS; i++) {
+        Window window = 0x1000 + (i % WINDOWS);
+        if (find_client_by_window(display, window)) {
+            send_unmap_notify(window);
+        }
+        map_and_commit(window);
+    }
+    bench_end(&result, start);
+    report("map (+unmap)", ITERATIONS, &result);
+
+    bench_begin();
+    start = monotonic_ns();
+    for (int i = 0; i < ITERATIONS; i++) {
+        send_command(display, CMD_CYCLE_WINDOW_NEXT);
+        commit_batch();
+        deliver_server_events();
+    }
+    bench_end(&result, start);
+    report("cycle window", ITERATIONS, &result);
+
+    bench_begin();
+    start = monotonic_ns();
+    for (int i = 0; i < ITERATIONS; i++) {
+        send_command(display, i % 2 ? CMD_MOVE_WINDOW_LEFT : CMD_MOVE_WINDOW_RIGHT);
+        commit_batch();
+        deliver_server_events();
+    }
+    bench_end(&result, start);
+    report("move window", ITERATIONS, &result);
+
+#if FOCUS_FOLLOWS_MOUSE
+    bench_begin();
+    start = monotonic_ns();
+    for (int i = 0; i < ITERATIONS; i++) {
+        send_enter_notify(0x1000 + (i * 7) % WINDOWS);
+        rest_pointer();
+    }
+    bench_end(&result, start);
+    report("enter notify", ITERATIONS, &result);
+#else
+    (void)send_enter_notify;
+#endif
+
+    teardown(display);
+    printf("✓ Handler benchmarks completed\n");
+}
+
+int main(void) {
+    printf("Running SWM event handler tests...\n\n");
+
+    test_map_request();
+    test_cycle_and_unmap();
+    test_monitor_cycle_no_restack();
+    test_kill_deadline();
+    test_move_window();
+    test_direct_commands();
+    test_bulk_zone_commands();
+    test_command_queue();
+    test_command_macros();
+    test_ewmh_coalescing();
+    test_handler_budgets();
+    test_window_rules_at_map();
+#if AUTO_FLOAT
+    test_floating_windows();
+#endif
+#if DOCK_STRUTS
+    test_docks();
+#endif
+    test_reload_settings();
+    test_zone_split_commands();
+    test_key_bindings();
+    test_monocle();
+    test_multiple_screens();
+    test_state_export();
+    test_event_subscriptions();
+    test_event_spans();
+#if FOCUS_FOLLOWS_MOUSE
+    test_self_inflicted_enter();
+    test_enter_after_layout();
+#if FOCUS_DWELL_MS > 0
+    test_focus_dwell();
+#endif
+#endif
+    printf("\n");
+    benchmark_handlers();
+
+    printf("\n✓ All event handler tests passed!\n");
+    return 0;
+}
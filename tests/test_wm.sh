@@ -256,6 +256,46 @@ test_multiple_windows() {
     success "Multiple window test completed"
 }
 
+test_ewmh_properties() {
+    log "Testing EWMH root properties..."
+    
+    if ! DISPLAY="$XVFB_DISPLAY" xprop -root _NET_SUPPORTING_WM_CHECK | grep -q "window id"; then
+        error "_NET_SUPPORTING_WM_CHECK is not set"
+        return 1
+    fi
+    success "_NET_SUPPORTING_WM_CHECK is set"
+    
+    DISPLAY="$XVFB_DISPLAY" "$SCRIPT_DIR/test_client" 10 &
+    PID1=$!
+    DISPLAY="$XVFB_DISPLAY" "$SCRIPT_DIR/test_client" 10 &
+    PID2=$!
+    sleep 1
+    
+    local client_count
+    client_count=$(DISPLAY="$XVFB_DISPLAY" xprop -root _NET_CLIENT_LIST | grep -o "0x[0-9a-f]*" | wc -l)
+    if [ "$client_count" -ge 2 ]; then
+        success "_NET_CLIENT_LIST lists $client_count windows"
+    else
+        error "_NET_CLIENT_LIST lists $client_count windows, expected at least 2"
+        kill "$PID1" "$PID2" 2>/dev/null || true
+        return 1
+    fi
+    
+    local active
+    active=$(DISPLAY="$XVFB_DISPLAY" xprop -root _NET_ACTIVE_WINDOW | grep -o "0x[0-9a-f]*")
+    if [ -n "$active" ] && [ "$active" != "0x0" ]; then
+        success "_NET_ACTIVE_WINDOW is $active"
+    else
+        error "_NET_ACTIVE_WINDOW is not set"
+        kill "$PID1" "$PID2" 2>/dev/null || true
+        return 1
+    fi
+    
+    kill "$PID1" "$PID2" 2>/dev/null || true
+    sleep 0.5
+    success "EWMH property test completed"
+}
+
 test_window_movement() {
     log "Testing window movement functionality..."
     
@@ -715,6 +755,7 @@ main() {
         
         if [ "$BASIC_ONLY" = false ]; then
             test_multiple_windows || exit 1
+            test_ewmh_properties || exit 1
             test_window_movement || exit 1
             test_kill_window_functionality || exit 1
         fi
@@ -0,0 +1,2221 @@
+#define _DEFAULT_SOURCE  /* For clock_gettime */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <time.h>
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+#include <X11/keysym.h>
+#include "config.h"
+#include "core.h"
+#include "record.h"
+#include "ipc.h"
+#include "span.h"
+#include "xops.h"
+#include "wm.h"
+
+/* Window management policy
+ *
+ * Event handlers and commands live here and reach the X server only through
+ * the XOps table, so they run unchanged against the in-memory fake server in
+ * tests/fake_x.c. */
+
+/* Global state */
+WindowManager wm = {0};
+const XOps *xops = NULL;
+
+/* Last state exported to shared memory, and the title it carries */
+static SwmState exported_state;
+static Window title_window = None;
+static bool title_stale = false;
+
+/* Title of a window mapped this batch, fetched with its other properties */
+static Window mapped_title_window = None;
+static char mapped_title[SWM_STATE_TITLE_MAX];
+
+/* Focus and active zone as last reported to subscribers */
+static Window streamed_focus = None;
+static int streamed_zone = 0;
+static DisplayManager *streamed_display = NULL;
+
+/* Some display's _SWM_COMMAND queue is waiting to be read */
+static bool commands_pending = false;
+
+/* Strut changes of docks wait here until they stop */
+static Timer strut_settle_timer;
+static void strut_settle_expired(Timer *timer);
+
+#if FOCUS_FOLLOWS_MOUSE
+/* Window the pointer entered, focused once it has rested there */
+static Timer focus_dwell_timer;
+static Window focus_dwell_window = None;
+static void focus_dwell_expired(Timer *timer);
+static void cancel_focus_dwell(void);
+
+/* What a crossing into another client does, resolved from the settings:
+ * nothing, focus at once, or focus once the pointer rests */
+static void (*enter_policy)(Window window) = NULL;
+static void focus_under_pointer(Window window);
+static void start_focus_dwell(Window window);
+#endif
+static void resolve_policies(void);
+
+void wm_init(const XOps *ops) {
+    wm_use_ops(ops);
+    timer_wheel_init(&wm.timers, now_tick());
+    txn_init(&wm.txn);
+    wm.self_crossing = (SerialRanges){0};
+    memset(wm.stats, 0, sizeof(wm.stats));
+    memset(&exported_state, 0, sizeof(exported_state));
+    title_window = None;
+    title_stale = false;
+    mapped_title_window = None;
+    commands_pending = false;
+    streamed_focus = None;
+    streamed_zone = 0;
+    streamed_display = NULL;
+    timer_init(&strut_settle_timer, strut_settle_expired, NULL);
+#if FOCUS_FOLLOWS_MOUSE
+    timer_init(&focus_dwell_timer, focus_dwell_expired, NULL);
+    focus_dwell_window = None;
+#endif
+    settings_defaults(&wm.settings);
+    resolve_policies();
+    wm.running = true;
+}
+
+void wm_cleanup(void) {
+    txn_free(&wm.txn);
+    rules_free(&wm.rules);
+    keys_free(&wm.keys);
+}
+
+/* Handler statistics
+ *
+ * Every handler invocation is bracketed by the request serial and the
+ * number of replies waited for, so a change that adds a blocking round trip
+ * shows up in the numbers (and fails the budgets in `make test`) instead of
+ * as vague input lag. Requests a handler defers to the transaction are
+ * counted under commit. */
+
+typedef struct {
+    unsigned long requests;
+    unsigned long round_trips;
+} XCost;
+
+static const char *stats_names[STATS_COMMAND] = {
+    [STATS_MAP]          = "map",
+    [STATS_UNMAP]        = "unmap",
+    [STATS_DESTROY]      = "destroy",
+    [STATS_ENTER]        = "enter",
+    [STATS_MESSAGE]      = "message",
+    [STATS_COMMAND_READ] = "command read",
+    [STATS_COMMIT]       = "commit",
+    [STATS_STRUTS]       = "struts",
+};
+
+static const char *command_names[CMD_COUNT] = {
+    [CMD_CYCLE_WINDOW]        = "cycle window",
+    [CMD_CYCLE_MONITOR]       = "cycle monitor",
+    [CMD_CYCLE_WINDOW_NEXT]   = "cycle window next",
+    [CMD_CYCLE_WINDOW_PREV]   = "cycle window prev",
+    [CMD_CYCLE_MONITOR_LEFT]  = "cycle monitor left",
+    [CMD_CYCLE_MONITOR_RIGHT] = "cycle monitor right",
+    [CMD_KILL_WINDOW]         = "kill window",
+    [CMD_QUIT]                = "quit",
+    [CMD_MOVE_WINDOW_LEFT]    = "move window left",
+    [CMD_MOVE_WINDOW_RIGHT]   = "move window right",
+    [CMD_TOGGLE_MONOCLE]      = "toggle monocle",
+    [CMD_FOCUS_ZONE]          = "focus zone",
+    [CMD_MOVE_WINDOW_TO_ZONE] = "move window to zone",
+    [CMD_FOCUS_WINDOW]        = "focus window",
+    [CMD_SWAP_FIRST]          = "swap first",
+    [CMD_MOVE_ZONE_WINDOWS]   = "move zone windows",
+    [CMD_CLOSE_ZONE_WINDOWS]  = "close zone windows",
+    [CMD_GATHER_WINDOWS]      = "gather windows",
+    [CMD_RUN_MACRO]           = "run macro",
+    [CMD_RELOAD_SETTINGS]     = "reload settings",
+    [CMD_MOVE_SPLIT]          = "move split",
+    [CMD_SET_SPLIT]           = "set split",
+};
+
+/* Arguments that follow each command in the _SWM_COMMAND queue */
+static const int command_argument_counts[CMD_COUNT] = {
+    [CMD_FOCUS_ZONE]          = 1,
+    [CMD_MOVE_WINDOW_TO_ZONE] = 1,
+    [CMD_FOCUS_WINDOW]        = 1,
+    [CMD_MOVE_ZONE_WINDOWS]   = 2,
+    [CMD_CLOSE_ZONE_WINDOWS]  = 1,
+    [CMD_RUN_MACRO]           = 1,
+    [CMD_MOVE_SPLIT]          = 2,
+    [CMD_SET_SPLIT]           = 2,
+};
+
+/* Most any single invocation may cost with the default configuration.
+ * Map sends every property read that floating, docks and window rules
+ * need, plus the geometry, as one batch and waits on it once; rules can
+ * add reads to that batch but never another round trip. */
+typedef struct {
+    int slot;
+    int max_round_trips;          /* -1: depends on the number of windows */
+    int max_requests;             /* -1: depends on the number of windows */
+} HandlerBudget;
+
+static const HandlerBudget handler_budgets[] = {
+    {STATS_MAP,                                   1,  7},
+    {STATS_UNMAP,                                 0,  0},
+    {STATS_DESTROY,                               0,  0},
+    {STATS_ENTER,                                 0,  0},
+    {STATS_MESSAGE,                               1,  2},
+    {STATS_COMMAND_READ,                          1,  1},
+    {STATS_COMMIT,                                1, -1},
+    {STATS_STRUTS,                               -1, -1},
+    {STATS_COMMAND + CMD_CYCLE_WINDOW,            0,  0},
+    {STATS_COMMAND + CMD_CYCLE_MONITOR,           0,  0},
+    {STATS_COMMAND + CMD_CYCLE_WINDOW_NEXT,       0,  0},
+    {STATS_COMMAND + CMD_CYCLE_WINDOW_PREV,       0,  0},
+    {STATS_COMMAND + CMD_CYCLE_MONITOR_LEFT,      0,  0},
+    {STATS_COMMAND + CMD_CYCLE_MONITOR_RIGHT,     0,  0},
+    {STATS_COMMAND + CMD_KILL_WINDOW,             1,  2},
+    {STATS_COMMAND + CMD_QUIT,                    0,  0},
+    {STATS_COMMAND + CMD_MOVE_WINDOW_LEFT,        0,  0},
+    {STATS_COMMAND + CMD_MOVE_WINDOW_RIGHT,       0,  0},
+    {STATS_COMMAND + CMD_TOGGLE_MONOCLE,          0, -1},
+    {STATS_COMMAND + CMD_FOCUS_ZONE,              0,  0},
+    {STATS_COMMAND + CMD_MOVE_WINDOW_TO_ZONE,     0,  0},
+    {STATS_COMMAND + CMD_FOCUS_WINDOW,            0,  0},
+    {STATS_COMMAND + CMD_SWAP_FIRST,              0,  0},
+    {STATS_COMMAND + CMD_MOVE_ZONE_WINDOWS,       0,  0},
+    {STATS_COMMAND + CMD_CLOSE_ZONE_WINDOWS,     -1, -1},
+    {STATS_COMMAND + CMD_GATHER_WINDOWS,          0,  0},
+    {STATS_COMMAND + CMD_RUN_MACRO,              -1, -1},
+    {STATS_COMMAND + CMD_RELOAD_SETTINGS,         0, -1},
+    {STATS_COMMAND + CMD_MOVE_SPLIT,              0,  0},
+    {STATS_COMMAND + CMD_SET_SPLIT,               0,  0},
+};
+
+/* Round trips are counted here rather than by each backend: every op that
+ * waits for a reply is reached through one of these wrappers, so a new
+ * reply-bearing call cannot slip past the budgets uncounted */
+
+static const XOps *backend_ops = NULL;
+static XOps counted_ops;
+static unsigned long round_trips = 0;
+
+static bool counted_window_exists(Display *display, Window window) {
+    round_trips++;
+    return backend_ops->window_exists(display, window);
+}
+
+static bool counted_get_size(Display *display, Window window, int *width, int *height) {
+    round_trips++;
+    return backend_ops->get_size(display, window, width, height);
+}
+
+static int counted_get_property32(Display *display, Window window, Atom property, Atom type,
+                                  bool delete, long *items, int max_items) {
+    round_trips++;
+    return backend_ops->get_property32(display, window, property, type, delete, items, max_items);
+}
+
+static int counted_take_property32(Display *display, Window window, Atom property, Atom type,
+                                   long **items) {
+    round_trips++;
+    return backend_ops->take_property32(display, window, property, type, items);
+}
+
+static int counted_get_text_property(Display *display, Window window, Atom property, Atom type,
+                                     char *buffer, int size) {
+    round_trips++;
+    return backend_ops->get_text_property(display, window, property, type, buffer, size);
+}
+
+/* The whole batch is one round trip */
+static void counted_get_properties(Display *display, Window window, PropertyRead *reads, int count,
+                                   int *width, int *height) {
+    if (count > 0 || width) round_trips++;
+    backend_ops->get_properties(display, window, reads, count, width, height);
+}
+
+static Atom counted_intern_atom(Display *display, const char *name) {
+    round_trips++;
+    return backend_ops->intern_atom(display, name);
+}
+
+static unsigned int counted_numlock_mask(Display *display) {
+    round_trips++;
+    return backend_ops->numlock_mask(display);
+}
+
+void wm_use_ops(const XOps *ops) {
+    backend_ops = ops;
+    counted_ops = *ops;
+    counted_ops.window_exists = counted_window_exists;
+    counted_ops.get_size = counted_get_size;
+    counted_ops.get_property32 = counted_get_property32;
+    counted_ops.take_property32 = counted_take_property32;
+    counted_ops.get_text_property = counted_get_text_property;
+    counted_ops.get_properties = counted_get_properties;
+    counted_ops.intern_atom = counted_intern_atom;
+    counted_ops.numlock_mask = counted_numlock_mask;
+    xops = &counted_ops;
+}
+
+static XCost x_cost_now(void) {
+    XCost cost = {0, round_trips};
+    if (wm.active_display) {
+        cost.requests = xops->next_request(wm.active_display->x_display);
+    }
+    return cost;
+}
+
+static void stats_account(int slot, XCost start) {
+    XCost end = x_cost_now();
+    HandlerStats *stats = &wm.stats[slot];
+    unsigned long requests = end.requests - start.requests;
+    unsigned long round_trips = end.round_trips - start.round_trips;
+    
+    stats->calls++;
+    stats->requests += requests;
+    stats->round_trips += round_trips;
+    if (requests > stats->max_requests) stats->max_requests = requests;
+    if (round_trips > stats->max_round_trips) stats->max_round_trips = round_trips;
+}
+
+const char *stats_name(int slot) {
+    if (slot >= STATS_COMMAND) {
+        const char *name = command_names[slot - STATS_COMMAND];
+        return name ? name : "unknown command";
+    }
+    return stats_names[slot];
+}
+
+void print_handler_stats(FILE *out) {
+    fprintf(out, "%-20s %9s %12s %8s %12s %8s\n", "handler", "calls",
+            "requests/op", "max", "round trips", "max");
+    for (int slot = 0; slot < STATS_COUNT; slot++) {
+        HandlerStats *stats = &wm.stats[slot];
+        if (!stats->calls) continue;
+        fprintf(out, "%-20s %9lu %12.2f %8lu %12lu %8lu\n", stats_name(slot), stats->calls,
+                (double)stats->requests / stats->calls, stats->max_requests,
+                stats->round_trips, stats->max_round_trips);
+    }
+    fflush(out);
+}
+
+int check_handler_budgets(FILE *out) {
+    int violations = 0;
+    for (size_t i = 0; i < sizeof(handler_budgets) / sizeof(handler_budgets[0]); i++) {
+        const HandlerBudget *budget = &handler_budgets[i];
+        HandlerStats *stats = &wm.stats[budget->slot];
+        if (budget->max_round_trips >= 0 && stats->max_round_trips > (unsigned long)budget->max_round_trips) {
+            fprintf(out, "Budget exceeded: %s took %lu round trips, budget %d\n",
+                    stats_name(budget->slot), stats->max_round_trips, budget->max_round_trips);
+            violations++;
+        }
+        if (budget->max_requests >= 0 && stats->max_requests > (unsigned long)budget->max_requests) {
+            fprintf(out, "Budget exceeded: %s sent %lu requests, budget %d\n",
+                    stats_name(budget->slot), stats->max_requests, budget->max_requests);
+            violations++;
+        }
+    }
+    return violations;
+}
+
+/* Window rules */
+
+#define RULE(class_name, instance, title, type, zone, floating, focus) \
+    {class_name, instance, title, type, zone, floating, focus},
+static const WindowRule config_rules[] = {
+    WINDOW_RULES
+    {NULL, NULL, NULL, NULL, -1, false, true}  /* Terminator, never matched */
+};
+#undef RULE
+
+/* Compile a rule table and resolve the window types it names */
+void load_window_rules(DisplayManager *display, const WindowRule *rules, int count) {
+    rules_free(&wm.rules);
+    rules_compile(&wm.rules, rules, count);
+    
+    for (int i = 0; i < count; i++) {
+        if (rules[i].type) {
+            wm.rules.type_atoms[i] = xops->intern_atom(display->x_display, rules[i].type);
+        }
+    }
+    
+    printf("[DEBUG] load_window_rules: %d rules loaded\n", count);
+    fflush(stdout);
+}
+
+void load_config_rules(DisplayManager *display) {
+    int count = sizeof(config_rules) / sizeof(config_rules[0]) - 1;
+    load_window_rules(display, config_rules, count);
+}
+
+/* Floating windows
+ *
+ * Transients, dialog-like windows and windows that cannot be resized keep
+ * the size they asked for, centered over their zone and stacked above its
+ * tiled windows, instead of being stretched to fill it. Docks are told
+ * apart by the same window type.
+ *
+ * Everything classification, the window rules and the state export need
+ * from a new window is fetched in one get_properties() batch, each
+ * property once, so a map waits on a single round trip however many of
+ * them look at it. */
+
+typedef struct {
+    bool floating;
+    bool dock;                    /* _NET_WM_WINDOW_TYPE_DOCK, kept out of the zones */
+    Window transient_for;
+    int width, height;            /* Size a floating window keeps, 0 when not known */
+    long types[RULE_MAX_TYPES];
+    int type_count;
+    char class_hint[256];         /* WM_CLASS: "instance\0class\0" */
+    int class_length;             /* -1 when WM_CLASS was not read */
+    char title[256];
+    bool title_read;
+} WindowClass;
+
+static bool is_floating_type(DisplayManager *display, Atom type) {
+    return type == display->net_atoms[NET_WM_WINDOW_TYPE_DIALOG] ||
+           type == display->net_atoms[NET_WM_WINDOW_TYPE_UTILITY] ||
+           type == display->net_atoms[NET_WM_WINDOW_TYPE_SPLASH] ||
+           type == display->net_atoms[NET_WM_WINDOW_TYPE_TOOLBAR];
+}
+
+static PropertyRead *add_read(PropertyRead *reads, int *count, Atom property, Atom type,
+                              int format, void *data, int size) {
+    assert(*count < PROPERTY_READS_MAX);
+    reads[*count] = (PropertyRead){property, type, format, data, size, -1};
+    return &reads[(*count)++];
+}
+
+static void copy_title(char *title, int size, const char *source) {
+    int length = strlen(source);
+    if (length > size - 1) length = size - 1;
+    memcpy(title, source, length);
+    title[length] = '\0';
+}
+
+/* _NET_WM_NAME, else the WM_NAME fetched alongside it */
+static void take_title(const PropertyRead *net_name, const PropertyRead *name, char *title, int size) {
+    const PropertyRead *read = net_name->count > 0 ? net_name : name;
+    copy_title(title, size, read->count > 0 ? (const char *)read->data : "");
+}
+
+static void classify_window(DisplayManager *display, Window window, WindowClass *class) {
+    memset(class, 0, sizeof(*class));
+    class->transient_for = None;
+    class->class_length = -1;
+    
+    unsigned int needs = wm.rules.count > 0 ? wm.rules.needs : 0;
+    bool want_types = AUTO_FLOAT || DOCK_STRUTS || (needs & RULE_NEEDS_TYPE);
+    bool want_size = AUTO_FLOAT || (needs & RULE_NEEDS_SIZE);
+    bool want_title = (needs & RULE_NEEDS_TITLE) || ipc_state_is_active();
+    
+    PropertyRead reads[PROPERTY_READS_MAX];
+    int count = 0;
+    long transient_for = None;
+    /* flags, x, y, width, height, min_width, min_height, max_width, max_height */
+    long hints[9];
+    char net_name[256], name[256];
+    PropertyRead *transient_read = NULL, *hints_read = NULL, *types_read = NULL;
+    PropertyRead *class_read = NULL, *net_name_read = NULL, *name_read = NULL;
+    
+    if (AUTO_FLOAT) {
+        transient_read = add_read(reads, &count, XA_WM_TRANSIENT_FOR, XA_WINDOW, 32, &transient_for, 1);
+        hints_read = add_read(reads, &count, XA_WM_NORMAL_HINTS, XA_WM_SIZE_HINTS, 32, hints, 9);
+    }
+    if (want_types) {
+        types_read = add_read(reads, &count, display->net_atoms[NET_WM_WINDOW_TYPE], XA_ATOM, 32,
+                              class->types, RULE_MAX_TYPES);
+    }
+    if (needs & RULE_NEEDS_CLASS) {
+        class_read = add_read(reads, &count, XA_WM_CLASS, XA_STRING, 8,
+                              class->class_hint, sizeof(class->class_hint));
+    }
+    if (want_title) {
+        net_name_read = add_read(reads, &count, display->net_atoms[NET_WM_NAME],
+                                 display->utf8_string_atom, 8, net_name, sizeof(net_name));
+        name_read = add_read(reads, &count, XA_WM_NAME, AnyPropertyType, 8, name, sizeof(name));
+    }
+    int width = 0, height = 0;
+    if (count == 0 && !want_size) return;
+    xops->get_properties(display->x_display, window, reads, count,
+                         want_size ? &width : NULL, want_size ? &height : NULL);
+    
+    if (types_read) {
+        class->type_count = types_read->count > 0 ? types_read->count : 0;
+    }
+    if (class_read) {
+        class->class_length = class_read->count;
+    }
+    if (want_title) {
+        take_title(net_name_read, name_read, class->title, sizeof(class->title));
+        class->title_read = true;
+    }
+    
+    /* The first property that decides wins: transient, then type, then
+     * fixed size hints. A floating window without them keeps its size. */
+    if (transient_read && transient_read->count > 0 && transient_for != None) {
+        class->transient_for = (Window)transient_for;
+        class->floating = true;
+    }
+    for (int i = 0; i < class->type_count && !class->floating; i++) {
+        if (DOCK_STRUTS && (Atom)class->types[i] == display->net_atoms[NET_WM_WINDOW_TYPE_DOCK]) {
+            class->dock = true;
+            return;
+        }
+        if (AUTO_FLOAT && is_floating_type(display, (Atom)class->types[i])) {
+            class->floating = true;
+        }
+    }
+    if (!class->floating && hints_read && hints_read->count == 9 &&
+        (hints[0] & PMinSize) && (hints[0] & PMaxSize) &&
+        hints[5] > 0 && hints[6] > 0 && hints[5] == hints[7] && hints[6] == hints[8]) {
+        class->floating = true;
+        class->width = (int)hints[5];
+        class->height = (int)hints[6];
+        return;
+    }
+    class->width = width;
+    class->height = height;
+}
+
+/* Find the rule for a window being mapped, from what classify_window()
+ * fetched for it */
+static const WindowRule *match_window_rule(const WindowClass *class, Window window) {
+    if (wm.rules.count == 0) return NULL;
+    
+    WindowInfo info = {0};
+    if (class->class_length > 0) {
+        info.instance = class->class_hint;
+        int instance_length = strlen(class->class_hint);
+        if (instance_length + 1 < class->class_length) {
+            info.class_name = class->class_hint + instance_length + 1;
+        }
+    }
+    if (class->title_read && class->title[0]) {
+        info.title = class->title;
+    }
+    for (int i = 0; i < class->type_count; i++) {
+        info.types[info.type_count++] = (Atom)class->types[i];
+    }
+    
+    const WindowRule *rule = rules_match(&wm.rules, &info);
+    if (rule) {
+        printf("[DEBUG] match_window_rule: Window 0x%lx (%s/%s) matched rule %d\n", window,
+               info.class_name ? info.class_name : "-", info.instance ? info.instance : "-",
+               (int)(rule - wm.rules.rules));
+        fflush(stdout);
+    }
+    return rule;
+}
+
+/* Command macros
+ *
+ * All macros sit in one table, each ended by a zero step. Steps go through
+ * execute_command() like any other command, and since handlers only record
+ * into the transaction, a window moved twice is resized once and focus is
+ * set once, to wherever the last step left it. */
+
+typedef struct {
+    int command;
+    long argument;
+    long argument2;
+} MacroStep;
+
+#define STEP(command, argument, argument2) {command, argument, argument2},
+#define MACRO(steps) steps {0, 0, 0},
+static const MacroStep config_macros[] = {
+    MACROS
+    {0, 0, 0}  /* An empty macro ends the table */
+};
+#undef STEP
+#undef MACRO
+
+static bool running_macro = false;
+
+void run_macro(int index) {
+    if (running_macro) {
+        printf("[DEBUG] run_macro: Macro %d run from a macro, ignoring\n", index);
+        fflush(stdout);
+        return;
+    }
+    
+    /* Skip to the macro's first step */
+    const MacroStep *step = config_macros;
+    for (int i = 0; i < index && step->command; i++) {
+        while (step->command) step++;
+        step++;
+    }
+    if (index < 0 || !step->command) {
+        printf("[DEBUG] run_macro: No macro %d\n", index);
+        fflush(stdout);
+        return;
+    }
+    
+    running_macro = true;
+    for (; step->command && wm.running; step++) {
+        execute_command(step->command, step->argument, step->argument2);
+    }
+    running_macro = false;
+}
+
+/* Key bindings */
+
+#define KEY(modifiers, keysym, command) {modifiers, keysym, command, 0},
+#define KEY_ARG(modifiers, keysym, command, argument) {modifiers, keysym, command, argument},
+static const KeyBinding config_keys[] = {
+    KEY_BINDINGS
+    {0, NoSymbol, 0, 0}  /* Terminator, never grabbed */
+};
+#undef KEY
+#undef KEY_ARG
+
+/* Resolve keysyms to keycodes, index the table by keycode and grab every
+ * binding with each CapsLock/NumLock combination, so the lock keys never
+ * stop a binding from firing. Grabs go on the root of display and of every
+ * screen linked after it. */
+void load_key_bindings(DisplayManager *display, const KeyBinding *bindings, int count) {
+    Display *x_display = display->x_display;
+    
+    keys_free(&wm.keys);
+    for (DisplayManager *screen = display; screen; screen = screen->next) {
+        xops->ungrab_keys(x_display, screen->root);
+    }
+    if (count == 0) return;
+    
+    unsigned int numlock = xops->numlock_mask(x_display);
+    KeyCode *keycodes = malloc(count * sizeof(KeyCode));
+    assert(keycodes != NULL);
+    for (int i = 0; i < count; i++) {
+        keycodes[i] = xops->keysym_to_keycode(x_display, bindings[i].keysym);
+        if (keycodes[i] == 0) {
+            printf("[DEBUG] load_key_bindings: No key produces keysym 0x%lx, binding %d skipped\n",
+                   (unsigned long)bindings[i].keysym, i);
+            fflush(stdout);
+        }
+    }
+    keys_compile(&wm.keys, bindings, keycodes, count, LockMask | numlock);
+    free(keycodes);
+    
+    unsigned int lock_variants[] = {0, LockMask, numlock, numlock | LockMask};
+    int variant_count = numlock ? 4 : 2;
+    for (DisplayManager *screen = display; screen; screen = screen->next) {
+        for (int i = 0; i < count; i++) {
+            if (wm.keys.keycodes[i] == 0) continue;
+            for (int variant = 0; variant < variant_count; variant++) {
+                xops->grab_key(x_display, screen->root, wm.keys.keycodes[i],
+                               bindings[i].modifiers | lock_variants[variant]);
+            }
+        }
+    }
+}
+
+void load_config_keys(DisplayManager *display) {
+#if BUILTIN_KEYS
+    int count = sizeof(config_keys) / sizeof(config_keys[0]) - 1;
+    load_key_bindings(display, config_keys, count);
+#else
+    (void)display;
+    (void)config_keys;
+#endif
+}
+
+/* X11 helper functions
+ *
+ * These only record into the current transaction; nothing reaches the server
+ * until txn_commit() runs at the end of the event batch. */
+
+void set_window_border(Window window, unsigned long color) {
+    txn_set_border(&wm.txn, window, color);
+}
+
+/* Bring a client to the top of its zone; the server only hears about it if
+ * the zone's visible order actually changed */
+void raise_client(DisplayManager *display, Client *client) {
+    stack_raise(display, client->zone_index, client);
+}
+
+void focus_window(DisplayManager *display, Client *client) {
+    txn_focus(&wm.txn, client->window);
+    if (wm.settings.raise_on_focus) {
+        raise_client(display, client);
+    }
+}
+
+void resize_window_to_zone(Window window, LogicalZone *zone) {
+    Rectangle geometry = {
+        zone->geometry.x, zone->geometry.y,
+        zone->geometry.width - 2 * wm.settings.border_width,
+        zone->geometry.height - 2 * wm.settings.border_width
+    };
+    txn_set_geometry(&wm.txn, window, geometry);
+}
+
+/* Fill the zone, or center a floating client over it at its own size */
+void place_client_in_zone(Client *client, LogicalZone *zone) {
+    if (!client->floating) {
+        resize_window_to_zone(client->window, zone);
+        return;
+    }
+    
+    Rectangle *area = &zone->geometry;
+    int width = client->width;
+    int height = client->height;
+    if (width > area->width - 2 * wm.settings.border_width) width = area->width - 2 * wm.settings.border_width;
+    if (height > area->height - 2 * wm.settings.border_width) height = area->height - 2 * wm.settings.border_width;
+    if (width < 1) width = 1;
+    if (height < 1) height = 1;
+    
+    Rectangle geometry = {
+        area->x + (area->width - width - 2 * wm.settings.border_width) / 2,
+        area->y + (area->height - height - 2 * wm.settings.border_width) / 2,
+        width, height
+    };
+    txn_set_geometry(&wm.txn, client->window, geometry);
+}
+
+/* Push the model order of every zone whose stacking changed this batch */
+static void restack_dirty_zones(DisplayManager *display) {
+    for (int zone = 0; zone < display->zone_count; zone++) {
+        if (!display->zone_stack_dirty[zone]) continue;
+        display->zone_stack_dirty[zone] = false;
+        
+        int count = count_clients_in_zone(display, zone);
+        if (count < 2) continue;
+        
+        Window *windows = malloc(count * sizeof(Window));
+        assert(windows != NULL);
+        count = collect_zone_stack(display, zone, windows, count);
+        xops->restack(display->x_display, windows, count);
+        free(windows);
+    }
+}
+
+static void write_client_state(Display *display, Window window, long state) {
+    DisplayManager *atoms = wm.displays;  /* Atoms are the same on every screen */
+    long wm_state[2] = {state, None};
+    xops->change_property(display, window, atoms->wm_atoms[WM_STATE], atoms->wm_atoms[WM_STATE],
+                          32, wm_state, 2);
+    
+    Atom hidden = atoms->net_atoms[NET_WM_STATE_HIDDEN];
+    xops->change_property(display, window, atoms->net_atoms[NET_WM_STATE], XA_ATOM, 32, &hidden,
+                          state == IconicState ? 1 : 0);
+}
+
+/* Send a transaction as one ordered burst: input selections, geometry,
+ * borders, client states and maps, stacking, unmaps, focus, then closes and
+ * kills. Mapping before unmapping means a monocle zone never
+ * shows an empty frame between two windows. The caller owns the flush. */
+void txn_commit(Display *display, Transaction *txn) {
+    if (txn_is_empty(txn)) return;
+    
+    /* No existence checks: entries of unmanaged windows are already dropped,
+     * and a window destroyed since then only costs an ignored BadWindow */
+    
+    /* Selections go first so nothing a window does once mapped is missed */
+    for (int i = 0; i < txn->count; i++) {
+        TxnEntry *entry = &txn->entries[i];
+        if (entry->flags & TXN_INPUT) {
+            xops->select_input(display, entry->window, entry->event_mask);
+        }
+    }
+    
+    /* Everything up to focus can move windows under the pointer */
+    unsigned long layout_start = xops->next_request(display);
+    
+    for (int i = 0; i < txn->count; i++) {
+        TxnEntry *entry = &txn->entries[i];
+        if (entry->flags & TXN_GEOMETRY) {
+            xops->move_resize(display, entry->window,
+                              entry->geometry.x, entry->geometry.y,
+                              entry->geometry.width, entry->geometry.height);
+        }
+    }
+    
+    for (int i = 0; i < txn->count; i++) {
+        TxnEntry *entry = &txn->entries[i];
+        if (entry->flags & TXN_BORDER) {
+            xops->set_border(display, entry->window, entry->border_color, wm.settings.border_width);
+        }
+    }
+    
+    for (int i = 0; i < txn->count; i++) {
+        TxnEntry *entry = &txn->entries[i];
+        if (entry->flags & TXN_STATE) {
+            write_client_state(display, entry->window, entry->state);
+        }
+        if (entry->flags & TXN_MAP) {
+            xops->map(display, entry->window);
+        }
+    }
+    
+    for (DisplayManager *manager = wm.displays; manager; manager = manager->next) {
+        restack_dirty_zones(manager);
+    }
+    
+    for (int i = 0; i < txn->count; i++) {
+        TxnEntry *entry = &txn->entries[i];
+        if (entry->flags & TXN_UNMAP) {
+            xops->unmap(display, entry->window);
+        }
+    }
+    
+    /* A crossing carries the serial of the last request the server
+     * processed, so one that happens after the burst still carries the
+     * burst's last serial until another request follows. The focus request
+     * closes the burst, or a no-op when focus stays put. */
+    unsigned long layout_end = xops->next_request(display);
+    if (layout_end > layout_start) {
+        serial_ranges_add(&wm.self_crossing, layout_start, layout_end);
+    }
+    
+    if (txn->focus != None) {
+        xops->set_focus(display, txn->focus);
+    } else if (layout_end > layout_start) {
+        xops->no_operation(display);
+    }
+    
+    /* Closes and kills last: they never move anything */
+    for (int i = 0; i < txn->count; i++) {
+        TxnEntry *entry = &txn->entries[i];
+        if (entry->flags & TXN_CLOSE) {
+            xops->send_message(display, entry->window, wm.displays->wm_atoms[WM_PROTOCOLS],
+                               wm.displays->wm_atoms[WM_DELETE_WINDOW], CurrentTime);
+        }
+        if (entry->flags & TXN_KILL) {
+            xops->kill_client(display, entry->window);
+        }
+    }
+    
+    txn_reset(txn);
+}
+
+/* Current time in timer wheel ticks */
+unsigned long now_tick(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)ts.tv_sec * (1000 / TIMER_TICK_MS) +
+           (unsigned long)ts.tv_nsec / (TIMER_TICK_MS * 1000000UL);
+}
+
+/* Client management using new simplified approach */
+
+static void kill_timer_expired(Timer *timer);
+
+Client *create_client(Window window, int zone_index) {
+    Client *client = malloc(sizeof(Client));
+    assert(client != NULL);
+    
+    client->window = window;
+    client->zone_index = zone_index;
+    timer_init(&client->kill_timer, kill_timer_expired, client);
+    client->hidden = false;
+    client->ignore_unmap = 0;
+    client->floating = false;
+    client->width = 0;
+    client->height = 0;
+    client->next = NULL;
+    client->stack_next = NULL;
+    
+    return client;
+}
+
+/* Forget a client: drop it from its zone, cancel pending work and free it */
+void unmanage_client(DisplayManager *display, Client *client) {
+    ipc_emit(SWM_EVENT_UNMAP, client->window, client->zone_index);
+    remove_client_from_zone(display, client->zone_index, client);
+    timer_cancel(&wm.timers, &client->kill_timer);
+    txn_drop_window(&wm.txn, client->window);
+    free(client);
+    mark_ewmh_dirty(display, EWMH_DIRTY_CLIENT_LIST | EWMH_DIRTY_ACTIVE_WINDOW);
+}
+
+/* Monocle zones */
+
+/* ICCCM WM_STATE plus _NET_WM_STATE_HIDDEN, so hidden clients can throttle.
+ * Written at commit, once, whatever the batch toggled in between. */
+static void set_client_state(Client *client, long state) {
+    txn_set_state(&wm.txn, client->window, state);
+}
+
+/* A map still pending in this batch means the server never saw the window
+ * mapped, so hiding it just drops the map and expects no UnmapNotify */
+static void hide_client(Client *client) {
+    if (client->hidden) return;
+    client->hidden = true;
+    
+    TxnEntry *entry = txn_find(&wm.txn, client->window);
+    if (entry && (entry->flags & TXN_MAP)) {
+        entry->flags &= ~TXN_MAP;
+    } else {
+        client->ignore_unmap++;
+        txn_unmap(&wm.txn, client->window);
+    }
+    set_client_state(client, IconicState);
+}
+
+static void show_client(Client *client) {
+    if (!client->hidden) return;
+    client->hidden = false;
+    
+    TxnEntry *entry = txn_find(&wm.txn, client->window);
+    if (entry && (entry->flags & TXN_UNMAP)) {
+        entry->flags &= ~TXN_UNMAP;
+        client->ignore_unmap--;
+    } else {
+        txn_map(&wm.txn, client->window);
+    }
+    set_client_state(client, NormalState);
+}
+
+/* In a monocle zone only the current client stays mapped */
+static void sync_zone_visibility(DisplayManager *display, int zone) {
+    Client *current = get_current_client_in_zone(display, zone);
+    for (Client *client = display->zone_clients[zone]; client; client = client->next) {
+        if (display->zone_monocle[zone] && client != current && !client->floating) {
+            hide_client(client);
+        } else {
+            show_client(client);
+        }
+    }
+}
+
+/* Focus moves to another screen. The old screen's focused window loses its
+ * highlight, and the new screen's root holds focus unless the caller
+ * focuses a window there. */
+static void set_active_display(DisplayManager *display) {
+    DisplayManager *previous = wm.active_display;
+    if (display == previous) return;
+    
+    if (previous) {
+        Client *current = get_current_client_in_zone(previous, previous->active_zone);
+        if (current) {
+            set_window_border(current->window, wm.settings.unfocus_color);
+        }
+        mark_ewmh_dirty(previous, EWMH_DIRTY_ACTIVE_WINDOW);
+    }
+    
+    printf("[DEBUG] set_active_display: Screen %d\n", display->screen);
+    fflush(stdout);
+    wm.active_display = display;
+    mark_ewmh_dirty(display, EWMH_DIRTY_ACTIVE_WINDOW);
+    txn_focus(&wm.txn, display->root);
+}
+
+void toggle_monocle(void) {
+    DisplayManager *display = wm.active_display;
+    if (!display || display->zone_count == 0) return;
+    
+    int zone = display->active_zone;
+    display->zone_monocle[zone] = !display->zone_monocle[zone];
+    printf("[DEBUG] toggle_monocle: Zone %d monocle %s\n", zone,
+           display->zone_monocle[zone] ? "on" : "off");
+    fflush(stdout);
+    
+    sync_zone_visibility(display, zone);
+}
+
+/* Window manager operations using new approach */
+
+void cycle_window_focus_direction(int direction) {
+    DisplayManager *display = wm.active_display;
+    if (!display || display->zone_count == 0) return;
+    
+    Client *current = get_current_client_in_zone(display, display->active_zone);
+    Client *next = step_zone_current(display, direction);
+    if (!next) return;
+    
+    /* Unfocus current window */
+    if (current) {
+        set_window_border(current->window, wm.settings.unfocus_color);
+    }
+    
+    /* Focus new current window */
+    mark_ewmh_dirty(display, EWMH_DIRTY_ACTIVE_WINDOW);
+    set_window_border(next->window, wm.settings.focus_color);
+    focus_window(display, next);
+}
+
+void cycle_window_focus(void) {
+    cycle_window_focus_direction(1);
+}
+
+void cycle_monitor_focus_direction(int direction) {
+    DisplayManager *display = wm.active_display;
+    if (!display) return;
+    
+    /* Stepping past the first or last zone of a screen lands on the
+     * neighbouring screen's nearest zone */
+    int zone = display->active_zone + (direction > 0 ? 1 : -1);
+    if (wm.display_count > 1 && (zone < 0 || zone >= display->zone_count)) {
+        DisplayManager *target = step_display(wm.displays, display, direction);
+        if (target == display || target->zone_count == 0) return;
+        
+        target->active_zone = direction > 0 ? 0 : target->zone_count - 1;
+        set_active_display(target);
+        display = target;
+    } else {
+        if (display->zone_count <= 1) return;
+        
+        /* Unfocus current window */
+        Client *current = get_current_client_in_zone(display, display->active_zone);
+        if (current) {
+            set_window_border(current->window, wm.settings.unfocus_color);
+        }
+        
+        /* Move to zone in specified direction */
+        step_active_zone(display, direction);
+    }
+    
+    /* Focus window in new zone */
+    mark_ewmh_dirty(display, EWMH_DIRTY_ACTIVE_WINDOW);
+    Client *next = get_current_client_in_zone(display, display->active_zone);
+    if (next) {
+        set_window_border(next->window, wm.settings.focus_color);
+        focus_window(display, next);
+    }
+}
+
+void cycle_monitor_focus(void) {
+    cycle_monitor_focus_direction(1);
+}
+
+/* Close a client gracefully, escalating to XKillClient when it does not comply */
+void close_client(DisplayManager *display, Client *current) {
+    Window window = current->window;
+    printf("[DEBUG] close_client: Closing window 0x%lx in zone %d\n", 
+           window, current->zone_index);
+    fflush(stdout);
+    
+    /* A second kill while the first close is still pending escalates at once */
+    if (current->kill_timer.active) {
+        printf("[DEBUG] close_client: Close already pending, force killing window 0x%lx\n", window);
+        fflush(stdout);
+        timer_cancel(&wm.timers, &current->kill_timer);
+        txn_kill(&wm.txn, window);
+        return;
+    }
+    
+    /* Try to close window gracefully first (WM_DELETE_WINDOW) */
+    Atom wm_delete_window = display->wm_atoms[WM_DELETE_WINDOW];
+    Atom wm_protocols = display->wm_atoms[WM_PROTOCOLS];
+    
+    long protocols[16];
+    bool supports_delete = false;
+    int n_protocols = xops->get_property32(display->x_display, window, wm_protocols, XA_ATOM,
+                                           false, protocols, 16);
+    
+    /* Reading WM_PROTOCOLS doubles as the existence check */
+    if (n_protocols < 0) {
+        printf("[DEBUG] close_client: Window 0x%lx no longer exists, cleaning up\n", window);
+        fflush(stdout);
+        unmanage_client(display, current);
+        return;
+    }
+    
+    printf("[DEBUG] close_client: Window supports %d protocols\n", n_protocols);
+    fflush(stdout);
+    for (int i = 0; i < n_protocols; i++) {
+        printf("[DEBUG] close_client: Protocol %d: %ld\n", i, protocols[i]);
+        fflush(stdout);
+        if ((Atom)protocols[i] == wm_delete_window) {
+            supports_delete = true;
+            printf("[DEBUG] close_client: Window supports WM_DELETE_WINDOW\n");
+            fflush(stdout);
+            break;
+        }
+    }
+    
+    if (supports_delete) {
+        printf("[DEBUG] close_client: Sending WM_DELETE_WINDOW message to window 0x%lx\n", window);
+        fflush(stdout);
+        /* Send WM_DELETE_WINDOW message */
+        txn_close(&wm.txn, window);
+        
+        /* Force kill if the client is still around after the deadline */
+        timer_schedule(&wm.timers, &current->kill_timer, wm.settings.kill_timeout_ticks);
+    } else {
+        printf("[DEBUG] close_client: Force killing window 0x%lx with XKillClient\n", window);
+        fflush(stdout);
+        /* Force kill the window */
+        txn_kill(&wm.txn, window);
+    }
+    
+    printf("[DEBUG] close_client: Kill command queued\n");
+    fflush(stdout);
+}
+
+void kill_focused_window(void) {
+    printf("[DEBUG] kill_focused_window() called\n");
+    fflush(stdout);
+    
+    DisplayManager *display = wm.active_display;
+    if (!display) {
+        printf("[DEBUG] kill_focused_window: No active display, returning early\n");
+        fflush(stdout);
+        return;
+    }
+    printf("[DEBUG] kill_focused_window: Active display found\n");
+    fflush(stdout);
+    
+    printf("[DEBUG] kill_focused_window: Active zone = %d, Zone count = %d\n", 
+           display->active_zone, display->zone_count);
+    fflush(stdout);
+    
+    Client *current = get_current_client_in_zone(display, display->active_zone);
+    if (!current) {
+        printf("[DEBUG] kill_focused_window: No current client in zone %d, returning early\n", 
+               display->active_zone);
+        fflush(stdout);
+        
+        /* Debug: Check if there are any clients in this zone */
+        int client_count = count_clients_in_zone(display, display->active_zone);
+        printf("[DEBUG] kill_focused_window: Client count in zone %d = %d\n", 
+               display->active_zone, client_count);
+        fflush(stdout);
+        
+        /* Debug: Check current index */
+        printf("[DEBUG] kill_focused_window: Current index in zone %d = %d\n", 
+               display->active_zone, display->zone_current_index[display->active_zone]);
+        fflush(stdout);
+        
+        return;
+    }
+    
+    close_client(display, current);
+}
+
+/* Close deadline passed without the client unmapping: force kill it */
+static void kill_timer_expired(Timer *timer) {
+    Client *client = timer->data;
+    DisplayManager *display = wm.active_display;
+    if (!display) return;
+    
+    printf("[DEBUG] kill_timer_expired: Window 0x%lx ignored WM_DELETE_WINDOW, force killing\n",
+           client->window);
+    fflush(stdout);
+    
+    txn_kill(&wm.txn, client->window);
+}
+
+void move_focused_window_to_zone_direction(int direction) {
+    DisplayManager *display = wm.active_display;
+    if (!display || display->zone_count <= 1) return;
+    
+    /* Calculate target zone */
+    int zone_count = display->zone_count;
+    int target_zone;
+    if (direction > 0) {
+        target_zone = (display->active_zone + 1) % zone_count;
+    } else {
+        target_zone = (display->active_zone - 1 + zone_count) % zone_count;
+    }
+    
+    move_focused_window_to_zone(target_zone);
+}
+
+/* Direct addressing
+ *
+ * Each command goes straight to its target in one state change, so reaching
+ * zone 4 or sending a window three zones over costs one command and one
+ * resize instead of a walk through every zone in between. */
+
+void move_focused_window_to_zone(int target_zone) {
+    DisplayManager *display = wm.active_display;
+    if (!display || target_zone < 0 || target_zone >= display->zone_count) return;
+    if (target_zone == display->active_zone) return;
+    
+    Client *current = get_current_client_in_zone(display, display->active_zone);
+    if (!current) return;
+    
+    /* Move to target zone, on top of the windows already there */
+    move_client_to_zone(display, current, target_zone);
+    ipc_emit(SWM_EVENT_MOVE, current->window, target_zone);
+    
+    /* Resize and move window to new zone */
+    place_client_in_zone(current, &display->zones[target_zone]);
+    
+    /* Update active zone to follow the window */
+    display->active_zone = target_zone;
+    mark_ewmh_dirty(display, EWMH_DIRTY_CLIENT_LIST);
+}
+
+void focus_zone(int zone) {
+    DisplayManager *display = wm.active_display;
+    if (!display || zone < 0 || zone >= display->zone_count) return;
+    if (zone == display->active_zone) return;
+    
+    Client *current = get_current_client_in_zone(display, display->active_zone);
+    if (current) {
+        set_window_border(current->window, wm.settings.unfocus_color);
+    }
+    
+    display->active_zone = zone;
+    mark_ewmh_dirty(display, EWMH_DIRTY_ACTIVE_WINDOW);
+    Client *next = get_current_client_in_zone(display, zone);
+    if (next) {
+        set_window_border(next->window, wm.settings.focus_color);
+        focus_window(display, next);
+    }
+}
+
+/* Focus a managed window on any screen, as _NET_ACTIVE_WINDOW does */
+void focus_window_by_id(Window window) {
+    DisplayManager *display = NULL;
+    Client *client = find_client_on_any_display(wm.displays, window, &display);
+    if (!client) return;
+    
+    set_active_display(display);
+    activate_client(display, client);
+}
+
+/* Zone bulk operations
+ *
+ * A whole zone moves or closes as one change: the client lists are spliced
+ * in core, every geometry goes into the same transaction, and focus is
+ * settled once at the end instead of once per window. */
+
+/* Focus whatever is current in the active zone after a bulk change */
+static void refocus_active_zone(DisplayManager *display, Client *previous) {
+    Client *current = get_current_client_in_zone(display, display->active_zone);
+    if (previous && previous != current) {
+        set_window_border(previous->window, wm.settings.unfocus_color);
+    }
+    if (current) {
+        set_window_border(current->window, wm.settings.focus_color);
+        focus_window(display, current);
+    }
+    mark_ewmh_dirty(display, EWMH_DIRTY_CLIENT_LIST | EWMH_DIRTY_ACTIVE_WINDOW);
+}
+
+/* Splice one zone onto another and lay out the clients that moved */
+static int splice_zone(DisplayManager *display, int from, int to) {
+    int moved = move_zone_clients(display, from, to);
+    Client *client = display->zone_clients[to];
+    for (int i = 0; i < moved; i++, client = client->next) {
+        place_client_in_zone(client, &display->zones[to]);
+        ipc_emit(SWM_EVENT_MOVE, client->window, to);
+    }
+    
+    /* Windows a monocle zone hid may now be in one that shows them all */
+    if (moved > 0) {
+        sync_zone_visibility(display, to);
+    }
+    return moved;
+}
+
+void move_zone_windows(int from, int to) {
+    DisplayManager *display = wm.active_display;
+    if (!display) return;
+    if (from < 0) from = display->active_zone;
+    if (to < 0) to = display->active_zone;
+    
+    Client *previous = get_current_client_in_zone(display, display->active_zone);
+    if (splice_zone(display, from, to) == 0) return;
+    
+    /* Focus follows the windows when they leave the active zone */
+    if (from == display->active_zone) {
+        display->active_zone = to;
+    }
+    refocus_active_zone(display, previous);
+}
+
+void gather_windows(void) {
+    DisplayManager *display = wm.active_display;
+    if (!display) return;
+    
+    Client *previous = get_current_client_in_zone(display, display->active_zone);
+    int moved = 0;
+    for (int zone = 0; zone < display->zone_count; zone++) {
+        if (zone != display->active_zone) {
+            moved += splice_zone(display, zone, display->active_zone);
+        }
+    }
+    if (moved == 0) return;
+    
+    /* The window that had focus stays current */
+    if (previous) {
+        make_client_current(display, previous);
+    }
+    refocus_active_zone(display, previous);
+}
+
+/* Every window gets its close request now; each still costs the
+ * WM_PROTOCOLS read close_client() needs. Focus moves as the windows
+ * actually unmap. */
+void close_zone_windows(int zone) {
+    DisplayManager *display = wm.active_display;
+    if (!display) return;
+    if (zone < 0) zone = display->active_zone;
+    if (zone >= display->zone_count) return;
+    
+    Client *client = display->zone_clients[zone];
+    while (client) {
+        /* close_client() forgets windows that are already gone */
+        Client *next = client->next;
+        close_client(display, client);
+        client = next;
+    }
+}
+
+/* Zone splits
+ *
+ * Moving a split only changes the two zone areas and marks the screen for
+ * relayout at commit, where the clients of those two zones are refitted
+ * like after a strut change. However many adjustments a batch of commands
+ * holds, each client is configured once, to the final split. */
+
+void set_split(int zone, int x) {
+    DisplayManager *display = wm.active_display;
+    if (!display) return;
+    if (zone < 0) zone = display->active_zone;
+    
+    if (set_zone_split(display, zone, x)) {
+        display->struts_dirty = true;
+    }
+}
+
+void move_split(int zone, int pixels) {
+    DisplayManager *display = wm.active_display;
+    if (!display) return;
+    if (zone < 0) zone = display->active_zone;
+    if (zone >= display->zone_count) return;
+    
+    LogicalZone *left = &display->zones[zone];
+    set_split(zone, left->area.x + left->area.width + pixels - left->monitor.x);
+}
+
+/* Zones do not tile, so this reorders the zone's cycle without a resize */
+void swap_focused_window_with_first(void) {
+    DisplayManager *display = wm.active_display;
+    if (!display) return;
+    
+    Client *current = get_current_client_in_zone(display, display->active_zone);
+    if (!current || !swap_with_first(display, current)) return;
+    
+    mark_ewmh_dirty(display, EWMH_DIRTY_CLIENT_LIST);
+}
+
+/* Docks
+ *
+ * Panels and bars are mapped where they asked to be and never tiled,
+ * bordered or focused. Their struts shrink the usable area of the zones
+ * along the edges they reserve. That is worked out at commit, so a dock
+ * mapped alongside windows costs one layout, and only the clients of zones
+ * whose area actually changed are refitted. Auto-hiding panels rewrite
+ * their struts on every step of the slide, so a change only restarts a
+ * settle timer and the strut is read once it has stopped moving. */
+
+static Dock *find_dock_on_any_display(Window window, DisplayManager **found) {
+    for (DisplayManager *display = wm.displays; display; display = display->next) {
+        Dock *dock = find_dock(display, window);
+        if (dock) {
+            *found = display;
+            return dock;
+        }
+    }
+    return NULL;
+}
+
+static void manage_dock(DisplayManager *display, Window window) {
+    Dock *dock = calloc(1, sizeof(Dock));
+    if (!dock) return;
+    dock->window = window;
+    dock->stale = true;
+    dock->next = display->docks;
+    display->docks = dock;
+    display->struts_dirty = true;
+    
+    txn_select_input(&wm.txn, window, PropertyChangeMask);
+    txn_map(&wm.txn, window);
+    
+    printf("[DEBUG] manage_dock: Window 0x%lx is a dock\n", window);
+    fflush(stdout);
+}
+
+/* Forget a dock that went away. Returns false when window is not a dock. */
+static bool withdraw_dock(Window window) {
+    DisplayManager *display = NULL;
+    if (!find_dock_on_any_display(window, &display)) return false;
+    
+    remove_dock(display, window);
+    display->struts_dirty = true;
+    printf("[DEBUG] withdraw_dock: Dock 0x%lx is gone\n", window);
+    fflush(stdout);
+    return true;
+}
+
+static void strut_settle_expired(Timer *timer) {
+    (void)timer;
+    for (DisplayManager *display = wm.displays; display; display = display->next) {
+        for (Dock *dock = display->docks; dock; dock = dock->next) {
+            if (dock->stale) {
+                display->struts_dirty = true;
+            }
+        }
+    }
+}
+
+/* Prefer _NET_WM_STRUT_PARTIAL, falling back to the older _NET_WM_STRUT */
+static void read_dock_strut(DisplayManager *display, Dock *dock) {
+    /* A new dock's selection is still in the transaction. It has to reach
+     * the server before the read, or a change in between is never seen. */
+    TxnEntry *entry = txn_find(&wm.txn, dock->window);
+    if (entry && (entry->flags & TXN_INPUT)) {
+        entry->flags &= ~TXN_INPUT;
+        xops->select_input(display->x_display, dock->window, entry->event_mask);
+    }
+    
+    long strut[STRUT_VALUES];
+    int count = xops->get_property32(display->x_display, dock->window,
+                                     display->net_atoms[NET_WM_STRUT_PARTIAL], XA_CARDINAL,
+                                     false, strut, STRUT_VALUES);
+    if (count == STRUT_VALUES) {
+        memcpy(dock->strut, strut, sizeof(strut));
+    } else if (xops->get_property32(display->x_display, dock->window, display->net_atoms[NET_WM_STRUT],
+                                    XA_CARDINAL, false, strut, 4) == 4) {
+        strut_from_legacy(strut, dock->strut);
+    } else {
+        memset(dock->strut, 0, sizeof(dock->strut));
+    }
+    dock->stale = false;
+}
+
+/* Re-read the struts that changed and refit the clients of every zone
+ * whose usable area moved. Called at commit, outside its accounting. */
+static void relayout_struts(DisplayManager *display) {
+    display->struts_dirty = false;
+    XCost start = x_cost_now();
+    
+    for (Dock *dock = display->docks; dock; dock = dock->next) {
+        if (dock->stale) {
+            read_dock_strut(display, dock);
+        }
+    }
+    
+    bool *changed = calloc(display->zone_count, sizeof(bool));
+    if (changed) {
+        int count = apply_struts(display, changed);
+        for (int zone = 0; zone < display->zone_count; zone++) {
+            if (!changed[zone]) continue;
+            for (Client *client = display->zone_clients[zone]; client; client = client->next) {
+                place_client_in_zone(client, &display->zones[zone]);
+            }
+        }
+        printf("[DEBUG] relayout_struts: %d zones changed\n", count);
+        fflush(stdout);
+        free(changed);
+    }
+    stats_account(STATS_STRUTS, start);
+}
+
+/* Event handlers */
+
+void handle_map_request(XMapRequestEvent *event) {
+    /* The window goes to the screen it was created on */
+    DisplayManager *display = find_display_by_root(wm.displays, event->parent);
+    if (!display) display = wm.active_display;
+    if (!display) return;
+    
+    Window window = event->window;
+
+    /* A hidden monocle window mapping itself, or a client asking twice
+     * before swm's map went out, is already managed. Managing it again
+     * would leave a second Client or Dock that nothing ever frees. */
+    DisplayManager *owner = NULL;
+    Client *existing = find_client_on_any_display(wm.displays, window, &owner);
+    if (existing) {
+        set_active_display(owner);
+        activate_client(owner, existing);
+        return;
+    }
+    if (find_dock_on_any_display(window, &owner)) {
+        txn_map(&wm.txn, window);
+        return;
+    }
+
+    /* Transients open over their parent's zone */
+    WindowClass class;
+    classify_window(display, window, &class);
+    if (class.dock) {
+        manage_dock(display, window);
+        return;
+    }
+    int zone = display->active_zone;
+    if (class.transient_for != None) {
+        Client *parent = find_client_by_window(display, class.transient_for);
+        if (parent) {
+            zone = parent->zone_index;
+        }
+    }
+    
+    /* Rules can send the window elsewhere, float it or leave focus alone */
+    bool floating = class.floating;
+    bool take_focus = true;
+    const WindowRule *rule = match_window_rule(&class, window);
+    if (class.title_read) {
+        mapped_title_window = window;
+        copy_title(mapped_title, sizeof(mapped_title), class.title);
+    }
+    if (rule) {
+        if (rule->zone >= 0 && rule->zone < display->zone_count) {
+            zone = rule->zone;
+        }
+        floating = floating || rule->floating;
+        take_focus = rule->focus;
+    }
+    if (take_focus) {
+        set_active_display(display);
+    }
+    
+    /* Unfocus the previous window of the active zone */
+    Client *previous = get_current_client_in_zone(display, display->active_zone);
+    if (previous && take_focus) {
+        set_window_border(previous->window, wm.settings.unfocus_color);
+    }
+    
+    /* Create and add client to its zone as the zone's current client */
+    Client *client = create_client(window, zone);
+    if (floating) {
+        client->floating = true;
+        client->width = class.width;
+        client->height = class.height;
+    }
+    insert_new_client(display, client, zone);
+    ipc_emit(SWM_EVENT_MAP, window, zone);
+    
+    /* Fill the zone, or center over it */
+    if (zone < display->zone_count) {
+        place_client_in_zone(client, &display->zones[zone]);
+    }
+    
+    /* Map window and focus it. Title changes only matter while status bars
+     * can read the focused title from the exported state. */
+    long event_mask = FOCUS_FOLLOWS_MOUSE ? EnterWindowMask : NoEventMask;
+    if (ipc_state_is_active()) {
+        event_mask |= PropertyChangeMask;
+    }
+    if (event_mask != NoEventMask) {
+        txn_select_input(&wm.txn, window, event_mask);
+    }
+    txn_map(&wm.txn, window);
+    set_client_state(client, NormalState);
+    mark_ewmh_dirty(display, EWMH_DIRTY_CLIENT_LIST);
+    
+    if (take_focus) {
+        display->active_zone = zone;
+        mark_ewmh_dirty(display, EWMH_DIRTY_ACTIVE_WINDOW);
+        set_window_border(window, wm.settings.focus_color);
+        focus_window(display, client);
+    } else {
+        set_window_border(window, wm.settings.unfocus_color);
+        /* The focused window stays current and on top of its zone */
+        if (previous && previous->zone_index == zone) {
+            make_client_current(display, previous);
+            stack_raise(display, zone, previous);
+        }
+    }
+}
+
+/* The client is gone or withdrew its window: forget it and refocus its zone */
+static void client_withdrawn(DisplayManager *display, Client *client) {
+    int zone = client->zone_index;
+    
+    /* Remove client from zone */
+    unmanage_client(display, client);
+    
+    /* Focus the new current window in the zone if any. Should it be gone
+     * too, its own UnmapNotify or DestroyNotify is already queued. Focus
+     * stays put when the window was on another screen. */
+    Client *next = get_current_client_in_zone(display, zone);
+    if (next && display == wm.active_display) {
+        set_window_border(next->window, wm.settings.focus_color);
+        focus_window(display, next);
+    }
+}
+
+void handle_unmap_notify(XUnmapEvent *event) {
+    if (withdraw_dock(event->window)) return;
+    
+    DisplayManager *display = NULL;
+    Client *client = find_client_on_any_display(wm.displays, event->window, &display);
+    if (!client) return;
+    
+    /* Unmaps swm made itself are not withdrawals. A client withdrawing a
+     * window swm already hid sends a synthetic UnmapNotify instead. */
+    if (client->ignore_unmap > 0 && !event->send_event) {
+        client->ignore_unmap--;
+        return;
+    }
+    
+    record_event(RECORD_UNMAP, event->window, 0);
+    client_withdrawn(display, client);
+}
+
+/* Hidden clients get no UnmapNotify when they are destroyed */
+void handle_destroy_notify(XDestroyWindowEvent *event) {
+    if (withdraw_dock(event->window)) return;
+    
+    DisplayManager *display = NULL;
+    Client *client = find_client_on_any_display(wm.displays, event->window, &display);
+    if (!client) return;
+    
+    record_event(RECORD_DESTROY, event->window, 0);
+    client_withdrawn(display, client);
+}
+
+/* Run one _SWM_COMMAND command. The arguments are only read by the
+ * commands that take them. */
+void execute_command(int command, long argument, long argument2) {
+    const char *span = command > 0 && command < CMD_COUNT ? command_names[command] : "unknown command";
+    span_begin(span, (unsigned long)argument);
+    XCost start = x_cost_now();
+#if FOCUS_FOLLOWS_MOUSE
+    cancel_focus_dwell();
+#endif
+    switch (command) {
+        case CMD_CYCLE_WINDOW:
+            printf("[DEBUG] execute_command: Executing CMD_CYCLE_WINDOW\n");
+            fflush(stdout);
+            cycle_window_focus();
+            break;
+        case CMD_CYCLE_WINDOW_NEXT:
+            printf("[DEBUG] execute_command: Executing CMD_CYCLE_WINDOW_NEXT\n");
+            fflush(stdout);
+            cycle_window_focus_direction(1);
+            break;
+        case CMD_CYCLE_WINDOW_PREV:
+            printf("[DEBUG] execute_command: Executing CMD_CYCLE_WINDOW_PREV\n");
+            fflush(stdout);
+            cycle_window_focus_direction(-1);
+            break;
+        case CMD_CYCLE_MONITOR:
+            printf("[DEBUG] execute_command: Executing CMD_CYCLE_MONITOR\n");
+            fflush(stdout);
+            cycle_monitor_focus();
+            break;
+        case CMD_CYCLE_MONITOR_LEFT:
+            printf("[DEBUG] execute_command: Executing CMD_CYCLE_MONITOR_LEFT\n");
+            fflush(stdout);
+            cycle_monitor_focus_direction(-1);
+            break;
+        case CMD_CYCLE_MONITOR_RIGHT:
+            printf("[DEBUG] execute_command: Executing CMD_CYCLE_MONITOR_RIGHT\n");
+            fflush(stdout);
+            cycle_monitor_focus_direction(1);
+            break;
+        case CMD_KILL_WINDOW:
+            printf("[DEBUG] execute_command: Executing CMD_KILL_WINDOW\n");
+            fflush(stdout);
+            kill_focused_window();
+            break;
+        case CMD_MOVE_WINDOW_LEFT:
+            printf("[DEBUG] execute_command: Executing CMD_MOVE_WINDOW_LEFT\n");
+            fflush(stdout);
+            move_focused_window_to_zone_direction(-1);
+            break;
+        case CMD_MOVE_WINDOW_RIGHT:
+            printf("[DEBUG] execute_command: Executing CMD_MOVE_WINDOW_RIGHT\n");
+            fflush(stdout);
+            move_focused_window_to_zone_direction(1);
+            break;
+        case CMD_TOGGLE_MONOCLE:
+            printf("[DEBUG] execute_command: Executing CMD_TOGGLE_MONOCLE\n");
+            fflush(stdout);
+            toggle_monocle();
+            break;
+        case CMD_FOCUS_ZONE:
+            printf("[DEBUG] execute_command: Executing CMD_FOCUS_ZONE %ld\n", argument);
+            fflush(stdout);
+            focus_zone((int)argument);
+            break;
+        case CMD_MOVE_WINDOW_TO_ZONE:
+            printf("[DEBUG] execute_command: Executing CMD_MOVE_WINDOW_TO_ZONE %ld\n", argument);
+            fflush(stdout);
+            move_focused_window_to_zone((int)argument);
+            break;
+        case CMD_FOCUS_WINDOW:
+            printf("[DEBUG] execute_command: Executing CMD_FOCUS_WINDOW 0x%lx\n", (unsigned long)argument);
+            fflush(stdout);
+            focus_window_by_id((Window)argument);
+            break;
+        case CMD_SWAP_FIRST:
+            printf("[DEBUG] execute_command: Executing CMD_SWAP_FIRST\n");
+            fflush(stdout);
+            swap_focused_window_with_first();
+            break;
+        case CMD_MOVE_ZONE_WINDOWS:
+            printf("[DEBUG] execute_command: Executing CMD_MOVE_ZONE_WINDOWS %ld %ld\n",
+                   argument, argument2);
+            fflush(stdout);
+            move_zone_windows((int)argument, (int)argument2);
+            break;
+        case CMD_CLOSE_ZONE_WINDOWS:
+            printf("[DEBUG] execute_command: Executing CMD_CLOSE_ZONE_WINDOWS %ld\n", argument);
+            fflush(stdout);
+            close_zone_windows((int)argument);
+            break;
+        case CMD_GATHER_WINDOWS:
+            printf("[DEBUG] execute_command: Executing CMD_GATHER_WINDOWS\n");
+            fflush(stdout);
+            gather_windows();
+            break;
+        case CMD_RUN_MACRO:
+            printf("[DEBUG] execute_command: Executing CMD_RUN_MACRO %ld\n", argument);
+            fflush(stdout);
+            run_macro((int)argument);
+            break;
+        case CMD_MOVE_SPLIT:
+            printf("[DEBUG] execute_command: Executing CMD_MOVE_SPLIT %ld %ld\n", argument, argument2);
+            fflush(stdout);
+            move_split((int)argument, (int)argument2);
+            break;
+        case CMD_SET_SPLIT:
+            printf("[DEBUG] execute_command: Executing CMD_SET_SPLIT %ld %ld\n", argument, argument2);
+            fflush(stdout);
+            set_split((int)argument, (int)argument2);
+            break;
+        case CMD_RELOAD_SETTINGS:
+            printf("[DEBUG] execute_command: Executing CMD_RELOAD_SETTINGS\n");
+            fflush(stdout);
+            reload_settings();
+            break;
+        case CMD_QUIT:
+            printf("[DEBUG] execute_command: Executing CMD_QUIT\n");
+            fflush(stdout);
+            wm.running = false;
+            break;
+        default:
+            printf("[DEBUG] execute_command: Unknown command %d\n", command);
+            fflush(stdout);
+            span_end(span);
+            return;
+    }
+    stats_account(STATS_COMMAND + command, start);
+    span_end(span);
+}
+
+/* Straight from the grab to the command: no helper processes, no round trips */
+void handle_key_press(XKeyEvent *event) {
+    const KeyBinding *binding = keys_lookup(&wm.keys, event->keycode, event->state);
+    if (!binding) return;
+    
+    record_command(binding->command, binding->argument, 0);
+    execute_command(binding->command, binding->argument, 0);
+}
+
+/* The keyboard was remapped: keycodes and the NumLock bit may have moved */
+void handle_mapping_notify(XMappingEvent *event) {
+    xops->refresh_keyboard(event);
+    if (event->request == MappingKeyboard || event->request == MappingModifier) {
+        if (wm.displays && wm.keys.count > 0) {
+            load_key_bindings(wm.displays, wm.keys.bindings, wm.keys.count);
+        }
+    }
+}
+
+void handle_property_notify(XPropertyEvent *event) {
+    /* Commands can be sent to any screen's root and act on the active screen */
+    DisplayManager *display = find_display_by_root(wm.displays, event->window);
+    
+    /* A retitled focused window is re-read when the state is next exported,
+     * a dock's strut once it has settled */
+    if (!display) {
+        display = wm.active_display;
+        if (!display) return;
+        if (event->atom == display->net_atoms[NET_WM_STRUT_PARTIAL] ||
+            event->atom == display->net_atoms[NET_WM_STRUT]) {
+            DisplayManager *owner = NULL;
+            Dock *dock = find_dock_on_any_display(event->window, &owner);
+            if (dock) {
+                dock->stale = true;
+                timer_schedule(&wm.timers, &strut_settle_timer, wm.settings.strut_settle_ticks);
+            }
+            return;
+        }
+        if (event->window == title_window &&
+            (event->atom == XA_WM_NAME || event->atom == display->net_atoms[NET_WM_NAME])) {
+            title_stale = true;
+        }
+        return;
+    }
+    /* Our own delete of the queue notifies too; there is nothing to read */
+    if (event->atom != display->command_atom || event->state == PropertyDelete) {
+        return;
+    }
+    
+    /* Clients append to the property, so commands sent faster than swm
+     * reads them queue up instead of overwriting each other. Their notifies
+     * only mark the queue; it is read once, before the next other event or
+     * at commit, however many appends arrived in between. */
+    display->command_pending = true;
+    commands_pending = true;
+}
+
+/* One read takes and deletes the whole queue */
+static void read_command_queue(DisplayManager *display) {
+    display->command_pending = false;
+    printf("[DEBUG] read_command_queue: Reading queued commands\n");
+    fflush(stdout);
+    
+    long *items = NULL;
+    XCost start = x_cost_now();
+    int nitems = xops->take_property32(display->x_display, display->root, display->command_atom,
+                                       XA_INTEGER, &items);
+    stats_account(STATS_COMMAND_READ, start);
+    if (nitems < 0) {
+        printf("[DEBUG] read_command_queue: Reading the command property failed\n");
+        fflush(stdout);
+        return;
+    }
+    
+    /* Each command, then the arguments it takes; zeros between commands are
+     * padding from clients that always send three items */
+    int i = 0;
+    while (i < nitems) {
+        long command = items[i++];
+        if (command == 0) continue;
+        if (command < 0 || command >= CMD_COUNT) {
+            /* Its argument count is unknown, so nothing after it can be trusted */
+            printf("[DEBUG] read_command_queue: Unknown command %ld, dropping %d queued items\n",
+                   command, nitems - i);
+            fflush(stdout);
+            break;
+        }
+        
+        long arguments[2] = {0, 0};
+        for (int n = 0; n < command_argument_counts[command] && i < nitems; n++) {
+            arguments[n] = items[i++];
+        }
+        printf("[DEBUG] read_command_queue: Received command %ld\n", command);
+        fflush(stdout);
+        record_command((int)command, arguments[0], arguments[1]);
+        execute_command((int)command, arguments[0], arguments[1]);
+        if (!wm.running) break;
+    }
+    free(items);
+}
+
+/* Commands run in the order they were sent relative to other events, so
+ * the queue is read before any other event is handled */
+static void run_pending_commands(void) {
+    commands_pending = false;
+    span_begin("commands", 0);
+    for (DisplayManager *display = wm.displays; display && wm.running; display = display->next) {
+        if (display->command_pending) {
+            read_command_queue(display);
+        }
+    }
+    span_end("commands");
+}
+
+/* Make a client the current one of its zone and move focus to it */
+void activate_client(DisplayManager *display, Client *client) {
+    Client *previous = get_current_client_in_zone(display, display->active_zone);
+    if (previous && previous != client) {
+        set_window_border(previous->window, wm.settings.unfocus_color);
+    }
+    
+    make_client_current(display, client);
+    mark_ewmh_dirty(display, EWMH_DIRTY_ACTIVE_WINDOW);
+    
+    set_window_border(client->window, wm.settings.focus_color);
+    focus_window(display, client);
+}
+
+/* EWMH requests from pagers, panels and scripts */
+void handle_client_message(XClientMessageEvent *event) {
+    DisplayManager *display = NULL;
+    Client *client = find_client_on_any_display(wm.displays, event->window, &display);
+    if (!client) return;
+    
+    if (event->message_type == display->net_atoms[NET_ACTIVE_WINDOW]) {
+        printf("[DEBUG] handle_client_message: _NET_ACTIVE_WINDOW for 0x%lx\n", event->window);
+        fflush(stdout);
+        record_event(RECORD_ACTIVATE, event->window, 0);
+#if FOCUS_FOLLOWS_MOUSE
+        cancel_focus_dwell();
+#endif
+        set_active_display(display);
+        activate_client(display, client);
+    } else if (event->message_type == display->net_atoms[NET_CLOSE_WINDOW]) {
+        printf("[DEBUG] handle_client_message: _NET_CLOSE_WINDOW for 0x%lx\n", event->window);
+        fflush(stdout);
+        record_event(RECORD_CLOSE, event->window, 0);
+        close_client(display, client);
+    }
+}
+
+#if FOCUS_FOLLOWS_MOUSE
+/* Focus the window the pointer rests in, unless it is gone or already focused */
+static void focus_under_pointer(Window window) {
+    DisplayManager *display = NULL;
+    Client *client = find_client_on_any_display(wm.displays, window, &display);
+    if (!client) return;
+    
+    /* If it's already the focused window, do nothing */
+    Client *current = get_current_client_in_zone(display, display->active_zone);
+    if (display == wm.active_display && current && current->window == window) return;
+    
+    printf("[DEBUG] focus_under_pointer: Focusing 0x%lx under the pointer\n", window);
+    fflush(stdout);
+    set_active_display(display);
+    
+    /* Update active zone */
+    display->active_zone = client->zone_index;
+    mark_ewmh_dirty(display, EWMH_DIRTY_ACTIVE_WINDOW);
+    
+    /* Use existing focus logic - just focus the window directly */
+    set_window_border(window, wm.settings.focus_color);
+    focus_window(display, client);
+    
+    /* Unfocus all other windows in all zones */
+    for (int zone = 0; zone < display->zone_count; zone++) {
+        Client *zone_client = display->zone_clients[zone];
+        while (zone_client) {
+            if (zone_client->window != window) {
+                set_window_border(zone_client->window, wm.settings.unfocus_color);
+            }
+            zone_client = zone_client->next;
+        }
+    }
+}
+
+static void focus_dwell_expired(Timer *timer) {
+    (void)timer;
+    Window window = focus_dwell_window;
+    focus_dwell_window = None;
+    focus_under_pointer(window);
+}
+
+/* Forget the window the pointer is resting in; the keyboard and pagers
+ * move focus at once and must not be overridden a moment later */
+static void cancel_focus_dwell(void) {
+    timer_cancel(&wm.timers, &focus_dwell_timer);
+    focus_dwell_window = None;
+}
+
+void handle_enter_notify(XEnterWindowEvent *event) {
+    /* Grabs, pointer moves between a window and its children, and crossings
+     * caused by swm's own moves, resizes and restacks are not the user
+     * pointing at a window */
+    if (!enter_policy) return;
+    if (event->mode != NotifyNormal || event->detail == NotifyInferior) return;
+    if (serial_ranges_contains(&wm.self_crossing, event->serial)) {
+        printf("[DEBUG] handle_enter_notify: Ignoring self-inflicted EnterNotify for 0x%lx\n",
+               event->window);
+        fflush(stdout);
+        return;
+    }
+    DisplayManager *display = NULL;
+    if (!find_client_on_any_display(wm.displays, event->window, &display)) return;
+    
+    record_event(RECORD_ENTER, event->window, 0);
+    
+    /* Back in the focused window before the dwell ran out */
+    Client *current = get_current_client_in_zone(display, display->active_zone);
+    if (display == wm.active_display && current && current->window == event->window) {
+        cancel_focus_dwell();
+        return;
+    }
+    
+    enter_policy(event->window);
+}
+
+/* Sweeping across windows only restarts the dwell; the window the pointer
+ * stops in is the only one focused, raised and re-bordered */
+static void start_focus_dwell(Window window) {
+    focus_dwell_window = window;
+    timer_schedule(&wm.timers, &focus_dwell_timer, wm.settings.focus_dwell_ticks);
+}
+#endif
+
+/* Settings
+ *
+ * Handlers read wm.settings fields and call the policies resolved here;
+ * nothing on the hot path parses or looks anything up. */
+
+static void resolve_policies(void) {
+#if FOCUS_FOLLOWS_MOUSE
+    if (!wm.settings.focus_follows_mouse) {
+        enter_policy = NULL;
+        cancel_focus_dwell();
+    } else if (wm.settings.focus_dwell_ticks > 0) {
+        enter_policy = start_focus_dwell;
+    } else {
+        enter_policy = focus_under_pointer;
+    }
+#endif
+}
+
+/* Switch to new settings, touching only what they change. A new zone
+ * layout resplits the zones in place and, like a strut change, refits at
+ * commit only the clients of zones whose usable area moved. A new border
+ * width refits every client; new colors only re-border them. */
+void apply_settings(const Settings *settings) {
+    Settings previous = wm.settings;
+    wm.settings = *settings;
+    resolve_policies();
+    
+    bool layout_changed = !zone_layout_equal(&previous.layout, &settings->layout);
+    bool border_changed = previous.border_width != settings->border_width;
+    bool colors_changed = previous.focus_color != settings->focus_color ||
+                          previous.unfocus_color != settings->unfocus_color;
+    
+    for (DisplayManager *display = wm.displays; display; display = display->next) {
+        if (layout_changed) {
+            int moved = resplit_zones(display, &settings->layout);
+            if (moved < 0) {
+                printf("[DEBUG] apply_settings: Screen %d would get a different number of zones, "
+                       "keeping its split until restart\n", display->screen);
+            } else if (moved > 0) {
+                display->struts_dirty = true;
+            }
+            fflush(stdout);
+        }
+        if (!border_changed && !colors_changed) continue;
+        
+        Window focused = display == wm.active_display ? get_active_window(display) : None;
+        for (int zone = 0; zone < display->zone_count; zone++) {
+            for (Client *client = display->zone_clients[zone]; client; client = client->next) {
+                if (border_changed) {
+                    place_client_in_zone(client, &display->zones[zone]);
+                }
+                set_window_border(client->window, client->window == focused ?
+                                  settings->focus_color : settings->unfocus_color);
+            }
+        }
+    }
+}
+
+/* Re-read the settings file; a file with errors changes nothing */
+void reload_settings(void) {
+    if (!wm.settings_path) {
+        printf("[DEBUG] reload_settings: No settings file\n");
+        fflush(stdout);
+        return;
+    }
+    
+    Settings settings;
+    if (!settings_load(&settings, wm.settings_path, stderr)) {
+        printf("[DEBUG] reload_settings: Keeping the current settings\n");
+        fflush(stdout);
+        return;
+    }
+    apply_settings(&settings);
+    printf("[DEBUG] reload_settings: Applied %s\n", wm.settings_path);
+    fflush(stdout);
+}
+
+/* EWMH */
+
+/* Write every dirty root property once. Called once per event loop iteration. */
+void ewmh_publish(DisplayManager *display) {
+    unsigned int dirty = take_ewmh_dirty(display);
+    if (!dirty) return;
+    
+    if (dirty & EWMH_DIRTY_CLIENT_LIST) {
+        int count = count_managed_clients(display);
+        Window *windows = malloc((count > 0 ? count : 1) * sizeof(Window));
+        assert(windows != NULL);
+        count = collect_client_windows(display, windows, count);
+        xops->change_property(display->x_display, display->root, display->net_atoms[NET_CLIENT_LIST],
+                              XA_WINDOW, 32, windows, count);
+        free(windows);
+    }
+    
+    if (dirty & EWMH_DIRTY_ACTIVE_WINDOW) {
+        /* Only the screen holding focus has an active window */
+        Window active = display == wm.active_display ? get_active_window(display) : None;
+        xops->change_property(display->x_display, display->root, display->net_atoms[NET_ACTIVE_WINDOW],
+                              XA_WINDOW, 32, &active, 1);
+    }
+}
+
+/* State export
+ *
+ * After each batch the visible state is rebuilt into a local SwmState and
+ * copied to shared memory only if it differs from what was last exported.
+ * The focused title costs a round trip, so it is fetched only when focus
+ * moves to another window or the focused window is retitled, and not at all
+ * for a window mapped in the same batch. */
+
+static void read_window_title(DisplayManager *display, Window window, char *title, int size) {
+    /* A window mapped this batch had its title fetched with the rest */
+    if (window == mapped_title_window) {
+        copy_title(title, size, mapped_title);
+        return;
+    }
+    
+    char net_name[SWM_STATE_TITLE_MAX], name[SWM_STATE_TITLE_MAX];
+    PropertyRead reads[] = {
+        {display->net_atoms[NET_WM_NAME], display->utf8_string_atom, 8, net_name, sizeof(net_name), -1},
+        {XA_WM_NAME, AnyPropertyType, 8, name, sizeof(name), -1},
+    };
+    xops->get_properties(display->x_display, window, reads, 2, NULL, NULL);
+    take_title(&reads[0], &reads[1], title, size);
+}
+
+/* Focus and zone changes are reported once per batch, as where they ended
+ * up, however many steps a burst of commands took to get there */
+void stream_state_changes(DisplayManager *display) {
+    if (!display) return;
+    
+    /* Moving to the same zone number on another screen is a zone change too */
+    bool screen_changed = streamed_display && display != streamed_display;
+    streamed_display = display;
+    if (display->active_zone != streamed_zone || screen_changed) {
+        streamed_zone = display->active_zone;
+        ipc_emit(SWM_EVENT_ZONE, None, streamed_zone);
+    }
+    Window focused = get_active_window(display);
+    if (focused != streamed_focus) {
+        streamed_focus = focused;
+        ipc_emit(SWM_EVENT_FOCUS, focused, display->active_zone);
+    }
+}
+
+void export_state(DisplayManager *display) {
+    if (!ipc_state_is_active() || !display) return;
+    
+    SwmState state;
+    memset(&state, 0, sizeof(state));
+    state.magic = SWM_STATE_MAGIC;
+    state.version = SWM_STATE_VERSION;
+    state.size = sizeof(SwmState);
+    state.active_zone = display->active_zone;
+    state.zone_count = display->zone_count < SWM_STATE_MAX_ZONES ? display->zone_count : SWM_STATE_MAX_ZONES;
+    
+    for (uint32_t zone = 0; zone < state.zone_count; zone++) {
+        SwmStateZone *out = &state.zones[zone];
+        Rectangle *geometry = &display->zones[zone].geometry;
+        Client *current = get_current_client_in_zone(display, zone);
+        out->x = geometry->x;
+        out->y = geometry->y;
+        out->width = geometry->width;
+        out->height = geometry->height;
+        out->client_count = count_clients_in_zone(display, zone);
+        out->monocle = display->zone_monocle[zone];
+        out->current_window = current ? current->window : None;
+    }
+    
+    Window focused = get_active_window(display);
+    state.focused_window = focused;
+    if (focused != title_window || title_stale) {
+        title_window = focused;
+        title_stale = false;
+        if (focused != None) {
+            read_window_title(display, focused, state.focused_title, sizeof(state.focused_title));
+        }
+    } else {
+        memcpy(state.focused_title, exported_state.focused_title, sizeof(state.focused_title));
+    }
+    
+    if (memcmp(&state, &exported_state, sizeof(state)) != 0) {
+        exported_state = state;
+        ipc_state_publish(&state);
+    }
+}
+
+/* Event dispatch */
+
+/* Span names of the events swm handles */
+static const char *event_span_names[LASTEvent] = {
+    [MapRequest]    = "MapRequest",
+    [UnmapNotify]   = "UnmapNotify",
+    [DestroyNotify] = "DestroyNotify",
+    [PropertyNotify] = "PropertyNotify",
+    [ClientMessage] = "ClientMessage",
+    [KeyPress]      = "KeyPress",
+    [MappingNotify] = "MappingNotify",
+    [EnterNotify]   = "EnterNotify",
+};
+
+void dispatch_event(XEvent *event) {
+    if (commands_pending && event->type != PropertyNotify) {
+        run_pending_commands();
+    }
+    const char *span = event->type >= 0 && event->type < LASTEvent ? event_span_names[event->type] : NULL;
+    if (!span) return;
+    span_begin(span, event->xany.window);
+    XCost start = x_cost_now();
+    switch (event->type) {
+        case MapRequest:
+            record_event(RECORD_MAP, event->xmaprequest.window, 0);
+            handle_map_request(&event->xmaprequest);
+            stats_account(STATS_MAP, start);
+            break;
+        case UnmapNotify:
+            handle_unmap_notify(&event->xunmap);
+            stats_account(STATS_UNMAP, start);
+            break;
+        case DestroyNotify:
+            handle_destroy_notify(&event->xdestroywindow);
+            stats_account(STATS_DESTROY, start);
+            break;
+        case PropertyNotify:
+            /* Accounted inside: the read and the command separately */
+            handle_property_notify(&event->xproperty);
+            break;
+        case ClientMessage:
+            handle_client_message(&event->xclient);
+            stats_account(STATS_MESSAGE, start);
+            break;
+        case KeyPress:
+            /* Costs are accounted to the command */
+            handle_key_press(&event->xkey);
+            break;
+        case MappingNotify:
+            handle_mapping_notify(&event->xmapping);
+            break;
+#if FOCUS_FOLLOWS_MOUSE
+        case EnterNotify:
+            handle_enter_notify(&event->xcrossing);
+            stats_account(STATS_ENTER, start);
+            break;
+#endif
+    }
+    span_end(span);
+}
+
+/* Everything a batch of events changed goes out in one ordered burst. The
+ * caller flushes the connection afterwards. */
+void commit_batch(void) {
+    if (!wm.displays) return;
+    if (commands_pending) {
+        run_pending_commands();
+    }
+    
+    /* Strut reads are round trips of their own, kept out of the commit's */
+    for (DisplayManager *display = wm.displays; display; display = display->next) {
+        if (display->struts_dirty) {
+            span_begin("struts", 0);
+            relayout_struts(display);
+            span_end("struts");
+        }
+    }
+    
+    span_begin("commit", 0);
+    XCost start = x_cost_now();
+    for (DisplayManager *display = wm.displays; display; display = display->next) {
+        for (int zone = 0; zone < display->zone_count; zone++) {
+            if (display->zone_monocle[zone]) {
+                sync_zone_visibility(display, zone);
+            }
+        }
+        ewmh_publish(display);
+    }
+    txn_commit(wm.displays->x_display, &wm.txn);
+    stream_state_changes(wm.active_display);
+    export_state(wm.active_display);
+    mapped_title_window = None;
+    stats_account(STATS_COMMIT, start);
+    span_end("commit");
+}
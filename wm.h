@@ -0,0 +1,88 @@
+#ifndef WM_H
+#define WM_H
+
+#include <stdio.h>
+#include <X11/Xlib.h>
+#include "core.h"
+#include "xops.h"
+
+/* Global state */
+extern WindowManager wm;
+extern const XOps *xops;
+
+void wm_init(const XOps *ops);
+void wm_use_ops(const XOps *ops);
+void wm_cleanup(void);
+unsigned long now_tick(void);
+
+/* Requests recorded into the current transaction */
+void set_window_border(Window window, unsigned long color);
+void raise_client(DisplayManager *display, Client *client);
+void focus_window(DisplayManager *display, Client *client);
+void resize_window_to_zone(Window window, LogicalZone *zone);
+void place_client_in_zone(Client *client, LogicalZone *zone);
+void txn_commit(Display *display, Transaction *txn);
+void commit_batch(void);
+
+/* Per-handler X traffic */
+const char *stats_name(int slot);
+void print_handler_stats(FILE *out);
+int check_handler_budgets(FILE *out);
+
+/* Window rules */
+void load_window_rules(DisplayManager *display, const WindowRule *rules, int count);
+void load_config_rules(DisplayManager *display);
+
+/* Key bindings */
+void load_key_bindings(DisplayManager *display, const KeyBinding *bindings, int count);
+void load_config_keys(DisplayManager *display);
+
+/* Client management */
+Client *create_client(Window window, int zone_index);
+void unmanage_client(DisplayManager *display, Client *client);
+void activate_client(DisplayManager *display, Client *client);
+void close_client(DisplayManager *display, Client *current);
+
+/* Commands */
+void cycle_window_focus(void);
+void cycle_window_focus_direction(int direction);
+void cycle_monitor_focus(void);
+void cycle_monitor_focus_direction(int direction);
+void kill_focused_window(void);
+void move_focused_window_to_zone_direction(int direction);
+void move_focused_window_to_zone(int zone);
+void focus_zone(int zone);
+void focus_window_by_id(Window window);
+void swap_focused_window_with_first(void);
+void move_zone_windows(int from, int to);
+void close_zone_windows(int zone);
+void gather_windows(void);
+void move_split(int zone, int pixels);
+void set_split(int zone, int x);
+void run_macro(int index);
+void apply_settings(const Settings *settings);
+void reload_settings(void);
+void toggle_monocle(void);
+void execute_command(int command, long argument, long argument2);
+
+/* Event handlers */
+void handle_map_request(XMapRequestEvent *event);
+void handle_unmap_notify(XUnmapEvent *event);
+void handle_destroy_notify(XDestroyWindowEvent *event);
+void handle_property_notify(XPropertyEvent *event);
+void handle_client_message(XClientMessageEvent *event);
+void handle_key_press(XKeyEvent *event);
+void handle_mapping_notify(XMappingEvent *event);
+#if FOCUS_FOLLOWS_MOUSE
+void handle_enter_notify(XEnterWindowEvent *event);
+#endif
+void dispatch_event(XEvent *event);
+
+/* EWMH */
+void ewmh_publish(DisplayManager *display);
+
+/* State for status bars and subscribers (ipc.h) */
+void stream_state_changes(DisplayManager *display);
+void export_state(DisplayManager *display);
+
+#endif /* WM_H */
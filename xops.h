@@ -0,0 +1,70 @@
+#ifndef XOPS_H
+#define XOPS_H
+
+#include <stdbool.h>
+#include <X11/Xlib.h>
+
+/* One property of a get_properties() batch */
+typedef struct {
+    Atom property;
+    Atom type;                    /* AnyPropertyType accepts any */
+    int format;                   /* 32: items into a long array, 8: NUL-terminated text */
+    void *data;
+    int size;                     /* Capacity of data in items, or bytes for text */
+    int count;                    /* Set to the items or bytes read, -1 on failure */
+} PropertyRead;
+
+#define PROPERTY_READS_MAX 8
+
+/* X server operations used by the window management logic
+ *
+ * wm.c never calls Xlib itself; everything goes through this table. swm.c
+ * provides the Xlib implementation and tests/fake_x.c an in-memory fake
+ * server that records every request. */
+typedef struct {
+    /* Requests: queued on the connection, no reply */
+    void (*move_resize)(Display *display, Window window, int x, int y, int width, int height);
+    void (*set_border)(Display *display, Window window, unsigned long color, int width);
+    void (*set_focus)(Display *display, Window window);
+    void (*restack)(Display *display, Window *windows, int count);
+    void (*map)(Display *display, Window window);
+    void (*unmap)(Display *display, Window window);
+    void (*select_input)(Display *display, Window window, long mask);
+    void (*kill_client)(Display *display, Window window);
+    void (*send_message)(Display *display, Window window, Atom type, long data0, long data1);
+    void (*change_property)(Display *display, Window window, Atom property, Atom type,
+                            int format, const void *data, int count);
+    void (*grab_key)(Display *display, Window window, int keycode, unsigned int modifiers);
+    void (*ungrab_keys)(Display *display, Window window);
+    /* Does nothing but take a serial, closing a burst of requests */
+    void (*no_operation)(Display *display);
+    
+    /* Replies: each costs a blocking round trip, counted by wm.c */
+    bool (*window_exists)(Display *display, Window window);
+    bool (*get_size)(Display *display, Window window, int *width, int *height);
+    int (*get_property32)(Display *display, Window window, Atom property, Atom type,
+                          bool delete, long *items, int max_items);
+    /* All of a 32-bit property, deleted in the same request; *items is
+     * malloc()ed (NULL when empty) and the count returned, -1 on failure */
+    int (*take_property32)(Display *display, Window window, Atom property, Atom type,
+                           long **items);
+    int (*get_text_property)(Display *display, Window window, Atom property, Atom type,
+                             char *buffer, int size);
+    /* Up to PROPERTY_READS_MAX properties of one window, plus its size when
+     * width is not NULL: every request goes out before any reply is waited
+     * for, so the whole batch costs one round trip. The size is 0x0 when
+     * the window is gone. */
+    void (*get_properties)(Display *display, Window window, PropertyRead *reads, int count,
+                           int *width, int *height);
+    Atom (*intern_atom)(Display *display, const char *name);
+    unsigned int (*numlock_mask)(Display *display);
+    
+    /* Keyboard mapping, fetched once and cached by the backend */
+    KeyCode (*keysym_to_keycode)(Display *display, KeySym keysym);
+    void (*refresh_keyboard)(XMappingEvent *event);
+    
+    /* Serial the next request will carry */
+    unsigned long (*next_request)(Display *display);
+} XOps;
+
+#endif /* XOPS_H */